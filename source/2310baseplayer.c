@@ -6,15 +6,52 @@
  * 0    Normal exit
  * 1    Incorrect number of arguments           Usage: player players myid
  *                                              threshold handsize
+ *      (other than a lone --multi, see 2310multi.c)
+ *      (or PLAYER_LOG is not a legal policy,
+ *      or its spill file can't be opened)
  * 2    Number of players < 2 or not a number   Invalid players
  * 3    Invalid position for number of players  Invalid position
  * 4    Threshold < 2 or not a number           Invalid theshold
  * 5    Hand size < 1 or not a number           Invalid hand size
  * 6    Invalid message from hub                Invalid message
  * 7    Unexpected EOF from hub                 EOF
+ * 8    Strategy missing or not a legal spec    Invalid strategy
+*/
+
+/*
+ * MESSAGE                                      MEANING
+ * HAND<n>,<card>,...                           the n cards dealt to us
+ * NEWROUND<lead>                               a round led by player lead
+ * PLAYED<player>,<card>                        player played card
+ * MOVES<n>,<player>:<card>,...                 the next n moves in order,
+ *                                              sent by a batching hub
+ * GAMEOVER                                     the game has ended
 */
 
 #include "2310baseplayer.h"
+#include "2310multi.h"
+
+static Channel hub;
+// seat given on the command line, -1 with --multi
+static int seat = -1;
+
+/**
+ * writes a message straight to the hub
+ *
+ * @param message   message to write
+ * @param length    length of message
+ */
+static void write_message(const char* message, int length) {
+    channel_write(&hub, message, length);
+}
+
+/**
+ * nothing is ever held back by write_message
+ */
+static void no_wait(void) {
+}
+
+static PlayerIo playerIo = {write_message, no_wait};
 
 /**
  * inits the player and checks args
@@ -53,6 +90,7 @@ void init_player(char** argv, GameStats* gameStats) {
     gameStats->position = position;
     gameStats->handSize = handSize;
     gameStats->threshold = threshold;
+    seat = position;
 }
 
 /**
@@ -60,15 +98,16 @@ void init_player(char** argv, GameStats* gameStats) {
  *
  * @param size      number of cards in hand
  * @param cards     array of char[2] cards to get values from
- * @param hand      pointer to list of cards to init into
+ * @param hand      mask of ranks held for each suit to init into
  */
-void init_hand(int size, char** cards, Card** hand) {
+void init_hand(int size, char** cards, uint32_t* hand) {
     for (int i = 0; i < size; i++) {
         if (!valid_card(cards[i][0], cards[i][1])) {
             quit_on_error(BADMESSAGE);
         }
-        (*hand)[i].suit = cards[i][0];
-        (*hand)[i].rank = cards[i][1];
+        Card card = {cards[i][0], cards[i][1]};
+        int index = card_index(card);
+        hand[index / NUM_RANKS] |= 1u << (index % NUM_RANKS);
     }
 }
 
@@ -78,17 +117,11 @@ void init_hand(int size, char** cards, Card** hand) {
  * @param instruction   pointer to instruction to put values into
  */
 void get_instruction(Instruction* instruction) {
-    char buffer[BUFFER_SIZE];
-
-    char* rs = fgets(buffer, BUFFER_SIZE, stdin);
-    if (rs == NULL) {
+    char* buffer = player_receive();
+    if (buffer == NULL) {
         quit_on_error(UNEXPECTEDEOF);
     }
-    if (buffer[strlen(rs) - 1] == '\n') {
-        buffer[strlen(rs) - 1] = 0;
-    } else {
-        fclose(stdin);
-    }
+    int64_t traced = trace_begin();
 
     char* type = calloc(MAX_INSTRUCTION_LEN, sizeof(char));
     get_instruction_type(buffer, &type);
@@ -105,6 +138,8 @@ void get_instruction(Instruction* instruction) {
         get_newround_args(buffer, &argc, &args);
     } else if (strcmp(type, "PLAYED") == 0) {
         get_played_args(buffer, &argc, &args);
+    } else if (strcmp(type, "MOVES") == 0) {
+        get_moves_args(buffer, &argc, &args);
     } else if (strcmp(type, "GAMEOVER") == 0) {
         quit_on_error(OK); // not actually error lul
     } else {
@@ -114,6 +149,20 @@ void get_instruction(Instruction* instruction) {
     instruction->type = type;
     instruction->argc = argc;
     instruction->args = args;
+    trace_end("parse", traced, NULL, 0);
+}
+
+/**
+ * frees the type and args of an instruction
+ *
+ * @param instruction   instruction to free
+ */
+void free_instruction(Instruction* instruction) {
+    for (int i = 0; i < instruction->argc; i++) {
+        free(instruction->args[i]);
+    }
+    free(instruction->args);
+    free(instruction->type);
 }
 
 /**
@@ -126,14 +175,11 @@ void get_instruction_type(char* message, char** instructionType) {
     const char* messages[] = {"HAND",
             "NEWROUND",
             "PLAYED",
+            "MOVES",
             "GAMEOVER"};
-    char* buffer = calloc(strlen(message), sizeof(char));
-    for (int i = 0; i < 4; i++) {
-        strcpy(buffer, message);
-        buffer[strlen(messages[i])] = 0;
-        buffer[strlen(message)] = 0;
-        if (strcmp(buffer, messages[i]) == 0) {
-            strcpy(*instructionType, buffer);
+    for (int i = 0; i < 5; i++) {
+        if (strncmp(message, messages[i], strlen(messages[i])) == 0) {
+            strcpy(*instructionType, messages[i]);
             return;
         }
     }
@@ -148,7 +194,7 @@ void get_instruction_type(char* message, char** instructionType) {
  * @param args      pointer to array of char arrys of argv to put values into
  */
 void get_hand_args(char* message, int* argc, char*** args) {
-    char* buffer = calloc(strlen(message), sizeof(char));
+    char* buffer = calloc(strlen(message) + 1, sizeof(char));
     strcpy(buffer, message);
     for (int i = 0; i < strlen(buffer); i++) {
         if (buffer[i] == ',') {
@@ -157,7 +203,8 @@ void get_hand_args(char* message, int* argc, char*** args) {
         }
     }
 
-    memmove(buffer, buffer + strlen("HAND"), strlen(buffer));
+    memmove(buffer, buffer + strlen("HAND"),
+            strlen(buffer) - strlen("HAND") + 1);
 
     if (strcmp(buffer, "") == 0) {
         quit_on_error(BADMESSAGE);
@@ -169,25 +216,29 @@ void get_hand_args(char* message, int* argc, char*** args) {
         }
     }
 
-    if (strlen(message) != (5 + (3 * strtol(buffer, NULL, 10)))) {
+    // "HAND" then the count, then ",SR" for each card
+    int count = strtol(buffer, NULL, 10);
+    size_t start = strlen("HAND") + strlen(buffer);
+    if (strlen(message) != start + 3 * count) {
         quit_on_error(BADMESSAGE);
     }
+    free(buffer);
 
-    *args = calloc(strtol(buffer, NULL, 10), sizeof(char*));
-    for (int i = 0; i < strtol(buffer, NULL, 10); i++) {
-        if (8 + (3 * i) > strlen(message)) {
+    *args = calloc(count, sizeof(char*));
+    for (int i = 0; i < count; i++) {
+        if (message[start + 3 * i] != ',') {
             quit_on_error(BADMESSAGE);
         }
 
         (*args)[i] = calloc(2, sizeof(char));
-        (*args)[i][0] = message[6 + (3 * i)];
-        (*args)[i][1] = message[7 + (3 * i)];
+        (*args)[i][0] = message[start + 1 + (3 * i)];
+        (*args)[i][1] = message[start + 2 + (3 * i)];
         if (!valid_card((*args)[i][0], (*args)[i][1])) {
             quit_on_error(BADMESSAGE);
         }
     }
 
-    *argc = strtol(buffer, NULL, 10);
+    *argc = count;
 }
 
 /**
@@ -198,10 +249,11 @@ void get_hand_args(char* message, int* argc, char*** args) {
  * @param args      pointer to array of char arrys of argv to put values into
  */
 void get_newround_args(char* message, int* argc, char*** args) {
-    char* buffer = calloc(strlen(message), sizeof(char));
+    char* buffer = calloc(strlen(message) + 1, sizeof(char));
 
     strcpy(buffer, message);
-    memmove(buffer, buffer + strlen("NEWROUND"), strlen(buffer));
+    memmove(buffer, buffer + strlen("NEWROUND"),
+            strlen(buffer) - strlen("NEWROUND") + 1);
 
     if (strcmp(buffer, "") == 0) {
         quit_on_error(BADMESSAGE);
@@ -216,9 +268,7 @@ void get_newround_args(char* message, int* argc, char*** args) {
     *argc = 1;
 
     *args = calloc(*argc, sizeof(char*));
-    (*args)[0] = calloc(strlen(buffer), sizeof(char));
-
-    strcpy((*args)[0], buffer);
+    (*args)[0] = buffer;
 }
 
 /**
@@ -229,10 +279,11 @@ void get_newround_args(char* message, int* argc, char*** args) {
  * @param args      pointer to array of char arrys of argv to put values into
  */
 void get_played_args(char* message, int* argc, char*** args) {
-    char* buffer = calloc(strlen(message), sizeof(char));
+    char* buffer = calloc(strlen(message) + 1, sizeof(char));
 
     strcpy(buffer, message);
-    memmove(buffer, buffer + strlen("PLAYED"), strlen(buffer));
+    memmove(buffer, buffer + strlen("PLAYED"),
+            strlen(buffer) - strlen("PLAYED") + 1);
 
     for (int i = 0; i < strlen(buffer); i++) {
         if (buffer[i] == ',') {
@@ -254,14 +305,13 @@ void get_played_args(char* message, int* argc, char*** args) {
     *argc = 2;
 
     *args = calloc(*argc, sizeof(char*));
-    (*args)[0] = calloc(strlen(buffer), sizeof(char));
+    (*args)[0] = buffer;
     (*args)[1] = calloc(2, sizeof(char));
 
     if (strlen(message) != (9 + strlen(buffer))) {
         quit_on_error(BADMESSAGE);
     }
 
-    strcpy((*args)[0], buffer);
     (*args)[1][0] = message[7 + strlen(buffer)];
     (*args)[1][1] = message[8 + strlen(buffer)];
 
@@ -270,6 +320,230 @@ void get_played_args(char* message, int* argc, char*** args) {
     }
 }
 
+/**
+ * gets args from message received for a MOVES type instruction. args holds
+ * the player and card of each move in turn
+ *
+ * @param message   message received from stdin
+ * @param argc      pointer to int of number of agrs to put values into
+ * @param args      pointer to array of char arrys of argv to put values into
+ */
+void get_moves_args(char* message, int* argc, char*** args) {
+    char* cursor = message + strlen("MOVES");
+    char* end;
+
+    if (!isdigit((int) *cursor)) {
+        quit_on_error(BADMESSAGE);
+    }
+
+    int count = strtol(cursor, &end, 10);
+    if (count < 1) {
+        quit_on_error(BADMESSAGE);
+    }
+
+    *argc = 2 * count;
+    *args = calloc(*argc, sizeof(char*));
+
+    for (int i = 0; i < count; i++) {
+        if (*end != ',' || !isdigit((int) end[1])) {
+            quit_on_error(BADMESSAGE);
+        }
+
+        cursor = end + 1;
+        strtol(cursor, &end, 10);
+        if (*end != ':' || end[1] == 0 || end[2] == 0) {
+            quit_on_error(BADMESSAGE);
+        }
+
+        (*args)[2 * i] = calloc(end - cursor + 1, sizeof(char));
+        memcpy((*args)[2 * i], cursor, end - cursor);
+        (*args)[2 * i + 1] = calloc(2, sizeof(char));
+        (*args)[2 * i + 1][0] = end[1];
+        (*args)[2 * i + 1][1] = end[2];
+
+        if (!valid_card((*args)[2 * i + 1][0], (*args)[2 * i + 1][1])) {
+            quit_on_error(BADMESSAGE);
+        }
+
+        end += 3;
+    }
+
+    if (*end != 0) {
+        quit_on_error(BADMESSAGE);
+    }
+}
+
+/**
+ * inits what the player knows at the start of a game
+ *
+ * @param state         state to init
+ * @param playerCount   number of players in the game
+ * @param threshold     d card threshold of the game
+ */
+void init_state(PlayerState* state, int playerCount, int threshold) {
+    memset(state, 0, sizeof(PlayerState));
+    state->playerCount = playerCount;
+    state->threshold = threshold;
+}
+
+/**
+ * starts a new trick
+ *
+ * @param state         state to update
+ * @param leadPlayer    player leading the trick
+ */
+void start_trick(PlayerState* state, int leadPlayer) {
+    state->leadPlayer = leadPlayer;
+    state->played = 0;
+    state->best = 0;
+    state->dPlayed = 0;
+}
+
+/**
+ * adds the next card of the current trick, settling the trick once every
+ * player has played
+ *
+ * @param state     state to update
+ * @param card      card_index of the card played
+ */
+void record_play(PlayerState* state, int card) {
+    if (state->played > 0 &&
+            rules_beats(card, state->trick[state->best])) {
+        state->best = state->played;
+    }
+    state->trick[state->played++] = card;
+    state->dPlayed += RULES_SUIT(card) == RULES_SUIT_D;
+
+    if (state->played == state->playerCount) {
+        int winner = (state->leadPlayer + state->best) % state->playerCount;
+        state->dCards[winner] += state->dPlayed;
+        if (state->dCards[winner] > state->mostD) {
+            state->mostD = state->dCards[winner];
+        }
+    }
+}
+
+/**
+ * gets the suit led in the current trick
+ *
+ * @param state     state of the game
+ * @return          suit_index of the lead card, -1 if no card is played yet
+ */
+int lead_suit(const PlayerState* state) {
+    return state->played == 0 ? -1 : RULES_SUIT(state->trick[0]);
+}
+
+/**
+ * checks whether some player (us included) has won at least threshold - 2
+ * d cards and d cards have been played in the current trick
+ *
+ * @param state     state of the game
+ * @return          true if so, false otherwise
+ */
+bool in_danger(const PlayerState* state) {
+    return state->dPlayed > 0 && state->mostD >= state->threshold - 2;
+}
+
+/**
+ * works out the card we would play for every possible lead suit, with and
+ * without danger, so that it is ready before the hub asks for it. must be
+ * called whenever the hand changes
+ *
+ * @param cache     cache to fill
+ * @param strategy  strategy to play with
+ * @param hand      mask of ranks held for each suit
+ */
+void precompute_moves(MoveCache* cache, const StrategyTable* strategy,
+        const uint32_t* hand) {
+    for (int i = 0; i < NUM_LEADS; i++) {
+        for (int danger = 0; danger < 2; danger++) {
+            int index = strategy_choose(strategy, hand, i - 1, danger);
+            Card none = {0, 0};
+            cache->moves[i][danger] = index == -1 ? none : index_card(index);
+        }
+    }
+}
+
+/**
+ * gets the card to play in the current trick
+ *
+ * @param cache     moves precomputed for the hand we hold
+ * @param state     state of the game
+ * @return          the card to play
+ */
+Card cached_move(const MoveCache* cache, const PlayerState* state) {
+    return cache->moves[lead_suit(state) + 1][in_danger(state)];
+}
+
+/**
+ * sends a PLAY message for a card to the hub
+ *
+ * @param card  card to play
+ */
+void send_play(Card card) {
+    char message[] = {'P', 'L', 'A', 'Y', card.suit, card.rank, '\n'};
+
+    player_send(message, sizeof(message));
+}
+
+/**
+ * replaces how the player talks to the hub. players that need to can call
+ * this from player_strategy, which runs once before the handshake
+ *
+ * @param io    functions to use from now on
+ */
+void set_player_io(const PlayerIo* io) {
+    playerIo = *io;
+}
+
+/**
+ * gets our seat, for player_strategy to use
+ *
+ * @return  the seat, -1 with --multi, which has a seat in each game
+ */
+int player_seat(void) {
+    return seat;
+}
+
+/**
+ * sends a message to the hub
+ *
+ * @param message   whole message, ending with a newline
+ * @param length    length of message
+ */
+void player_send(const char* message, int length) {
+    playerIo.send(message, length);
+}
+
+/**
+ * lets the player io know we are about to wait for the hub
+ */
+void player_wait(void) {
+    playerIo.wait();
+}
+
+/**
+ * sends the handshake that tells the hub we are ready. it goes straight
+ * out, past any player io
+ */
+void player_handshake(void) {
+    channel_write(&hub, "@", 1);
+}
+
+/**
+ * gets the next message from the hub, only waiting (and calling
+ * player_wait first) if none has arrived yet
+ *
+ * @return  the message without its newline, which the caller may change
+ *          but only until the next call. NULL at EOF
+ */
+char* player_receive(void) {
+    if (!channel_ready(&hub)) {
+        player_wait();
+    }
+    return channel_read_line(&hub, NULL);
+}
+
 /**
  * main function of 2310baseplayer
  *
@@ -278,17 +552,63 @@ void get_played_args(char* message, int* argc, char*** args) {
  * @return      status. 0 if OK
  */
 int main(int argc, char** argv) {
-    if (argc != 5) {
+    bool multi = argc == 2 && strcmp(argv[1], "--multi") == 0;
+    if (argc != 5 && !multi) {
         quit_on_error(BADARGNUM);
     }
 
     GameStats gameStats;
-    init_player(argv, &gameStats);
+    if (!multi) {
+        init_player(argv, &gameStats);
+    }
+    channel_init_fd(&hub, STDIN_FILENO, STDOUT_FILENO);
+
+    // players only get the protocol args, so the log policy comes from
+    // the environment
+    LogPolicy logPolicy = LOG_BLOCK;
+    const char* logSpill = NULL;
+    if (getenv("PLAYER_LOG") != NULL &&
+            !parse_log_policy(getenv("PLAYER_LOG"), &logPolicy,
+            &logSpill)) {
+        quit_on_error(BADARGNUM);
+    }
+    if (!log_init(logPolicy, logSpill)) {
+        quit_on_error(BADARGNUM);
+    }
+
+    // a hub run with --trace passes its trace file on the same way
+    if (getenv(TRACE_ENV) != NULL) {
+        char name[BUFFER_SIZE];
+        if (multi) {
+            snprintf(name, BUFFER_SIZE, "%s --multi", argv[0]);
+        } else {
+            snprintf(name, BUFFER_SIZE, "%s seat %d", argv[0],
+                    gameStats.position);
+        }
+        trace_start(getenv(TRACE_ENV), name, false);
+    }
+
+    StrategyTable strategy;
+    const char* spec = player_strategy();
+    if (spec == NULL || !strategy_compile(spec, &strategy)) {
+        quit_on_error(BADSTRATEGY);
+    }
 
-    write(STDOUT_FILENO, "@", 1);
-    fflush(stdout);
+    if (multi) {
+        int threads = 0;
+        if (getenv("PLAYER_THREADS") != NULL) {
+            threads = strtol(getenv("PLAYER_THREADS"), NULL, 10);
+        }
+        if (threads < 0 || threads > MAX_MULTI_THREADS) {
+            threads = 0;
+        }
+        run_multi(&strategy, threads);
+        return OK;
+    }
 
-    game_loop(gameStats);
+    player_handshake();
+
+    game_loop(gameStats, &strategy);
 
     return OK;
 }
@@ -297,11 +617,18 @@ int main(int argc, char** argv) {
  * main loop for game logic
  *
  * @param gameStats stastics for the game
+ * @param strategy  compiled strategy to play with
  */
-void game_loop(GameStats gameStats) {
-    char buffer[BUFFER_SIZE];
+void game_loop(GameStats gameStats, const StrategyTable* strategy) {
+    // "Lead player=n:" then " S.r" for each player
+    char* roundHistory = calloc(BUFFER_SIZE + 4 * gameStats.playerCount,
+            sizeof(char));
     Instruction instruction;
-    Card* hand;
+    Instruction moves;
+    int nextMove = 0;
+    MoveCache cache;
+    uint32_t hand[NUM_SUITS] = {0};
+    PlayerState state;
     bool gameOver = false;
     get_instruction(&instruction);
     if (strcmp(instruction.type, "HAND") != 0) {
@@ -311,11 +638,16 @@ void game_loop(GameStats gameStats) {
             quit_on_error(BADMESSAGE);
         }
 
-        hand = calloc(instruction.argc, sizeof(Card));
-        init_hand(instruction.argc, instruction.args, &hand);
+        init_hand(instruction.argc, instruction.args, hand);
     }
+    moves.argc = 0;
+    init_state(&state, gameStats.playerCount, gameStats.threshold);
+    precompute_moves(&cache, strategy, hand);
     while (!gameOver) {
         // next we want to see a NEWROUND, quit if not
+        if (nextMove != moves.argc) {
+            quit_on_error(BADMESSAGE);
+        }
         get_instruction(&instruction);
         if (strcmp(instruction.type, "NEWROUND") != 0) {
             quit_on_error(BADMESSAGE);
@@ -328,59 +660,60 @@ void game_loop(GameStats gameStats) {
                     % gameStats.playerCount;
         }
 
-        char* roundHistory = calloc(BUFFER_SIZE, sizeof(char));
-        strcpy(roundHistory, "Lead player=");
-        sprintf(buffer, "%d", gameStats.currentPlayer);
-        strcat(roundHistory, buffer);
-        roundHistory[strlen(roundHistory)] = ':';
-
-        char lead = 0;
+        int historyLength = sprintf(roundHistory, "Lead player=%d:",
+                gameStats.currentPlayer);
+        start_trick(&state, gameStats.currentPlayer);
 
         for (int i = 0; i < gameStats.playerCount; i++) {
             if (gameStats.currentPlayer == gameStats.position) {
                 // i am the captain now
-                Card cardPlayed = play_card(lead, gameStats.handSize, hand);
-
-                roundHistory[strlen(roundHistory)] = ' ';
-                roundHistory[strlen(roundHistory)] = cardPlayed.suit;
-                roundHistory[strlen(roundHistory)] = '.';
-                roundHistory[strlen(roundHistory)] = cardPlayed.rank;
-
-                for (int i = 0; i < gameStats.handSize; i++) {
-                    if (hand[i].suit == cardPlayed.suit &&
-                            hand[i].rank == cardPlayed.rank) {
-                        hand[i].suit = 0;
-                        hand[i].rank = 0;
-                    }
-                }
+                int64_t traced = trace_begin();
+                Card cardPlayed = cached_move(&cache, &state);
+                trace_end("cached_move", traced, NULL, 0);
+                send_play(cardPlayed);
+
+                roundHistory[historyLength++] = ' ';
+                roundHistory[historyLength++] = cardPlayed.suit;
+                roundHistory[historyLength++] = '.';
+                roundHistory[historyLength++] = cardPlayed.rank;
+
+                int index = card_index(cardPlayed);
+                hand[RULES_SUIT(index)] &= ~(1u << RULES_RANK(index));
+                record_play(&state, index);
+                precompute_moves(&cache, strategy, hand);
 
                 gameStats.currentPlayer = (gameStats.position + 1)
                         % gameStats.playerCount;
             } else {
-                // expecting a PLAYED
-                get_instruction(&instruction);
-                if (strcmp(instruction.type, "PLAYED") != 0) {
-                    quit_on_error(BADMESSAGE);
+                // expecting a PLAYED, or the next move of a MOVES batch
+                if (nextMove == moves.argc) {
+                    get_instruction(&moves);
+                    if (strcmp(moves.type, "PLAYED") != 0 &&
+                            strcmp(moves.type, "MOVES") != 0) {
+                        quit_on_error(BADMESSAGE);
+                    }
+                    nextMove = 0;
                 }
 
-                if (lead == 0) {
-                    lead = instruction.args[1][0];
-                }
+                char* player = moves.args[nextMove];
+                char* card = moves.args[nextMove + 1];
+                nextMove += 2;
+
+                Card cardPlayed = {card[0], card[1]};
+                record_play(&state, card_index(cardPlayed));
 
-                roundHistory[strlen(roundHistory)] = ' ';
-                roundHistory[strlen(roundHistory)] = instruction.args[1][0];
-                roundHistory[strlen(roundHistory)] = '.';
-                roundHistory[strlen(roundHistory)] = instruction.args[1][1];
+                roundHistory[historyLength++] = ' ';
+                roundHistory[historyLength++] = card[0];
+                roundHistory[historyLength++] = '.';
+                roundHistory[historyLength++] = card[1];
 
-                gameStats.currentPlayer = (strtol(instruction.args[0], NULL, 0)
+                gameStats.currentPlayer = (strtol(player, NULL, 0)
                         + 1) % gameStats.playerCount;
             }
         }
 
-        roundHistory[strlen(roundHistory)] = '\n';
-        fputs(roundHistory, stderr);
-        fflush(stderr);
-        free(roundHistory);
+        roundHistory[historyLength++] = '\n';
+        log_write(STDERR_FILENO, roundHistory, historyLength);
     }
 }
 
@@ -398,9 +731,9 @@ void quit_on_error(Status s) {
             "Invalid threshold\n",
             "Invalid hand size\n",
             "Invalid message\n",
-            "EOF\n"};
+            "EOF\n",
+            "Invalid strategy\n"};
     fputs(messages[s], stderr);
     close(STDIN_FILENO);
-    fflush(stdout);
     exit(s);
 }
\ No newline at end of file
@@ -6,9 +6,15 @@
 #define ASS3_2310ALICE_H
 
 #include "2310shared.h"
+#include "2310log.h"
+#include "2310strategy.h"
+#include "2310rules.h"
+#include "2310trace.h"
+#include "2310channel.h"
 
 #define BUFFER_SIZE 255
-#define MAX_INSTRUCTION_LEN 8
+#define MAX_INSTRUCTION_LEN 9
+#define NUM_LEADS 5
 
 typedef enum {
     OK = 0,
@@ -18,7 +24,8 @@ typedef enum {
     BADTHRESHOLD = 4,
     BADHANDSIZE = 5,
     BADMESSAGE = 6,
-    UNEXPECTEDEOF = 7
+    UNEXPECTEDEOF = 7,
+    BADSTRATEGY = 8
 } Status;
 
 typedef struct {
@@ -35,19 +42,68 @@ typedef struct {
     char** args;
 } Instruction;
 
+/*
+ * what the player knows of the game so far, kept up to date as each card is
+ * played. trick holds the card_index of the cards of the current trick in
+ * the order they were played, and best is the position of the card winning
+ * it so far. the per player lists are indexed by player
+ */
+typedef struct {
+    int playerCount;
+    int threshold;
+    int leadPlayer;
+    int played;
+    int trick[MAX_PLAYERS];
+    int best;
+    int dPlayed;
+    int mostD;
+    int dCards[MAX_PLAYERS];
+} PlayerState;
+
+typedef struct {
+    Card moves[NUM_LEADS][2];
+} MoveCache;
+
+/*
+ * how a player talks to the hub. send writes a whole message, wait is called
+ * before each read from the hub, when anything held back must go out
+ */
+typedef struct {
+    void (*send)(const char* message, int length);
+    void (*wait)(void);
+} PlayerIo;
+
 void init_player(char** argv, GameStats* gameStats);
-void init_hand(int size, char** cards, Card** hand);
+void init_hand(int size, char** cards, uint32_t* hand);
 
 void get_instruction(Instruction* instruction);
+void free_instruction(Instruction* instruction);
 void get_instruction_type(char* message, char** instructionType);
 void get_hand_args(char* message, int* argc, char*** args);
 void get_newround_args(char* message, int* argc, char*** args);
 void get_played_args(char* message, int* argc, char*** args);
+void get_moves_args(char* message, int* argc, char*** args);
+
+void init_state(PlayerState* state, int playerCount, int threshold);
+void start_trick(PlayerState* state, int leadPlayer);
+void record_play(PlayerState* state, int card);
+int lead_suit(const PlayerState* state);
+bool in_danger(const PlayerState* state);
 
-Card play_card(char lead, int count, Card* hand);
+const char* player_strategy(void);
+void precompute_moves(MoveCache* cache, const StrategyTable* strategy,
+        const uint32_t* hand);
+Card cached_move(const MoveCache* cache, const PlayerState* state);
+void send_play(Card card);
+void set_player_io(const PlayerIo* io);
+int player_seat(void);
+void player_send(const char* message, int length);
+void player_wait(void);
+void player_handshake(void);
+char* player_receive(void);
 
 int main(int argc, char** argv);
-void game_loop(GameStats game);
+void game_loop(GameStats game, const StrategyTable* strategy);
 
 void quit_on_error(Status s);
 
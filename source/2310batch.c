@@ -0,0 +1,586 @@
+//
+// Created by caleb on 2019-10-09.
+//
+/*
+ * Batch game engine.
+ *
+ * Plays many games at once with the rules of 2310hub and the documented
+ * strategies of alice and bob, on bitmask hands. There are two
+ * implementations over the same Batch layout: a scalar one that plays each
+ * game in turn, and an AVX2 one that plays BATCH_LANES games per vector.
+ * Both must leave a batch in exactly the same state, which 2310sim --check
+ * verifies. Seats can also play compiled strategy tables, which only the
+ * scalar engine does.
+ */
+
+#include "2310batch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_HAVE_AVX2
+#endif
+
+#define SUIT_S 0
+#define SUIT_C 1
+#define SUIT_D 2
+#define SUIT_H 3
+
+static const int orderSCDH[] = {SUIT_S, SUIT_C, SUIT_D, SUIT_H};
+static const int orderDHSC[] = {SUIT_D, SUIT_H, SUIT_S, SUIT_C};
+static const int orderSCHD[] = {SUIT_S, SUIT_C, SUIT_H, SUIT_D};
+
+/**
+ * parses the name of a strategy
+ *
+ * @param name      alice or bob
+ * @param strategy  strategy to put value into
+ * @return          true if legal, false otherwise
+ */
+bool parse_strategy(const char* name, Strategy* strategy) {
+    if (strcmp(name, "alice") == 0) {
+        *strategy = STRATEGY_ALICE;
+    } else if (strcmp(name, "bob") == 0) {
+        *strategy = STRATEGY_BOB;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * picks the highest or lowest card of the first suit, in order, that the
+ * hand holds any of
+ *
+ * @param hand      mask of ranks held for each suit
+ * @param order     NUM_SUITS suits in the order to check them
+ * @param highest   true for the highest card, false for the lowest
+ * @return          card_index of the card
+ */
+static int pick_suit(const uint32_t* hand, const int* order, bool highest) {
+    for (int i = 0; i < NUM_SUITS; i++) {
+        uint32_t mask = hand[order[i]];
+        if (mask != 0) {
+            int rank = highest ? 31 - __builtin_clz(mask)
+                    : __builtin_ctz(mask);
+            return order[i] * NUM_RANKS + rank;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * alice's rules, see 2310alice.c
+ *
+ * @param hand      mask of ranks held for each suit
+ * @param leadSuit  suit of the lead card, -1 if alice is leading
+ * @return          card_index of the card to play
+ */
+int alice_choose(const uint32_t* hand, int leadSuit) {
+    if (leadSuit == -1) {
+        return pick_suit(hand, orderSCDH, true);
+    }
+
+    if (hand[leadSuit] != 0) {
+        return leadSuit * NUM_RANKS + __builtin_ctz(hand[leadSuit]);
+    }
+
+    return pick_suit(hand, orderDHSC, true);
+}
+
+/**
+ * bob's rules, see 2310bob.c
+ *
+ * @param hand      mask of ranks held for each suit
+ * @param leadSuit  suit of the lead card, -1 if bob is leading
+ * @param danger    true if some player has won at least threshold - 2
+ *                  d cards and d cards have been played this trick
+ * @return          card_index of the card to play
+ */
+int bob_choose(const uint32_t* hand, int leadSuit, bool danger) {
+    if (leadSuit == -1) {
+        return pick_suit(hand, orderDHSC, false);
+    }
+
+    if (danger) {
+        if (hand[leadSuit] != 0) {
+            return leadSuit * NUM_RANKS + 31 - __builtin_clz(hand[leadSuit]);
+        }
+        return pick_suit(hand, orderSCHD, false);
+    }
+
+    if (hand[leadSuit] != 0) {
+        return leadSuit * NUM_RANKS + __builtin_ctz(hand[leadSuit]);
+    }
+
+    return pick_suit(hand, orderSCDH, true);
+}
+
+/**
+ * makes a batch of games, rounded up to a whole number of vectors. the
+ * extra games are played but never reported
+ *
+ * @param games         number of games
+ * @param playerCount   number of players in each game
+ * @param threshold     d card threshold
+ * @param numRounds     number of rounds (cards in each hand)
+ * @param seats         strategy of each seat
+ * @return              the batch
+ */
+Batch* batch_create(int games, int playerCount, int threshold,
+        int numRounds, const Strategy* seats) {
+    Batch* batch = calloc(1, sizeof(Batch));
+    int lanes = (games + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+
+    batch->games = games;
+    batch->lanes = lanes;
+    batch->playerCount = playerCount;
+    batch->threshold = threshold;
+    batch->numRounds = numRounds;
+    for (int i = 0; i < playerCount; i++) {
+        batch->seats[i] = seats[i];
+    }
+
+    batch->hands = calloc((size_t)playerCount * NUM_SUITS * lanes,
+            sizeof(uint32_t));
+    batch->cards = calloc((size_t)playerCount * lanes, sizeof(int32_t));
+    batch->tricks = calloc((size_t)playerCount * lanes, sizeof(int32_t));
+    batch->dCards = calloc((size_t)playerCount * lanes, sizeof(int32_t));
+    batch->lead = calloc(lanes, sizeof(int32_t));
+    batch->mostD = calloc(lanes, sizeof(int32_t));
+
+    return batch;
+}
+
+/**
+ * makes a seat play a compiled strategy
+ *
+ * @param batch     batch to change
+ * @param seat      seat to change
+ * @param table     strategy the seat plays, must outlive the batch
+ */
+void batch_set_table(Batch* batch, int seat, const StrategyTable* table) {
+    batch->seats[seat] = STRATEGY_TABLE;
+    batch->tables[seat] = table;
+}
+
+/**
+ * checks whether any seat of a batch plays a strategy table
+ *
+ * @param batch     batch to check
+ * @return          true if one does, false otherwise
+ */
+bool batch_has_tables(const Batch* batch) {
+    for (int seat = 0; seat < batch->playerCount; seat++) {
+        if (batch->seats[seat] == STRATEGY_TABLE) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * deals a deck to a game the way 2310hub does: seat i gets the i'th run of
+ * numRounds cards. dealing the last game also deals the padding games
+ *
+ * @param batch     batch to deal into
+ * @param game      game to deal
+ * @param deck      at least playerCount * numRounds cards
+ */
+void batch_deal(Batch* batch, int game, const Card* deck) {
+    int last = game == batch->games - 1 ? batch->lanes : game + 1;
+
+    for (int lane = game; lane < last; lane++) {
+        for (int seat = 0; seat < batch->playerCount; seat++) {
+            for (int suit = 0; suit < NUM_SUITS; suit++) {
+                batch->hands[(seat * NUM_SUITS + suit) * batch->lanes +
+                        lane] = 0;
+            }
+            for (int i = 0; i < batch->numRounds; i++) {
+                int card = card_index(deck[seat * batch->numRounds + i]);
+                batch->hands[(seat * NUM_SUITS + card / NUM_RANKS) *
+                        batch->lanes + lane] |= 1u << (card % NUM_RANKS);
+            }
+            batch->tricks[seat * batch->lanes + lane] = 0;
+            batch->dCards[seat * batch->lanes + lane] = 0;
+        }
+        batch->lead[lane] = 0;
+        batch->mostD[lane] = 0;
+    }
+}
+
+/**
+ * deals a batch the games from first onwards of a batch that has been dealt
+ * but not played, so a set of deals can be encoded once and played many
+ * times. deals must have at least first + batch->lanes lanes
+ *
+ * @param batch     batch to deal into
+ * @param deals     dealt batch with the same players and number of rounds
+ * @param first     first game of deals to copy
+ */
+void batch_load(Batch* batch, const Batch* deals, int first) {
+    size_t size = batch->lanes * sizeof(int32_t);
+
+    for (int row = 0; row < batch->playerCount * NUM_SUITS; row++) {
+        memcpy(&batch->hands[row * batch->lanes],
+                &deals->hands[row * deals->lanes + first], size);
+    }
+    memset(batch->tricks, 0, batch->playerCount * size);
+    memset(batch->dCards, 0, batch->playerCount * size);
+    memset(batch->lead, 0, size);
+    memset(batch->mostD, 0, size);
+}
+
+/**
+ * plays one trick of one game
+ *
+ * @param batch     batch being played
+ * @param game      game to play
+ */
+static void play_trick_scalar(Batch* batch, int game) {
+    int lanes = batch->lanes;
+    int lead = batch->lead[game];
+    int leadSuit = -1, best = 0, bestPosition = 0, dPlayed = 0;
+
+    for (int position = 0; position < batch->playerCount; position++) {
+        int seat = (lead + position) % batch->playerCount;
+        uint32_t* suits = &batch->hands[seat * NUM_SUITS * lanes + game];
+        uint32_t hand[NUM_SUITS];
+        for (int suit = 0; suit < NUM_SUITS; suit++) {
+            hand[suit] = suits[suit * lanes];
+        }
+
+        bool danger = dPlayed > 0 &&
+                batch->mostD[game] >= batch->threshold - 2;
+        int card;
+        if (batch->seats[seat] == STRATEGY_ALICE) {
+            card = alice_choose(hand, leadSuit);
+        } else if (batch->seats[seat] == STRATEGY_BOB) {
+            card = bob_choose(hand, leadSuit, danger);
+        } else {
+            card = strategy_choose(batch->tables[seat], hand, leadSuit,
+                    danger);
+        }
+
+        int suit = RULES_SUIT(card);
+        int rank = RULES_RANK(card);
+        suits[suit * lanes] &= ~(1u << rank);
+        batch->cards[position * lanes + game] = card;
+
+        if (position == 0) {
+            leadSuit = suit;
+            best = card;
+        } else if (rules_beats(card, best)) {
+            best = card;
+            bestPosition = position;
+        }
+        dPlayed += suit == RULES_SUIT_D;
+    }
+
+    int winner = (lead + bestPosition) % batch->playerCount;
+    batch->tricks[winner * lanes + game]++;
+    batch->dCards[winner * lanes + game] += dPlayed;
+    if (batch->dCards[winner * lanes + game] > batch->mostD[game]) {
+        batch->mostD[game] = batch->dCards[winner * lanes + game];
+    }
+    batch->lead[game] = winner;
+}
+
+/**
+ * plays every game of a batch to the end, one game at a time
+ *
+ * @param batch     batch to play
+ */
+void batch_play_scalar(Batch* batch) {
+    for (int game = 0; game < batch->lanes; game++) {
+        for (int round = 0; round < batch->numRounds; round++) {
+            play_trick_scalar(batch, game);
+        }
+    }
+}
+
+#ifdef BATCH_HAVE_AVX2
+
+/**
+ * gets the index of the highest set bit of each lane. lanes must hold
+ * values below 2^24 so that converting to float is exact
+ *
+ * @param masks     masks to check, lanes of 0 give garbage
+ * @return          bit index of each lane
+ */
+__attribute__((target("avx2")))
+static __m256i highest_bit(__m256i masks) {
+    __m256i bits = _mm256_castps_si256(_mm256_cvtepi32_ps(masks));
+    return _mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+            _mm256_set1_epi32(127));
+}
+
+/**
+ * gets the index of the lowest set bit of each lane
+ *
+ * @param masks     masks to check, lanes of 0 give garbage
+ * @return          bit index of each lane
+ */
+__attribute__((target("avx2")))
+static __m256i lowest_bit(__m256i masks) {
+    return highest_bit(_mm256_and_si256(masks,
+            _mm256_sub_epi32(_mm256_setzero_si256(), masks)));
+}
+
+/**
+ * vector form of pick_suit
+ *
+ * @param hand      masks of ranks held for each suit
+ * @param order     NUM_SUITS suits in the order to check them
+ * @param highest   true for the highest card, false for the lowest
+ * @return          card_index of the card in each lane
+ */
+__attribute__((target("avx2")))
+static __m256i pick_suit_avx2(const __m256i* hand, const int* order,
+        bool highest) {
+    __m256i picked = _mm256_set1_epi32(-1);
+
+    // backwards, so that the first suit held wins
+    for (int i = NUM_SUITS - 1; i >= 0; i--) {
+        __m256i mask = hand[order[i]];
+        __m256i held = _mm256_cmpgt_epi32(mask, _mm256_setzero_si256());
+        __m256i rank = highest ? highest_bit(mask) : lowest_bit(mask);
+        __m256i card = _mm256_add_epi32(rank,
+                _mm256_set1_epi32(order[i] * NUM_RANKS));
+        picked = _mm256_blendv_epi8(picked, card, held);
+    }
+
+    return picked;
+}
+
+/**
+ * plays BATCH_LANES games, starting at game, to the end
+ *
+ * @param batch     batch being played
+ * @param game      first game of the vector
+ */
+__attribute__((target("avx2")))
+static void play_group_avx2(Batch* batch, int game) {
+    int lanes = batch->lanes;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i players = _mm256_set1_epi32(batch->playerCount);
+    const __m256i rankMask = _mm256_set1_epi32(NUM_RANKS - 1);
+    const __m256i suitD = _mm256_set1_epi32(SUIT_D);
+    const __m256i bob = _mm256_set1_epi32(STRATEGY_BOB);
+    const __m256i games = _mm256_add_epi32(_mm256_set1_epi32(game),
+            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i nearThreshold = _mm256_set1_epi32(batch->threshold - 3);
+    int32_t seatOf[BATCH_LANES], suitOf[BATCH_LANES], rankOf[BATCH_LANES];
+
+    for (int round = 0; round < batch->numRounds; round++) {
+        __m256i lead = _mm256_loadu_si256((__m256i*)&batch->lead[game]);
+        __m256i mostD = _mm256_loadu_si256((__m256i*)&batch->mostD[game]);
+        __m256i dangerous = _mm256_cmpgt_epi32(mostD, nearThreshold);
+        __m256i leadSuit = zero, bestRank = zero, bestPosition = zero;
+        __m256i dPlayed = zero;
+
+        for (int position = 0; position < batch->playerCount; position++) {
+            __m256i seat = _mm256_add_epi32(lead,
+                    _mm256_set1_epi32(position));
+            seat = _mm256_sub_epi32(seat, _mm256_and_si256(players,
+                    _mm256_cmpgt_epi32(seat, _mm256_sub_epi32(players,
+                    one))));
+
+            __m256i hand[NUM_SUITS];
+            for (int suit = 0; suit < NUM_SUITS; suit++) {
+                __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(
+                        _mm256_add_epi32(_mm256_slli_epi32(seat, 2),
+                        _mm256_set1_epi32(suit)), _mm256_set1_epi32(lanes)),
+                        games);
+                hand[suit] = _mm256_i32gather_epi32(
+                        (const int*)batch->hands, index, 4);
+            }
+            __m256i strategy = _mm256_i32gather_epi32(
+                    (const int*)batch->seats, seat, 4);
+
+            __m256i alice, bobCard;
+            if (position == 0) {
+                alice = pick_suit_avx2(hand, orderSCDH, true);
+                bobCard = pick_suit_avx2(hand, orderDHSC, false);
+            } else {
+                __m256i leadMask = zero;
+                for (int suit = 0; suit < NUM_SUITS; suit++) {
+                    leadMask = _mm256_blendv_epi8(leadMask, hand[suit],
+                            _mm256_cmpeq_epi32(leadSuit,
+                            _mm256_set1_epi32(suit)));
+                }
+                __m256i haveLead = _mm256_cmpgt_epi32(leadMask, zero);
+                __m256i leadBase = _mm256_slli_epi32(leadSuit, 4);
+                __m256i leadLow = _mm256_add_epi32(leadBase,
+                        lowest_bit(leadMask));
+                __m256i leadHigh = _mm256_add_epi32(leadBase,
+                        highest_bit(leadMask));
+                __m256i danger = _mm256_and_si256(dangerous,
+                        _mm256_cmpgt_epi32(dPlayed, zero));
+
+                alice = _mm256_blendv_epi8(
+                        pick_suit_avx2(hand, orderDHSC, true), leadLow,
+                        haveLead);
+                __m256i bobSafe = _mm256_blendv_epi8(
+                        pick_suit_avx2(hand, orderSCDH, true), leadLow,
+                        haveLead);
+                __m256i bobDanger = _mm256_blendv_epi8(
+                        pick_suit_avx2(hand, orderSCHD, false), leadHigh,
+                        haveLead);
+                bobCard = _mm256_blendv_epi8(bobSafe, bobDanger, danger);
+            }
+
+            __m256i card = _mm256_blendv_epi8(alice, bobCard,
+                    _mm256_cmpeq_epi32(strategy, bob));
+            __m256i suit = _mm256_srli_epi32(card, 4);
+            __m256i rank = _mm256_and_si256(card, rankMask);
+            _mm256_storeu_si256((__m256i*)&batch->cards[position * lanes +
+                    game], card);
+
+            // no scatter in AVX2, so cards leave the hands one lane at a time
+            _mm256_storeu_si256((__m256i*)seatOf, seat);
+            _mm256_storeu_si256((__m256i*)suitOf, suit);
+            _mm256_storeu_si256((__m256i*)rankOf, rank);
+            for (int i = 0; i < BATCH_LANES; i++) {
+                batch->hands[(seatOf[i] * NUM_SUITS + suitOf[i]) * lanes +
+                        game + i] &= ~(1u << rankOf[i]);
+            }
+
+            if (position == 0) {
+                leadSuit = suit;
+                bestRank = rank;
+            } else {
+                __m256i better = _mm256_and_si256(
+                        _mm256_cmpeq_epi32(suit, leadSuit),
+                        _mm256_cmpgt_epi32(rank, bestRank));
+                bestRank = _mm256_blendv_epi8(bestRank, rank, better);
+                bestPosition = _mm256_blendv_epi8(bestPosition,
+                        _mm256_set1_epi32(position), better);
+            }
+            dPlayed = _mm256_add_epi32(dPlayed, _mm256_and_si256(one,
+                    _mm256_cmpeq_epi32(suit, suitD)));
+        }
+
+        __m256i winner = _mm256_add_epi32(lead, bestPosition);
+        winner = _mm256_sub_epi32(winner, _mm256_and_si256(players,
+                _mm256_cmpgt_epi32(winner, _mm256_sub_epi32(players, one))));
+        _mm256_storeu_si256((__m256i*)&batch->lead[game], winner);
+
+        int32_t dOf[BATCH_LANES];
+        _mm256_storeu_si256((__m256i*)seatOf, winner);
+        _mm256_storeu_si256((__m256i*)dOf, dPlayed);
+        for (int i = 0; i < BATCH_LANES; i++) {
+            int index = seatOf[i] * lanes + game + i;
+            batch->tricks[index]++;
+            batch->dCards[index] += dOf[i];
+            if (batch->dCards[index] > batch->mostD[game + i]) {
+                batch->mostD[game + i] = batch->dCards[index];
+            }
+        }
+    }
+}
+
+/**
+ * checks whether this CPU can run batch_play_avx2
+ *
+ * @return  true if AVX2 is available, false otherwise
+ */
+bool batch_avx2_supported(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+/**
+ * plays every game of a batch to the end, BATCH_LANES games at a time.
+ * batches with strategy tables are played by the scalar engine
+ *
+ * @param batch     batch to play
+ */
+void batch_play_avx2(Batch* batch) {
+    if (batch_has_tables(batch)) {
+        batch_play_scalar(batch);
+        return;
+    }
+
+    for (int game = 0; game < batch->lanes; game += BATCH_LANES) {
+        play_group_avx2(batch, game);
+    }
+}
+
+#else
+
+bool batch_avx2_supported(void) {
+    return false;
+}
+
+void batch_play_avx2(Batch* batch) {
+    batch_play_scalar(batch);
+}
+
+#endif
+
+/**
+ * plays every game of a batch to the end, with AVX2 if this CPU has it
+ *
+ * @param batch     batch to play
+ */
+void batch_play(Batch* batch) {
+    if (batch_avx2_supported()) {
+        batch_play_avx2(batch);
+    } else {
+        batch_play_scalar(batch);
+    }
+}
+
+/**
+ * gets the final scores of a played game
+ *
+ * @param batch         batch that was played
+ * @param game          game to score
+ * @param finalScores   list to put each seat's score into
+ */
+void batch_scores(const Batch* batch, int game, int* finalScores) {
+    for (int seat = 0; seat < batch->playerCount; seat++) {
+        int tricks = batch->tricks[seat * batch->lanes + game];
+        int dCards = batch->dCards[seat * batch->lanes + game];
+        finalScores[seat] = rules_final_score(batch->threshold, tricks,
+                dCards);
+    }
+}
+
+/**
+ * checks whether two batches of the same shape are in exactly the same
+ * state
+ *
+ * @param a     first batch
+ * @param b     second batch
+ * @return      true if equal, false otherwise
+ */
+bool batch_equal(const Batch* a, const Batch* b) {
+    size_t seatValues = (size_t)a->playerCount * a->lanes;
+
+    return memcmp(a->hands, b->hands,
+            seatValues * NUM_SUITS * sizeof(uint32_t)) == 0 &&
+            memcmp(a->cards, b->cards, seatValues * sizeof(int32_t)) == 0 &&
+            memcmp(a->tricks, b->tricks, seatValues * sizeof(int32_t)) == 0 &&
+            memcmp(a->dCards, b->dCards, seatValues * sizeof(int32_t)) == 0 &&
+            memcmp(a->lead, b->lead, a->lanes * sizeof(int32_t)) == 0 &&
+            memcmp(a->mostD, b->mostD, a->lanes * sizeof(int32_t)) == 0;
+}
+
+/**
+ * frees a batch
+ *
+ * @param batch     batch to free
+ */
+void batch_free(Batch* batch) {
+    free(batch->hands);
+    free(batch->cards);
+    free(batch->tricks);
+    free(batch->dCards);
+    free(batch->lead);
+    free(batch->mostD);
+    free(batch);
+}
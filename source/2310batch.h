@@ -0,0 +1,72 @@
+//
+// Created by caleb on 2019-10-09.
+//
+
+#ifndef ASS3_BATCH_H
+#define ASS3_BATCH_H
+
+#include "2310shared.h"
+#include "2310strategy.h"
+#include "2310rules.h"
+
+#define BATCH_LANES 8
+#define SUIT_MASK 0xFFFF
+
+typedef enum {
+    STRATEGY_ALICE = 0,
+    STRATEGY_BOB = 1,
+    STRATEGY_TABLE = 2
+} Strategy;
+
+/*
+ * many games with the same seats, threshold and deck size, played in
+ * lockstep. every array is laid out structure-of-arrays, game fastest, so
+ * that BATCH_LANES consecutive games sit side by side:
+ *
+ * hands    [(seat * NUM_SUITS + suit) * lanes + game]  bit r set if the
+ *                                                      seat holds rank r
+ * cards    [position * lanes + game]   card_index played this trick, by
+ *                                      position from the lead
+ * tricks   [seat * lanes + game]       tricks won
+ * dCards   [seat * lanes + game]       d cards won
+ * lead     [game]                      seat leading the current trick
+ * mostD    [game]                      most d cards won by any one seat
+ *
+ * seats playing STRATEGY_TABLE use tables[seat], which the batch doesn't own
+ */
+typedef struct {
+    int games;
+    int lanes;
+    int playerCount;
+    int threshold;
+    int numRounds;
+    int32_t seats[MAX_PLAYERS];
+    const StrategyTable* tables[MAX_PLAYERS];
+    uint32_t* hands;
+    int32_t* cards;
+    int32_t* tricks;
+    int32_t* dCards;
+    int32_t* lead;
+    int32_t* mostD;
+} Batch;
+
+bool parse_strategy(const char* name, Strategy* strategy);
+
+int alice_choose(const uint32_t* hand, int leadSuit);
+int bob_choose(const uint32_t* hand, int leadSuit, bool danger);
+
+Batch* batch_create(int games, int playerCount, int threshold,
+        int numRounds, const Strategy* seats);
+void batch_set_table(Batch* batch, int seat, const StrategyTable* table);
+bool batch_has_tables(const Batch* batch);
+void batch_deal(Batch* batch, int game, const Card* deck);
+void batch_load(Batch* batch, const Batch* deals, int first);
+void batch_play_scalar(Batch* batch);
+bool batch_avx2_supported(void);
+void batch_play_avx2(Batch* batch);
+void batch_play(Batch* batch);
+void batch_scores(const Batch* batch, int game, int* finalScores);
+bool batch_equal(const Batch* a, const Batch* b);
+void batch_free(Batch* batch);
+
+#endif //ASS3_BATCH_H
@@ -5,7 +5,7 @@
 #include "2310baseplayer.h"
 
 /**
- * Picks a card to play based on alice's logic:
+ * Gets the strategy bob plays with:
  *  1.  If we are the lead player:
  *          Check each of the suits in this order D, H, S, C. If we have at
  *          least one card in the suit, play the lowest ranked one
@@ -20,78 +20,8 @@
  *  4. Check the suits in this order S, C, D, H
  *          If you have at least one card in the suit, play the highest.
  *
- * @param lead  the suit of the lead card played
- * @param count the number of cards in hand
- * @param hand  list of cards that can be played
- * @return      the card played
+ * @return  the spec of the strategy, see 2310strategy.c
  */
-Card play_card(char lead, int count, Card* hand) {
-    Card cardToPlay;
-    cardToPlay.suit = 0;
-    if (lead == 0) {
-        cardToPlay.rank = 127;
-        const char suitOrder[] = {'D', 'H', 'S', 'C'};
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < count; j++) {
-                if ((int)(hand[j].suit) == (int)suitOrder[i]) {
-                    if (cardToPlay.suit != 0) {
-                        if ((int)hand[j].rank < (int)cardToPlay.rank) {
-                            cardToPlay = hand[j];
-                        }
-                    } else {
-                        cardToPlay = hand[j];
-                    }
-                }
-            }
-
-            if (cardToPlay.suit != 0) {
-                break;
-            }
-        }
-    } else {
-        cardToPlay.rank = 0;
-        const char suitOrder[] = {'S', 'C', 'D', 'H'};
-        for (int i = 0; i < count; i++) {
-            if ((int)hand[i].suit == (int)lead) {
-                if (cardToPlay.suit != 0) {
-                    if ((int)hand[i].rank < (int)cardToPlay.rank) {
-                        cardToPlay = hand[i];
-                    }
-                } else {
-                    cardToPlay = hand[i];
-                }
-            }
-        }
-
-        if (cardToPlay.suit == 0) {
-            for (int i = 0; i < 4; i++) {
-                for (int j = 0; j < count; j++) {
-                    if ((int)(hand[j].suit) == (int)suitOrder[i]) {
-                        if (cardToPlay.suit != 0) {
-                            if ((int)hand[j].rank > (int)cardToPlay.rank) {
-                                cardToPlay = hand[j];
-                            }
-                        } else {
-                            cardToPlay = hand[j];
-                        }
-                    }
-                }
-
-                if (cardToPlay.suit != 0) {
-                    break;
-                }
-            }
-        }
-    }
-
-    char buffer[7];
-    strcpy(buffer, "PLAY");
-    buffer[4] = cardToPlay.suit;
-    buffer[5] = cardToPlay.rank;
-    strcat(buffer, "\n");
-
-    write(STDOUT_FILENO, buffer, strlen(buffer));
-    fflush(stdout);
-
-    return cardToPlay;
-}
\ No newline at end of file
+const char* player_strategy(void) {
+    return strategy_builtin("bob");
+}
@@ -0,0 +1,413 @@
+//
+// Created by caleb on 2019-10-17.
+//
+/*
+ * The result cache of tournaments, so games that have been played before
+ * aren't played again.
+ *
+ * A game is keyed by a hash of everything its result depends on: the
+ * contents of each player's program in seat order, the environment the
+ * players choose their strategy and faults from (PLAYER_STRATEGY, the spec
+ * file it names and the LOAD_ variables), the threshold and the cards
+ * dealt. If any of them changes, so does the key, so nothing has to be
+ * cleared when a strategy is rebuilt. This relies on the players being
+ * deterministic given those, which alice, bob, 2310table and 2310load are.
+ *
+ * The cache is a hash table in a file, mapped read only while a tournament
+ * looks up its games before starting any players. Results of the games it
+ * then plays are kept in memory and merged in at the end under an
+ * exclusive flock. Growing the table writes a new file and renames it over
+ * the old one, so readers never see half a table; a merge that locked the
+ * old file checks it is still the cache before writing.
+ */
+
+#include "2310cache.h"
+
+extern char** environ;
+
+/**
+ * hashes the rest of a file into a hash, then closes it
+ *
+ * @param fd    file to read
+ * @param hash  hash to add to
+ * @return      false if the file can't be read
+ */
+static bool hash_file(int fd, uint64_t* hash) {
+    char* buffer = malloc(CACHE_READ_SIZE);
+    ssize_t got;
+
+    while ((got = read(fd, buffer, CACHE_READ_SIZE)) > 0) {
+        *hash = hash_bytes(buffer, got, *hash);
+    }
+    free(buffer);
+    close(fd);
+
+    return got == 0;
+}
+
+/**
+ * hashes the contents of a player's program, finding it on PATH the same
+ * way execvp does if it has no /
+ *
+ * @param program   program as given to the hub
+ * @param hash      hash to fill in
+ * @return          false if the program can't be found or read
+ */
+bool cache_program_hash(const char* program, uint64_t* hash) {
+    char path[CACHE_PATH_SIZE];
+    const char* search = getenv("PATH");
+    int fd = -1;
+
+    if (strchr(program, '/') != NULL) {
+        fd = open(program, O_RDONLY);
+    }
+    while (fd == -1 && strchr(program, '/') == NULL && search != NULL) {
+        const char* end = strchr(search, ':');
+        int length = end == NULL ? strlen(search) : end - search;
+        snprintf(path, CACHE_PATH_SIZE, "%.*s/%s", length, search, program);
+        if (access(path, X_OK) == 0) {
+            fd = open(path, O_RDONLY);
+        }
+        search = end == NULL ? NULL : end + 1;
+    }
+    if (fd == -1) {
+        return false;
+    }
+
+    *hash = HASH_START;
+    return hash_file(fd, hash);
+}
+
+/**
+ * hashes the environment players pick their strategy and faults from:
+ * PLAYER_STRATEGY, the contents of the spec file if it names one, and
+ * every LOAD_ variable in any order
+ *
+ * @return  the hash
+ */
+uint64_t cache_environment_hash(void) {
+    const char* strategy = getenv("PLAYER_STRATEGY");
+    uint64_t hash = HASH_START;
+    uint64_t load = 0;
+
+    if (strategy != NULL) {
+        hash = hash_bytes(strategy, strlen(strategy) + 1, hash);
+        int fd = open(strategy, O_RDONLY);
+        if (fd != -1) {
+            hash_file(fd, &hash);
+        }
+    }
+    for (char** variable = environ; *variable != NULL; variable++) {
+        if (strncmp(*variable, "LOAD_", strlen("LOAD_")) == 0) {
+            load ^= hash_bytes(*variable, strlen(*variable), HASH_START);
+        }
+    }
+
+    return hash_bytes(&load, sizeof(load), hash);
+}
+
+/**
+ * opens and flocks the cache file, making sure it is still the cache once
+ * the lock is held (it may have been replaced while waiting)
+ *
+ * @param path      file of the cache
+ * @param flags     open flags
+ * @param operation LOCK_SH or LOCK_EX
+ * @return          the locked file, -1 on failure
+ */
+static int lock_cache(const char* path, int flags, int operation) {
+    struct stat opened, current;
+
+    while (true) {
+        int fd = open(path, flags | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            return -1;
+        }
+        if (flock(fd, operation) == -1 || fstat(fd, &opened) == -1) {
+            close(fd);
+            return -1;
+        }
+        if (stat(path, &current) == 0 && current.st_dev == opened.st_dev &&
+                current.st_ino == opened.st_ino) {
+            return fd;
+        }
+        close(fd);
+    }
+}
+
+/**
+ * checks a mapped cache is whole and for this many players
+ *
+ * @param cache     cache of the tournament
+ * @param table     the mapped file
+ * @param size      size of the file
+ * @return          true if the table can be used
+ */
+static bool valid_table(ResultCache* cache, CacheHeader* table, size_t size) {
+    return size >= sizeof(CacheHeader) && table->magic == CACHE_MAGIC &&
+            table->version == CACHE_VERSION &&
+            table->playerCount == cache->playerCount && table->slots > 0 &&
+            (table->slots & (table->slots - 1)) == 0 &&
+            size == sizeof(CacheHeader) + table->slots * cache->entrySize;
+}
+
+/**
+ * gets an entry of a table
+ *
+ * @param table     the table
+ * @param entrySize size of an entry
+ * @param slot      number of the entry
+ * @return          the entry
+ */
+static char* table_entry(CacheHeader* table, size_t entrySize,
+        uint64_t slot) {
+    return (char*)(table + 1) + slot * entrySize;
+}
+
+/**
+ * finds the slot holding a key, or the empty slot it would go in
+ *
+ * @param table     the table
+ * @param entrySize size of an entry
+ * @param key       key to find
+ * @return          the entry of the slot, NULL if the table is full
+ */
+static char* find_slot(CacheHeader* table, size_t entrySize, uint64_t key) {
+    uint64_t mixed = key * CACHE_MIX;
+    uint64_t slot = (mixed ^ mixed >> 32) & (table->slots - 1);
+
+    for (uint64_t i = 0; i < table->slots; i++) {
+        char* entry = table_entry(table, entrySize, slot);
+        uint64_t found = *(uint64_t*)entry;
+        if (found == key || found == 0) {
+            return entry;
+        }
+        slot = (slot + 1) & (table->slots - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * adds an entry to a table, unless its key is already there. the scores
+ * go in before the key, so a reader never sees a key without them
+ *
+ * @param table     the table
+ * @param entrySize size of an entry
+ * @param entry     entry to add
+ */
+static void insert_entry(CacheHeader* table, size_t entrySize,
+        const char* entry) {
+    char* slot = find_slot(table, entrySize, *(const uint64_t*)entry);
+
+    if (slot == NULL || *(uint64_t*)slot != 0) {
+        return;
+    }
+    memcpy(slot + sizeof(uint64_t), entry + sizeof(uint64_t),
+            entrySize - sizeof(uint64_t));
+    *(uint64_t*)slot = *(const uint64_t*)entry;
+    table->count++;
+}
+
+/**
+ * opens the cache of a tournament and maps it for cache_find, holding a
+ * shared lock until cache_release
+ *
+ * @param cache         cache to init
+ * @param path          file of the cache, which needn't exist yet
+ * @param playerCount   number of seats
+ * @return              false if the cache can't be read or is for a
+ *                      different number of players
+ */
+bool cache_open(ResultCache* cache, const char* path, int playerCount) {
+    struct stat info;
+
+    memset(cache, 0, sizeof(ResultCache));
+    cache->playerCount = playerCount;
+    cache->entrySize = (sizeof(uint64_t) + playerCount * sizeof(int32_t) +
+            sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    if (snprintf(cache->path, CACHE_PATH_SIZE, "%s", path) >=
+            CACHE_PATH_SIZE || snprintf(cache->tempPath, CACHE_PATH_SIZE,
+            "%s.tmp", path) >= CACHE_PATH_SIZE) {
+        return false;
+    }
+
+    cache->fd = lock_cache(path, O_RDONLY, LOCK_SH);
+    if (cache->fd == -1) {
+        // no cache yet, so every game is new
+        return errno == ENOENT;
+    }
+    if (fstat(cache->fd, &info) == -1) {
+        return false;
+    }
+    if (info.st_size == 0) {
+        // created by a merge that hasn't written it yet
+        return true;
+    }
+
+    cache->table = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, cache->fd,
+            0);
+    if (cache->table == MAP_FAILED) {
+        cache->table = NULL;
+        return false;
+    }
+    cache->tableSize = info.st_size;
+
+    return valid_table(cache, cache->table, cache->tableSize);
+}
+
+/**
+ * looks up the result of a game
+ *
+ * @param cache     cache of the tournament
+ * @param key       key of the game
+ * @return          score of each seat, NULL if the game isn't cached.
+ *                  only valid until cache_release
+ */
+const int32_t* cache_find(ResultCache* cache, uint64_t key) {
+    if (cache->table == NULL) {
+        return NULL;
+    }
+
+    char* entry = find_slot(cache->table, cache->entrySize, key);
+    if (entry == NULL || *(uint64_t*)entry != key) {
+        return NULL;
+    }
+
+    return (const int32_t*)(entry + sizeof(uint64_t));
+}
+
+/**
+ * unmaps the cache and lets others merge into it
+ *
+ * @param cache     cache of the tournament
+ */
+void cache_release(ResultCache* cache) {
+    if (cache->table != NULL) {
+        munmap(cache->table, cache->tableSize);
+        cache->table = NULL;
+    }
+    if (cache->fd != -1) {
+        close(cache->fd);
+        cache->fd = -1;
+    }
+}
+
+/**
+ * keeps the result of a game played, to merge into the cache at the end
+ *
+ * @param cache     cache of the tournament
+ * @param key       key of the game
+ * @param scores    score of each seat
+ */
+void cache_add(ResultCache* cache, uint64_t key, const int32_t* scores) {
+    if (cache->addedCount == cache->addedSize) {
+        cache->addedSize = cache->addedSize == 0 ? CACHE_START_SLOTS
+                : 2 * cache->addedSize;
+        cache->added = realloc(cache->added,
+                cache->addedSize * cache->entrySize);
+    }
+
+    char* entry = cache->added + cache->addedCount++ * cache->entrySize;
+    memset(entry, 0, cache->entrySize);
+    memcpy(entry, &key, sizeof(key));
+    memcpy(entry + sizeof(key), scores,
+            cache->playerCount * sizeof(int32_t));
+}
+
+/**
+ * writes a table of slots entries holding the old table's entries and the
+ * added ones, and renames it over the cache
+ *
+ * @param cache     cache of the tournament
+ * @param old       the current table, NULL if there isn't one
+ * @param slots     number of slots in the new table
+ * @return          false if it couldn't be written
+ */
+static bool rebuild_table(ResultCache* cache, CacheHeader* old,
+        uint64_t slots) {
+    size_t size = sizeof(CacheHeader) + slots * cache->entrySize;
+    int fd = open(cache->tempPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+            0644);
+
+    if (fd == -1) {
+        return false;
+    }
+    CacheHeader* table = ftruncate(fd, size) == -1 ? MAP_FAILED
+            : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (table == MAP_FAILED) {
+        return false;
+    }
+
+    table->magic = CACHE_MAGIC;
+    table->version = CACHE_VERSION;
+    table->playerCount = cache->playerCount;
+    table->slots = slots;
+    for (uint64_t i = 0; old != NULL && i < old->slots; i++) {
+        char* entry = table_entry(old, cache->entrySize, i);
+        if (*(uint64_t*)entry != 0) {
+            insert_entry(table, cache->entrySize, entry);
+        }
+    }
+    for (long i = 0; i < cache->addedCount; i++) {
+        insert_entry(table, cache->entrySize,
+                cache->added + i * cache->entrySize);
+    }
+
+    bool written = msync(table, size, MS_SYNC) == 0;
+    munmap(table, size);
+    return written && rename(cache->tempPath, cache->path) == 0;
+}
+
+/**
+ * merges the results of the games played into the cache, growing it if it
+ * would be more than half full
+ *
+ * @param cache     cache of the tournament
+ * @return          false if the cache couldn't be written
+ */
+bool cache_merge(ResultCache* cache) {
+    struct stat info;
+    CacheHeader* old = NULL;
+    uint64_t slots = CACHE_START_SLOTS;
+    bool merged = false;
+
+    if (cache->addedCount == 0) {
+        return true;
+    }
+
+    int fd = lock_cache(cache->path, O_RDWR | O_CREAT, LOCK_EX);
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        return false;
+    }
+    if (info.st_size > 0) {
+        old = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+        if (old == MAP_FAILED || !valid_table(cache, old, info.st_size)) {
+            close(fd);
+            return false;
+        }
+        slots = old->slots;
+    }
+
+    uint64_t count = old == NULL ? 0 : old->count;
+    while ((count + cache->addedCount) * 2 > slots) {
+        slots *= 2;
+    }
+    if (old != NULL && slots == old->slots) {
+        for (long i = 0; i < cache->addedCount; i++) {
+            insert_entry(old, cache->entrySize,
+                    cache->added + i * cache->entrySize);
+        }
+        merged = msync(old, info.st_size, MS_SYNC) == 0;
+    } else {
+        merged = rebuild_table(cache, old, slots);
+    }
+
+    if (old != NULL) {
+        munmap(old, info.st_size);
+    }
+    close(fd);
+    return merged;
+}
@@ -0,0 +1,66 @@
+//
+// Created by caleb on 2019-10-17.
+//
+
+#ifndef ASS3_CACHE_H
+#define ASS3_CACHE_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "2310shared.h"
+
+#define CACHE_MAGIC 0x32333124
+#define CACHE_VERSION 1
+#define CACHE_START_SLOTS 4096
+#define CACHE_PATH_SIZE 4096
+#define CACHE_READ_SIZE 65536
+#define CACHE_MIX 0x9e3779b97f4a7c15ULL
+
+/*
+ * a result cache file is a CacheHeader then slots entries, an open
+ * addressed hash table with linear probing. each entry is a uint64_t key,
+ * 0 for an empty slot, then an int32_t score per seat, padded to 8 bytes.
+ * it is never more than half full
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t playerCount;
+    int32_t reserved;
+    uint64_t slots;
+    uint64_t count;
+} CacheHeader;
+
+/*
+ * the result cache of a tournament. table is the cache mapped read only
+ * (NULL if there isn't one yet) and added holds the results of games
+ * played this run, until they are merged into the file
+ */
+typedef struct {
+    char path[CACHE_PATH_SIZE];
+    char tempPath[CACHE_PATH_SIZE];
+    int playerCount;
+    size_t entrySize;
+    int fd;
+    CacheHeader* table;
+    size_t tableSize;
+    char* added;
+    long addedCount;
+    long addedSize;
+} ResultCache;
+
+bool cache_program_hash(const char* program, uint64_t* hash);
+uint64_t cache_environment_hash(void);
+bool cache_open(ResultCache* cache, const char* path, int playerCount);
+const int32_t* cache_find(ResultCache* cache, uint64_t key);
+void cache_release(ResultCache* cache);
+void cache_add(ResultCache* cache, uint64_t key, const int32_t* scores);
+bool cache_merge(ResultCache* cache);
+
+#endif //ASS3_CACHE_H
@@ -0,0 +1,209 @@
+//
+// Created by caleb on 2019-10-19.
+//
+/*
+ * Buffered line I/O for a player talking to its hub.
+ *
+ * Reading asks the transport for as much as it has, so one read() takes in
+ * every message the hub has sent so far and the rest are handed out from
+ * the buffer without another system call. The buffer grows to fit a line of
+ * any length. Writing sends each message whole in one call, which the hub
+ * and PLAYER_THREADS workers rely on to keep messages from mixing.
+ *
+ * The transport is a pair of functions, so a pipe, a socketpair or
+ * anything else that can read what has arrived and write a message can
+ * carry the same channel. channel_init_fd gives the one for files.
+ */
+
+#include "2310channel.h"
+
+/**
+ * reads what has arrived on the in file
+ *
+ * @param channel   channel to read for
+ * @param buffer    buffer to read into
+ * @param size      most bytes to read
+ * @return          bytes read, 0 at EOF, -1 on error
+ */
+static ssize_t fd_read(Channel* channel, char* buffer, size_t size) {
+    return read(channel->in, buffer, size);
+}
+
+/**
+ * writes to the out file
+ *
+ * @param channel   channel to write for
+ * @param data      bytes to write
+ * @param length    number of bytes
+ * @return          bytes written, -1 on error
+ */
+static ssize_t fd_write(Channel* channel, const char* data, size_t length) {
+    return write(channel->out, data, length);
+}
+
+static const ChannelOps fdOps = {fd_read, fd_write};
+
+/**
+ * inits a channel over any transport
+ *
+ * @param channel   channel to init
+ * @param ops       how the transport reads and writes
+ * @param transport state of the transport, for ops to use
+ */
+void channel_init(Channel* channel, const ChannelOps* ops, void* transport) {
+    memset(channel, 0, sizeof(Channel));
+    channel->ops = ops;
+    channel->transport = transport;
+    channel->in = -1;
+    channel->out = -1;
+    channel->size = CHANNEL_START_SIZE;
+    channel->buffer = malloc(channel->size);
+}
+
+/**
+ * inits a channel over a pair of files, such as stdin and stdout, or both
+ * ends being one socket
+ *
+ * @param channel   channel to init
+ * @param in        file to read from
+ * @param out       file to write to
+ */
+void channel_init_fd(Channel* channel, int in, int out) {
+    channel_init(channel, &fdOps, NULL);
+    channel->in = in;
+    channel->out = out;
+}
+
+/**
+ * finds the end of the next line in the buffer
+ *
+ * @param channel   channel to look in
+ * @return          the newline, NULL if no whole line is buffered
+ */
+static char* find_newline(Channel* channel) {
+    char* from = channel->buffer + channel->start + channel->scanned;
+    char* newline = memchr(from, '\n', channel->end - channel->start -
+            channel->scanned);
+
+    if (newline == NULL) {
+        channel->scanned = channel->end - channel->start;
+    }
+    return newline;
+}
+
+/**
+ * reads whatever has arrived onto the end of the buffer, moving the part
+ * line left over to the front and growing the buffer if it is short of
+ * room
+ *
+ * @param channel   channel to read for
+ */
+static void fill(Channel* channel) {
+    if (channel->start > 0) {
+        memmove(channel->buffer, channel->buffer + channel->start,
+                channel->end - channel->start);
+        channel->end -= channel->start;
+        channel->start = 0;
+    }
+
+    // a byte is kept spare to end a last line that has no newline
+    if (channel->size - channel->end < CHANNEL_READ_SIZE + 1) {
+        while (channel->size - channel->end < CHANNEL_READ_SIZE + 1) {
+            channel->size *= 2;
+        }
+        channel->buffer = realloc(channel->buffer, channel->size);
+    }
+
+    ssize_t got;
+    do {
+        got = channel->ops->read(channel, channel->buffer + channel->end,
+                channel->size - channel->end - 1);
+    } while (got == -1 && errno == EINTR);
+
+    if (got <= 0) {
+        channel->eof = true;
+    } else {
+        channel->end += got;
+    }
+}
+
+/**
+ * checks whether channel_read_line can return without reading
+ *
+ * @param channel   channel to check
+ * @return          true if a whole line is buffered or the channel is done
+ */
+bool channel_ready(Channel* channel) {
+    return channel->eof || find_newline(channel) != NULL;
+}
+
+/**
+ * gets the next line, reading only if no whole line is buffered. a last
+ * line with no newline before EOF is still returned
+ *
+ * @param channel   channel to read from
+ * @param length    pointer to put the length of the line into, or NULL
+ * @return          the line without its newline, which the caller may
+ *                  change but only until the next read. NULL at EOF
+ */
+char* channel_read_line(Channel* channel, size_t* length) {
+    char* newline;
+
+    while ((newline = find_newline(channel)) == NULL) {
+        if (channel->eof) {
+            if (channel->start == channel->end) {
+                return NULL;
+            }
+            newline = channel->buffer + channel->end;
+            break;
+        }
+        fill(channel);
+    }
+
+    char* line = channel->buffer + channel->start;
+    *newline = 0;
+    if (length != NULL) {
+        *length = newline - line;
+    }
+
+    channel->start = newline - channel->buffer;
+    if (channel->start < channel->end) {
+        channel->start++;
+    }
+    channel->scanned = 0;
+    return line;
+}
+
+/**
+ * sends a whole message, in one write unless the transport takes less
+ *
+ * @param channel   channel to write to
+ * @param message   message to send
+ * @param length    length of message
+ * @return          false if the transport failed
+ */
+bool channel_write(Channel* channel, const char* message, size_t length) {
+    while (length > 0) {
+        ssize_t written = channel->ops->write(channel, message, length);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        message += written;
+        length -= written;
+    }
+
+    return true;
+}
+
+/**
+ * frees the buffer of a channel. the transport is left open
+ *
+ * @param channel   channel to free
+ */
+void channel_free(Channel* channel) {
+    free(channel->buffer);
+    channel->buffer = NULL;
+}
@@ -0,0 +1,53 @@
+//
+// Created by caleb on 2019-10-19.
+//
+
+#ifndef ASS3_CHANNEL_H
+#define ASS3_CHANNEL_H
+
+#include <errno.h>
+
+#include "2310shared.h"
+
+#define CHANNEL_START_SIZE 4096
+#define CHANNEL_READ_SIZE 4096
+
+typedef struct Channel Channel;
+
+/*
+ * how a channel moves bytes. read gets up to size bytes of whatever has
+ * arrived, blocking only if nothing has, and returns 0 at EOF. write sends
+ * some of a message and returns how much. both return -1 on error
+ */
+typedef struct {
+    ssize_t (*read)(Channel* channel, char* buffer, size_t size);
+    ssize_t (*write)(Channel* channel, const char* data, size_t length);
+} ChannelOps;
+
+/*
+ * a line based connection to the other end. buffer holds bytes read but not
+ * yet handed out, from start to end, and scanned of them after start are
+ * known to hold no newline. in and out are the files of the fd transport,
+ * transport is for any other to keep its state in
+ */
+struct Channel {
+    const ChannelOps* ops;
+    void* transport;
+    int in;
+    int out;
+    char* buffer;
+    size_t size;
+    size_t start;
+    size_t end;
+    size_t scanned;
+    bool eof;
+};
+
+void channel_init(Channel* channel, const ChannelOps* ops, void* transport);
+void channel_init_fd(Channel* channel, int in, int out);
+bool channel_ready(Channel* channel);
+char* channel_read_line(Channel* channel, size_t* length);
+bool channel_write(Channel* channel, const char* message, size_t length);
+void channel_free(Channel* channel);
+
+#endif //ASS3_CHANNEL_H
@@ -0,0 +1,283 @@
+//
+// Created by caleb on 2019-10-17.
+//
+/*
+ * Checkpoints of a tournament, so --resume can carry on a run that was
+ * stopped part way.
+ *
+ * Game g of a tournament is always the same deal (seed + g), so a run only
+ * needs to remember which games have finished and the total scores. Every
+ * CHECKPOINT_SECONDS these are written to a temporary file, synced and
+ * renamed over the checkpoint, so it is always a whole checkpoint. Between
+ * checkpoints each finished game is appended to the journal, and the
+ * journal is emptied once the next checkpoint is in place.
+ *
+ * Resuming reads the checkpoint and replays the journal over it, skipping
+ * games the checkpoint already has (the run may have stopped between the
+ * rename and emptying the journal). Games that were in progress are
+ * simply played again.
+ */
+
+#include "2310checkpoint.h"
+
+/**
+ * reads exactly length bytes
+ *
+ * @param fd        file to read
+ * @param data      where to put them
+ * @param length    number of bytes
+ * @return          true if they were all read
+ */
+static bool read_all(int fd, void* data, size_t length) {
+    size_t got = 0;
+
+    while (got < length) {
+        ssize_t result = read(fd, (char*)data + got, length - got);
+        if (result <= 0) {
+            return false;
+        }
+        got += result;
+    }
+
+    return true;
+}
+
+/**
+ * hashes the id and scores of the journal record being read or written
+ *
+ * @param checkpoint    checkpoint holding the record
+ * @return              the check of the record
+ */
+static uint64_t record_check(Checkpoint* checkpoint) {
+    JournalRecord* record = (JournalRecord*)checkpoint->record;
+
+    return hash_bytes(record + 1, checkpoint->recordSize -
+            sizeof(JournalRecord), hash_bytes(&record->id,
+            sizeof(record->id), HASH_START));
+}
+
+/**
+ * adds the games in the journal that the checkpoint doesn't have yet
+ *
+ * @param checkpoint    checkpoint that has been read
+ */
+static void replay_journal(Checkpoint* checkpoint) {
+    JournalRecord* record = (JournalRecord*)checkpoint->record;
+    int32_t* scores = (int32_t*)(record + 1);
+    int fd = open(checkpoint->journalPath, O_RDONLY);
+
+    if (fd == -1) {
+        return;
+    }
+
+    while (read_all(fd, record, checkpoint->recordSize) &&
+            record->check == record_check(checkpoint) && record->id >= 0 &&
+            record->id < checkpoint->header.games) {
+        if (checkpoint->done[record->id]) {
+            continue;
+        }
+        checkpoint->done[record->id] = true;
+        for (int i = 0; i < checkpoint->header.playerCount; i++) {
+            checkpoint->totals[i] += scores[i];
+        }
+        checkpoint->header.finished++;
+        if (record->id >= checkpoint->highest) {
+            checkpoint->highest = record->id + 1;
+        }
+    }
+    close(fd);
+}
+
+/**
+ * reads the checkpoint and its journal, if there is one
+ *
+ * @param checkpoint    checkpoint with the settings of this run
+ * @return              false if the checkpoint can't be read or is of a
+ *                      different tournament
+ */
+static bool read_checkpoint(Checkpoint* checkpoint) {
+    CheckpointHeader* header = &checkpoint->header;
+    CheckpointHeader saved;
+    int fd = open(checkpoint->path, O_RDONLY);
+
+    if (fd == -1) {
+        // nothing to resume yet, so start from the beginning
+        return errno == ENOENT;
+    }
+
+    bool valid = read_all(fd, &saved, sizeof(saved)) &&
+            saved.magic == CHECKPOINT_MAGIC &&
+            saved.version == CHECKPOINT_VERSION &&
+            saved.playerCount == header->playerCount &&
+            saved.threshold == header->threshold &&
+            saved.games == header->games && saved.seed == header->seed &&
+            saved.deckHash == header->deckHash && saved.watermark >= 0 &&
+            saved.watermark <= saved.games &&
+            read_all(fd, checkpoint->totals,
+            header->playerCount * sizeof(int64_t));
+    for (int64_t i = 0; valid && i < saved.aboveCount; i++) {
+        int64_t id;
+        valid = read_all(fd, &id, sizeof(id)) && id >= saved.watermark &&
+                id < saved.games;
+        if (valid) {
+            checkpoint->done[id] = true;
+            checkpoint->highest = id + 1;
+        }
+    }
+    close(fd);
+    if (!valid) {
+        return false;
+    }
+
+    for (int64_t i = 0; i < saved.watermark; i++) {
+        checkpoint->done[i] = true;
+    }
+    header->finished = saved.finished;
+    header->watermark = saved.watermark;
+    if (checkpoint->highest < saved.watermark) {
+        checkpoint->highest = saved.watermark;
+    }
+    replay_journal(checkpoint);
+
+    return true;
+}
+
+/**
+ * opens the checkpoint of a tournament, reading it first if resuming, and
+ * writes a fresh one with an empty journal
+ *
+ * @param checkpoint    checkpoint to init
+ * @param path          file of the checkpoint
+ * @param settings      playerCount, threshold, games, seed and deckHash
+ *                      of the tournament
+ * @param done          finished flag of each game, all false. filled in
+ *                      from the checkpoint when resuming
+ * @param totals        total score of each seat, all 0. filled in from
+ *                      the checkpoint when resuming
+ * @param resume        true to carry on from the checkpoint
+ * @return              false if the checkpoint couldn't be read or written
+ */
+bool checkpoint_open(Checkpoint* checkpoint, const char* path,
+        const CheckpointHeader* settings, bool* done, int64_t* totals,
+        bool resume) {
+    CheckpointHeader* header = &checkpoint->header;
+
+    *header = *settings;
+    header->magic = CHECKPOINT_MAGIC;
+    header->version = CHECKPOINT_VERSION;
+    header->finished = 0;
+    header->watermark = 0;
+    header->aboveCount = 0;
+    checkpoint->done = done;
+    checkpoint->totals = totals;
+    checkpoint->highest = 0;
+    checkpoint->recordSize = sizeof(JournalRecord) +
+            header->playerCount * sizeof(int32_t);
+    checkpoint->record = malloc(checkpoint->recordSize);
+    if (snprintf(checkpoint->path, CHECKPOINT_PATH_SIZE, "%s", path) >=
+            CHECKPOINT_PATH_SIZE ||
+            snprintf(checkpoint->tempPath, CHECKPOINT_PATH_SIZE, "%s.tmp",
+            path) >= CHECKPOINT_PATH_SIZE ||
+            snprintf(checkpoint->journalPath, CHECKPOINT_PATH_SIZE,
+            "%s.journal", path) >= CHECKPOINT_PATH_SIZE) {
+        return false;
+    }
+
+    if (resume && !read_checkpoint(checkpoint)) {
+        return false;
+    }
+
+    // emptied first, so an old run's games can't end up in this one's
+    checkpoint->journal = open(checkpoint->journalPath,
+            O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (checkpoint->journal == -1 ||
+            ftruncate(checkpoint->journal, 0) == -1) {
+        return false;
+    }
+
+    return checkpoint_write(checkpoint);
+}
+
+/**
+ * journals a finished game, and writes a checkpoint if one is due
+ *
+ * @param checkpoint    checkpoint of the tournament
+ * @param id            id of the game
+ * @param scores        score of each seat
+ * @return              false if the game couldn't be saved
+ */
+bool checkpoint_game(Checkpoint* checkpoint, long id, const int32_t* scores) {
+    JournalRecord* record = (JournalRecord*)checkpoint->record;
+
+    record->id = id;
+    memcpy(record + 1, scores, checkpoint->recordSize - sizeof(JournalRecord));
+    record->check = record_check(checkpoint);
+    if (write(checkpoint->journal, record, checkpoint->recordSize) !=
+            (ssize_t)checkpoint->recordSize) {
+        return false;
+    }
+
+    checkpoint->header.finished++;
+    if (id >= checkpoint->highest) {
+        checkpoint->highest = id + 1;
+    }
+
+    return now_seconds() - checkpoint->written < CHECKPOINT_SECONDS ||
+            checkpoint_write(checkpoint);
+}
+
+/**
+ * replaces the checkpoint with one of the games finished so far and empties
+ * the journal
+ *
+ * @param checkpoint    checkpoint of the tournament
+ * @return              false if it couldn't be written
+ */
+bool checkpoint_write(Checkpoint* checkpoint) {
+    CheckpointHeader* header = &checkpoint->header;
+
+    while (header->watermark < header->games &&
+            checkpoint->done[header->watermark]) {
+        header->watermark++;
+    }
+    header->aboveCount = 0;
+    for (int64_t i = header->watermark; i < checkpoint->highest; i++) {
+        header->aboveCount += checkpoint->done[i];
+    }
+
+    FILE* file = fopen(checkpoint->tempPath, "w");
+    if (file == NULL) {
+        return false;
+    }
+    fwrite(header, sizeof(CheckpointHeader), 1, file);
+    fwrite(checkpoint->totals, sizeof(int64_t), header->playerCount, file);
+    for (int64_t i = header->watermark; i < checkpoint->highest; i++) {
+        if (checkpoint->done[i]) {
+            fwrite(&i, sizeof(i), 1, file);
+        }
+    }
+    bool written = fflush(file) == 0 && !ferror(file) &&
+            fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !written ||
+            rename(checkpoint->tempPath, checkpoint->path) == -1) {
+        return false;
+    }
+
+    checkpoint->written = now_seconds();
+    return ftruncate(checkpoint->journal, 0) == 0;
+}
+
+/**
+ * writes the final checkpoint of a tournament
+ *
+ * @param checkpoint    checkpoint of the tournament
+ * @return              false if it couldn't be written
+ */
+bool checkpoint_close(Checkpoint* checkpoint) {
+    bool written = checkpoint_write(checkpoint);
+
+    close(checkpoint->journal);
+    free(checkpoint->record);
+
+    return written;
+}
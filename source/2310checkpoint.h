@@ -0,0 +1,76 @@
+//
+// Created by caleb on 2019-10-17.
+//
+
+#ifndef ASS3_CHECKPOINT_H
+#define ASS3_CHECKPOINT_H
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+#include "2310shared.h"
+
+#define CHECKPOINT_MAGIC 0x32333143
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_SECONDS 30
+#define CHECKPOINT_PATH_SIZE 4096
+
+/*
+ * a checkpoint file is a CheckpointHeader, then an int64_t total score per
+ * seat, then aboveCount int64_t ids of finished games at or above watermark.
+ * every game below watermark has finished. playerCount through deckHash are
+ * the settings of the tournament, which must match for a run to resume it
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t playerCount;
+    int32_t threshold;
+    int64_t games;
+    uint64_t seed;
+    uint64_t deckHash;
+    int64_t finished;
+    int64_t watermark;
+    int64_t aboveCount;
+} CheckpointHeader;
+
+/*
+ * the journal (the checkpoint's path with .journal added) has a record per
+ * game finished since the checkpoint was written, each followed by an
+ * int32_t score per seat. check is a hash of the id and scores, so a torn
+ * or zero filled tail left by a crash is not taken for a game
+ */
+typedef struct {
+    int64_t id;
+    uint64_t check;
+} JournalRecord;
+
+/*
+ * a tournament's checkpoint. done and totals belong to the tournament, and
+ * highest is one past the highest finished id, so writing only has to look
+ * at done between watermark and highest
+ */
+typedef struct {
+    CheckpointHeader header;
+    char path[CHECKPOINT_PATH_SIZE];
+    char tempPath[CHECKPOINT_PATH_SIZE];
+    char journalPath[CHECKPOINT_PATH_SIZE];
+    int journal;
+    size_t recordSize;
+    char* record;
+    int64_t highest;
+    double written;
+    bool* done;
+    int64_t* totals;
+} Checkpoint;
+
+bool checkpoint_open(Checkpoint* checkpoint, const char* path,
+        const CheckpointHeader* settings, bool* done, int64_t* totals,
+        bool resume);
+bool checkpoint_game(Checkpoint* checkpoint, long id, const int32_t* scores);
+bool checkpoint_write(Checkpoint* checkpoint);
+bool checkpoint_close(Checkpoint* checkpoint);
+
+#endif //ASS3_CHECKPOINT_H
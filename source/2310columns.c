@@ -0,0 +1,369 @@
+//
+// Created by caleb on 2019-10-06.
+//
+/*
+ * Columnar store of game results.
+ *
+ * The hub appends a row per trick and a row per game, buffering each column
+ * and keeping the min and max of the block being filled. Rows are only ever
+ * appended, so a store can collect any number of games, but every game in
+ * it must have the same number of players (kept in the meta file) so that
+ * per seat columns have a fixed stride.
+ */
+
+#include "2310columns.h"
+
+const ColumnInfo columnInfo[NUM_COLUMNS] = {
+        {"trick.game", 4, false},
+        {"trick.round", 1, false},
+        {"trick.lead", 1, false},
+        {"trick.winner", 1, false},
+        {"trick.dcards", 1, false},
+        {"trick.cards", 1, true},
+        {"game.threshold", 4, false},
+        {"game.tricks", 1, true},
+        {"game.dcards", 1, true},
+        {"game.scores", 4, true}};
+
+/**
+ * finds a column from its name
+ *
+ * @param name  name of the column, eg. trick.lead
+ * @return      ColumnId of the column, -1 if there isn't one
+ */
+int column_by_name(const char* name) {
+    for (int i = 0; i < NUM_COLUMNS; i++) {
+        if (strcmp(columnInfo[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * makes the path of a file in a store
+ *
+ * @param path          buffer of COLUMN_PATH_SIZE to put path into
+ * @param directory     directory of the store
+ * @param name          name of the file
+ * @param extension     extension of the file
+ */
+static void store_path(char* path, const char* directory, const char* name,
+        const char* extension) {
+    snprintf(path, COLUMN_PATH_SIZE, "%s/%s%s", directory, name, extension);
+}
+
+/**
+ * reads the number of players in the games of a store
+ *
+ * @param directory     directory of the store
+ * @param playerCount   int to put value into
+ * @return              true if the store exists, false otherwise
+ */
+bool read_store_players(const char* directory, int* playerCount) {
+    char path[COLUMN_PATH_SIZE];
+    store_path(path, directory, "meta", "");
+
+    FILE* meta = fopen(path, "r");
+    if (meta == NULL) {
+        return false;
+    }
+
+    bool read = fscanf(meta, "players=%d", playerCount) == 1;
+    fclose(meta);
+
+    return read;
+}
+
+/**
+ * opens a column for appending, picking up the stats of a partly filled
+ * last block
+ *
+ * @param column        column to init
+ * @param directory     directory of the store
+ * @param id            which column
+ * @param playerCount   number of players in the games of the store
+ * @return              true if opened, false otherwise
+ */
+static bool open_column(Column* column, const char* directory, int id,
+        int playerCount) {
+    char path[COLUMN_PATH_SIZE];
+
+    column->width = columnInfo[id].width;
+    column->stride = columnInfo[id].perSeat ? playerCount : 1;
+
+    store_path(path, directory, columnInfo[id].name, ".col");
+    column->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    store_path(path, directory, columnInfo[id].name, ".stats");
+    column->statsFd = open(path, O_RDWR | O_CREAT, 0644);
+    if (column->fd == -1 || column->statsFd == -1) {
+        return false;
+    }
+
+    struct stat info;
+    fstat(column->fd, &info);
+    column->rows = info.st_size / (column->width * column->stride);
+
+    column->block.min = INT32_MAX;
+    column->block.max = INT32_MIN;
+    if (column->rows % COLUMN_BLOCK_ROWS != 0) {
+        pread(column->statsFd, &column->block, sizeof(BlockStats),
+                (column->rows / COLUMN_BLOCK_ROWS) * sizeof(BlockStats));
+    }
+
+    column->bufferLength = 0;
+    column->buffer = malloc(COLUMN_BUFFER_SIZE);
+
+    return true;
+}
+
+/**
+ * writes out the buffered values of a column
+ *
+ * @param column    column to flush
+ */
+static void flush_column(Column* column) {
+    write(column->fd, column->buffer, column->bufferLength);
+    column->bufferLength = 0;
+}
+
+/**
+ * appends a row to a column
+ *
+ * @param column    column to append to
+ * @param values    stride values making up the row
+ */
+static void append_row(Column* column, const int32_t* values) {
+    if (column->bufferLength + column->width * column->stride >
+            COLUMN_BUFFER_SIZE) {
+        flush_column(column);
+    }
+
+    for (int i = 0; i < column->stride; i++) {
+        if (column->width == 1) {
+            column->buffer[column->bufferLength] = (uint8_t)values[i];
+        } else {
+            memcpy(column->buffer + column->bufferLength, &values[i],
+                    sizeof(int32_t));
+        }
+        column->bufferLength += column->width;
+
+        if (values[i] < column->block.min) {
+            column->block.min = values[i];
+        }
+        if (values[i] > column->block.max) {
+            column->block.max = values[i];
+        }
+    }
+
+    column->rows++;
+    if (column->rows % COLUMN_BLOCK_ROWS == 0) {
+        pwrite(column->statsFd, &column->block, sizeof(BlockStats),
+                (column->rows / COLUMN_BLOCK_ROWS - 1) * sizeof(BlockStats));
+        column->block.min = INT32_MAX;
+        column->block.max = INT32_MIN;
+    }
+}
+
+/**
+ * opens a store for appending, creating it if need be
+ *
+ * @param directory     directory of the store
+ * @param playerCount   number of players in the game being added
+ * @return              the store, NULL if it can't be opened or holds games
+ *                      with a different number of players
+ */
+ColumnStore* columns_open(const char* directory, int playerCount) {
+    int storePlayers;
+    if (read_store_players(directory, &storePlayers)) {
+        if (storePlayers != playerCount) {
+            return NULL;
+        }
+    } else {
+        char path[COLUMN_PATH_SIZE];
+        mkdir(directory, 0755);
+        store_path(path, directory, "meta", "");
+        FILE* meta = fopen(path, "w");
+        if (meta == NULL) {
+            return NULL;
+        }
+        fprintf(meta, "players=%d\n", playerCount);
+        fclose(meta);
+    }
+
+    ColumnStore* store = calloc(1, sizeof(ColumnStore));
+    store->playerCount = playerCount;
+    for (int i = 0; i < NUM_COLUMNS; i++) {
+        if (!open_column(&store->columns[i], directory, i, playerCount)) {
+            return NULL;
+        }
+    }
+    store->game = store->columns[GAME_THRESHOLD].rows;
+
+    return store;
+}
+
+/**
+ * appends a finished trick of the current game
+ *
+ * @param store         store to append to
+ * @param round         number of the round, from 0
+ * @param leadPlayer    player that led the trick
+ * @param winner        player that won the trick
+ * @param dCount        number of d cards in the trick
+ * @param cardsPlayed   cards played in the trick, starting with the lead
+ */
+void columns_add_trick(ColumnStore* store, int round, int leadPlayer,
+        int winner, int dCount, Card* cardsPlayed) {
+    int32_t values[MAX_PLAYERS];
+
+    values[0] = store->game;
+    append_row(&store->columns[TRICK_GAME], values);
+    values[0] = round;
+    append_row(&store->columns[TRICK_ROUND], values);
+    values[0] = leadPlayer;
+    append_row(&store->columns[TRICK_LEAD], values);
+    values[0] = winner;
+    append_row(&store->columns[TRICK_WINNER], values);
+    values[0] = dCount;
+    append_row(&store->columns[TRICK_DCARDS], values);
+
+    // cards are kept in seat order
+    for (int i = 0; i < store->playerCount; i++) {
+        values[(leadPlayer + i) % store->playerCount] =
+                card_index(cardsPlayed[i]);
+    }
+    append_row(&store->columns[TRICK_CARDS], values);
+}
+
+/**
+ * appends the results of the current game and moves on to the next game
+ *
+ * @param store         store to append to
+ * @param threshold     d card threshold of the game
+ * @param scores        list of how many rounds each player has won
+ * @param dCards        list of how many dcards each player has won
+ * @param finalScores   final score of each player
+ */
+void columns_add_game(ColumnStore* store, int threshold, int* scores,
+        int* dCards, int* finalScores) {
+    int32_t values[MAX_PLAYERS];
+
+    values[0] = threshold;
+    append_row(&store->columns[GAME_THRESHOLD], values);
+    for (int i = 0; i < store->playerCount; i++) {
+        values[i] = scores[i];
+    }
+    append_row(&store->columns[GAME_TRICKS], values);
+    for (int i = 0; i < store->playerCount; i++) {
+        values[i] = dCards[i];
+    }
+    append_row(&store->columns[GAME_DCARDS], values);
+    for (int i = 0; i < store->playerCount; i++) {
+        values[i] = finalScores[i];
+    }
+    append_row(&store->columns[GAME_SCORES], values);
+
+    store->game++;
+}
+
+/**
+ * writes out everything buffered and closes the store
+ *
+ * @param store     store to close
+ */
+void columns_close(ColumnStore* store) {
+    for (int i = 0; i < NUM_COLUMNS; i++) {
+        Column* column = &store->columns[i];
+        flush_column(column);
+        if (column->rows % COLUMN_BLOCK_ROWS != 0) {
+            pwrite(column->statsFd, &column->block, sizeof(BlockStats),
+                    (column->rows / COLUMN_BLOCK_ROWS) * sizeof(BlockStats));
+        }
+        close(column->fd);
+        close(column->statsFd);
+        free(column->buffer);
+    }
+    free(store);
+}
+
+/**
+ * maps a column and its stats read only
+ *
+ * @param directory     directory of the store
+ * @param id            which column
+ * @param playerCount   number of players in the games of the store
+ * @param column        column to init
+ * @return              true if mapped, false otherwise
+ */
+bool column_map(const char* directory, int id, int playerCount,
+        MappedColumn* column) {
+    char path[COLUMN_PATH_SIZE];
+    struct stat info;
+
+    memset(column, 0, sizeof(MappedColumn));
+    column->width = columnInfo[id].width;
+    column->stride = columnInfo[id].perSeat ? playerCount : 1;
+
+    const char* extensions[] = {".col", ".stats"};
+    const void* maps[2] = {NULL, NULL};
+    size_t sizes[2] = {0, 0};
+    for (int i = 0; i < 2; i++) {
+        store_path(path, directory, columnInfo[id].name, extensions[i]);
+        int fd = open(path, O_RDONLY);
+        if (fd == -1) {
+            return false;
+        }
+        fstat(fd, &info);
+        sizes[i] = info.st_size;
+        if (sizes[i] > 0) {
+            maps[i] = mmap(NULL, sizes[i], PROT_READ, MAP_SHARED, fd, 0);
+            if (maps[i] == MAP_FAILED) {
+                close(fd);
+                return false;
+            }
+        }
+        close(fd);
+    }
+
+    column->data = maps[0];
+    column->dataSize = sizes[0];
+    column->stats = maps[1];
+    column->statsSize = sizes[1];
+    column->rows = sizes[0] / (column->width * column->stride);
+    column->blocks = sizes[1] / sizeof(BlockStats);
+
+    return true;
+}
+
+/**
+ * gets a single value of a mapped column
+ *
+ * @param column    column to read
+ * @param index     index of the value, row * stride + seat
+ * @return          the value
+ */
+int32_t column_value(const MappedColumn* column, uint64_t index) {
+    if (column->width == 1) {
+        return column->data[index];
+    }
+
+    int32_t value;
+    memcpy(&value, column->data + index * sizeof(int32_t), sizeof(value));
+    return value;
+}
+
+/**
+ * unmaps a column
+ *
+ * @param column    column to unmap
+ */
+void column_unmap(MappedColumn* column) {
+    if (column->data != NULL) {
+        munmap((void*)column->data, column->dataSize);
+    }
+    if (column->stats != NULL) {
+        munmap((void*)column->stats, column->statsSize);
+    }
+}
@@ -0,0 +1,96 @@
+//
+// Created by caleb on 2019-10-06.
+//
+
+#ifndef ASS3_COLUMNS_H
+#define ASS3_COLUMNS_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "2310shared.h"
+
+#define COLUMN_BLOCK_ROWS 4096
+#define COLUMN_BUFFER_SIZE 65536
+#define COLUMN_PATH_SIZE 4096
+
+/*
+ * a results store is a directory of column files, each a flat array of
+ * fixed width values with stride values per row. trick columns have a row
+ * per trick and game columns a row per game. every column has a .stats file
+ * of BlockStats, one per COLUMN_BLOCK_ROWS rows, so scans can skip blocks
+ */
+typedef enum {
+    TRICK_GAME = 0,
+    TRICK_ROUND = 1,
+    TRICK_LEAD = 2,
+    TRICK_WINNER = 3,
+    TRICK_DCARDS = 4,
+    TRICK_CARDS = 5,
+    GAME_THRESHOLD = 6,
+    GAME_TRICKS = 7,
+    GAME_DCARDS = 8,
+    GAME_SCORES = 9,
+    NUM_COLUMNS = 10
+} ColumnId;
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+} BlockStats;
+
+typedef struct {
+    const char* name;
+    int width;
+    bool perSeat;
+} ColumnInfo;
+
+typedef struct {
+    int fd;
+    int statsFd;
+    int width;
+    int stride;
+    uint64_t rows;
+    BlockStats block;
+    int bufferLength;
+    char* buffer;
+} Column;
+
+typedef struct {
+    int playerCount;
+    uint32_t game;
+    Column columns[NUM_COLUMNS];
+} ColumnStore;
+
+typedef struct {
+    int width;
+    int stride;
+    uint64_t rows;
+    uint64_t blocks;
+    const uint8_t* data;
+    const BlockStats* stats;
+    size_t dataSize;
+    size_t statsSize;
+} MappedColumn;
+
+extern const ColumnInfo columnInfo[NUM_COLUMNS];
+
+int column_by_name(const char* name);
+bool read_store_players(const char* directory, int* playerCount);
+
+ColumnStore* columns_open(const char* directory, int playerCount);
+void columns_add_trick(ColumnStore* store, int round, int leadPlayer,
+        int winner, int dCount, Card* cardsPlayed);
+void columns_add_game(ColumnStore* store, int threshold, int* scores,
+        int* dCards, int* finalScores);
+void columns_close(ColumnStore* store);
+
+bool column_map(const char* directory, int id, int playerCount,
+        MappedColumn* column);
+int32_t column_value(const MappedColumn* column, uint64_t index);
+void column_unmap(MappedColumn* column);
+
+#endif //ASS3_COLUMNS_H
@@ -0,0 +1,350 @@
+//
+// Created by caleb on 2019-10-18.
+//
+/*
+ * Tournaments shared out between worker hubs, for --workers.
+ *
+ * The games still to be played are cut into batches of WORKER_BATCH_GAMES
+ * and each worker is given an even run of them. A worker is the hub run
+ * again with --worker=<fd>, talking to the coordinator over a UNIX socket:
+ *
+ *   B<batch>,<first>,<count>   coordinator: play these games
+ *   E                          coordinator: there are no more batches
+ *   R<id>:<score>,<score>...   worker: a game's score for each seat
+ *   D<batch>                   worker: every game of the batch is done
+ *
+ * Each worker is kept prefetch batches ahead so it never waits for the
+ * next. One that runs out of its own steals the back half of whichever
+ * worker has the most left. A worker that dies is started again, and the
+ * batches it hadn't finished are handed out first; games of them it had
+ * already sent are ignored when they come back. Results are recorded as
+ * they arrive, so --checkpoint and --cache work as for one hub. Workers
+ * add to the coordinator's --telemetry counters themselves.
+ */
+
+#include "2310coordinator.h"
+
+/**
+ * cuts the games not yet finished into batches
+ *
+ * @param coordinator   coordinator of the tournament
+ */
+static void make_batches(Coordinator* coordinator) {
+    Tournament* tournament = coordinator->tournament;
+    long size = 0;
+
+    for (long id = 0; id < tournament->game->options.tournament; id++) {
+        Batch* last = coordinator->batchCount == 0 ? NULL
+                : &coordinator->batches[coordinator->batchCount - 1];
+        if (tournament->done[id]) {
+            continue;
+        }
+        if (last != NULL && last->first + last->count == id &&
+                last->count < WORKER_BATCH_GAMES) {
+            last->count++;
+            continue;
+        }
+        if (coordinator->batchCount == size) {
+            size = 2 * size + WORKER_BATCHES;
+            coordinator->batches = realloc(coordinator->batches,
+                    size * sizeof(Batch));
+        }
+        coordinator->batches[coordinator->batchCount].first = id;
+        coordinator->batches[coordinator->batchCount].count = 1;
+        coordinator->batchCount++;
+    }
+}
+
+/**
+ * starts a worker hub with a socket to it
+ *
+ * @param coordinator   coordinator of the tournament
+ * @param index         number of the worker
+ */
+static void start_worker(Coordinator* coordinator, int index) {
+    Game* game = coordinator->tournament->game;
+    Worker* worker = &coordinator->workers[index];
+    char** argv = coordinator->argv;
+    char options[WORKER_OPTIONS][WORKER_OPTION_SIZE];
+    char* args[MAX_PLAYERS + WORKER_OPTIONS + 4];
+    const char* policies[] = {"block", "drop", "spill:"};
+    int link[2];
+    int count = 0;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, link) == -1) {
+        quit_on_error(PLAYERERROR);
+    }
+    args[0] = "2310hub";
+    snprintf(options[count++], WORKER_OPTION_SIZE, "--worker=%d", link[1]);
+    snprintf(options[count++], WORKER_OPTION_SIZE, "--tournament=%ld",
+            game->options.tournament);
+    snprintf(options[count++], WORKER_OPTION_SIZE, "--seed=%llu",
+            (unsigned long long)game->options.seed);
+    snprintf(options[count++], WORKER_OPTION_SIZE, "--window=%d",
+            game->options.window);
+    snprintf(options[count++], WORKER_OPTION_SIZE, "--log=%s%s",
+            policies[game->options.logPolicy],
+            game->options.logSpill == NULL ? "" : game->options.logSpill);
+    if (game->options.telemetryName != NULL) {
+        snprintf(options[count++], WORKER_OPTION_SIZE, "--telemetry=%s",
+                game->options.telemetryName);
+    }
+    if (game->options.rusage) {
+        snprintf(options[count++], WORKER_OPTION_SIZE, "--rusage");
+    }
+    for (int i = 0; i < count; i++) {
+        args[i + 1] = options[i];
+    }
+    for (int i = 1; i < game->playerCount + 3; i++) {
+        args[count + i] = argv[i];
+    }
+    args[count + game->playerCount + 3] = NULL;
+
+    worker->pid = fork();
+    if (worker->pid == 0) {
+        fcntl(link[1], F_SETFD, 0);
+        execv(WORKER_PROGRAM, args);
+        _exit(PLAYERERROR);
+    } else if (worker->pid == -1) {
+        quit_on_error(PLAYERERROR);
+    }
+    supervise_add(worker->pid, args[0]);
+    close(link[1]);
+    worker->link = link[0];
+    worker->inFlightCount = 0;
+    worker->inLength = 0;
+}
+
+/**
+ * gets the next batch for a worker: a batch left by a worker that died,
+ * or its own next one, or the back half of the worker with the most left
+ *
+ * @param coordinator   coordinator of the tournament
+ * @param worker        the worker
+ * @return              number of the batch, -1 if there are none left
+ */
+static long take_batch(Coordinator* coordinator, Worker* worker) {
+    if (coordinator->retryCount > 0) {
+        return coordinator->retry[--coordinator->retryCount];
+    }
+
+    if (worker->next == worker->last) {
+        Worker* victim = worker;
+        for (int i = 0; i < coordinator->workerCount; i++) {
+            Worker* other = &coordinator->workers[i];
+            if (other->last - other->next > victim->last - victim->next) {
+                victim = other;
+            }
+        }
+        if (victim == worker) {
+            return -1;
+        }
+        worker->last = victim->last;
+        victim->last -= (victim->last - victim->next + 1) / 2;
+        worker->next = victim->last;
+        coordinator->steals++;
+    }
+
+    return worker->next++;
+}
+
+/**
+ * sends a worker batches until it is prefetch ahead
+ *
+ * @param coordinator   coordinator of the tournament
+ * @param worker        the worker
+ */
+static void send_batches(Coordinator* coordinator, Worker* worker) {
+    while (worker->inFlightCount < coordinator->prefetch) {
+        long index = take_batch(coordinator, worker);
+        if (index == -1) {
+            return;
+        }
+        Batch* batch = &coordinator->batches[index];
+        worker->inFlight[worker->inFlightCount++] = index;
+        dprintf(worker->link, "B%ld,%ld,%ld\n", index, batch->first,
+                batch->count);
+    }
+}
+
+/**
+ * starts a worker again after it has died, handing out the batches it
+ * hadn't finished before any others. gives up, exiting as the worker did,
+ * if workers keep dying
+ *
+ * @param coordinator   coordinator of the tournament
+ * @param index         number of the worker
+ */
+static void restart_worker(Coordinator* coordinator, int index) {
+    Worker* worker = &coordinator->workers[index];
+    int status = supervise_wait(worker->pid);
+
+    close(worker->link);
+    if (++coordinator->restarts >
+            coordinator->workerCount * WORKER_RESTARTS) {
+        quit_on_error(WIFEXITED(status) && WEXITSTATUS(status) > OK &&
+                WEXITSTATUS(status) <= CACHEERROR ? WEXITSTATUS(status)
+                : PLAYERERROR);
+    }
+
+    for (int i = 0; i < worker->inFlightCount; i++) {
+        coordinator->retry[coordinator->retryCount++] = worker->inFlight[i];
+    }
+    start_worker(coordinator, index);
+}
+
+/**
+ * handles a result or finished batch from a worker
+ *
+ * @param coordinator   coordinator of the tournament
+ * @param worker        the worker
+ * @param line          the message without its newline
+ */
+static void handle_worker_message(Coordinator* coordinator, Worker* worker,
+        char* line) {
+    Tournament* tournament = coordinator->tournament;
+    int32_t scores[MAX_PLAYERS];
+    char* end;
+
+    if (line[0] == 'D') {
+        long index = strtol(line + 1, NULL, 10);
+        for (int i = 0; i < worker->inFlightCount; i++) {
+            if (worker->inFlight[i] == index) {
+                worker->inFlight[i] =
+                        worker->inFlight[--worker->inFlightCount];
+                coordinator->completed++;
+                return;
+            }
+        }
+        quit_on_error(BADMSG);
+    }
+
+    long id = line[0] == 'R' ? strtol(line + 1, &end, 10) : -1;
+    if (id < 0 || id >= tournament->game->options.tournament) {
+        quit_on_error(BADMSG);
+    }
+    for (int i = 0; i < tournament->game->playerCount; i++) {
+        if (*end != (i == 0 ? ':' : ',')) {
+            quit_on_error(BADMSG);
+        }
+        scores[i] = strtol(end + 1, &end, 10);
+    }
+
+    if (!tournament->done[id]) {
+        record_tournament_game(tournament, id, scores);
+        if (tournament->cache != NULL) {
+            cache_add(tournament->cache, tournament_game_key(tournament, id),
+                    scores);
+        }
+    }
+}
+
+/**
+ * reads what a worker has sent and handles each complete line, starting
+ * it again if it has died
+ *
+ * @param coordinator   coordinator of the tournament
+ * @param index         number of the worker
+ */
+static void read_worker(Coordinator* coordinator, int index) {
+    Worker* worker = &coordinator->workers[index];
+    ssize_t got = read(worker->link, worker->in + worker->inLength,
+            SEAT_BUFFER_SIZE - worker->inLength);
+    if (got <= 0) {
+        restart_worker(coordinator, index);
+        return;
+    }
+    worker->inLength += got;
+
+    char* start = worker->in;
+    char* newline;
+    while ((newline = memchr(start, '\n',
+            worker->in + worker->inLength - start)) != NULL) {
+        *newline = 0;
+        handle_worker_message(coordinator, worker, start);
+        start = newline + 1;
+    }
+    worker->inLength -= start - worker->in;
+    memmove(worker->in, start, worker->inLength);
+}
+
+/**
+ * tells every worker there are no more batches and waits for each to hang
+ * up
+ *
+ * @param coordinator   coordinator of the tournament
+ */
+static void stop_workers(Coordinator* coordinator) {
+    char buffer[BUFFER_SIZE];
+
+    for (int i = 0; i < coordinator->workerCount; i++) {
+        dprintf(coordinator->workers[i].link, "E\n");
+    }
+    for (int i = 0; i < coordinator->workerCount; i++) {
+        while (read(coordinator->workers[i].link, buffer, BUFFER_SIZE) > 0) {
+        }
+        close(coordinator->workers[i].link);
+    }
+}
+
+/**
+ * plays a tournament with --workers worker hubs and prints each seat's
+ * average score
+ *
+ * @param game  game settings, with options.tournament games to play
+ * @param argv  args of ./2310hub after its options: the deck, threshold
+ *              and program of each seat
+ */
+void run_coordinator(Game* game, char** argv) {
+    Tournament tournament;
+    Coordinator coordinator;
+    int workerCount = game->options.workers;
+
+    memset(&coordinator, 0, sizeof(Coordinator));
+    coordinator.tournament = &tournament;
+    coordinator.argv = argv;
+    long resumed = prepare_tournament(&tournament, game, argv + 3);
+    double start = now_seconds();
+
+    make_batches(&coordinator);
+    coordinator.retry = calloc(coordinator.batchCount + 1, sizeof(long));
+    coordinator.workerCount = workerCount;
+    coordinator.workers = calloc(workerCount, sizeof(Worker));
+    coordinator.prefetch = game->options.window / WORKER_BATCH_GAMES + 2;
+    if (coordinator.prefetch > WORKER_BATCHES) {
+        coordinator.prefetch = WORKER_BATCHES;
+    }
+    for (int i = 0; i < workerCount && coordinator.batchCount > 0; i++) {
+        coordinator.workers[i].next = coordinator.batchCount * i /
+                workerCount;
+        coordinator.workers[i].last = coordinator.batchCount * (i + 1) /
+                workerCount;
+        start_worker(&coordinator, i);
+    }
+
+    struct pollfd* polls = calloc(workerCount, sizeof(struct pollfd));
+    while (coordinator.completed < coordinator.batchCount) {
+        check_sighup();
+        for (int i = 0; i < workerCount; i++) {
+            send_batches(&coordinator, &coordinator.workers[i]);
+            polls[i].fd = coordinator.workers[i].link;
+            polls[i].events = POLLIN;
+        }
+        if (poll(polls, workerCount, -1) == -1) {
+            continue;
+        }
+        for (int i = 0; i < workerCount; i++) {
+            if (polls[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read_worker(&coordinator, i);
+            }
+        }
+    }
+    if (coordinator.batchCount > 0) {
+        stop_workers(&coordinator);
+    }
+
+    report_tournament(&tournament, resumed, start);
+    log_printf(STDOUT_FILENO, "Workers=%d batches=%ld steals=%ld "
+            "restarts=%d\n", workerCount, coordinator.batchCount,
+            coordinator.steals, coordinator.restarts);
+}
@@ -0,0 +1,62 @@
+//
+// Created by caleb on 2019-10-18.
+//
+
+#ifndef ASS3_COORDINATOR_H
+#define ASS3_COORDINATOR_H
+
+#include <sys/socket.h>
+
+#include "2310tournament.h"
+
+#define WORKER_BATCH_GAMES 256
+#define WORKER_RESTARTS 3
+#define WORKER_PROGRAM "/proc/self/exe"
+#define WORKER_OPTIONS 7
+#define WORKER_OPTION_SIZE 4096
+
+/*
+ * games first to first + count of a tournament that have still to be played
+ */
+typedef struct {
+    long first;
+    long count;
+} Batch;
+
+/*
+ * a worker hub. next to last are the batches it will play if nobody
+ * steals them, inFlight the ones it has been sent and not finished
+ */
+typedef struct {
+    int pid;
+    int link;
+    long next;
+    long last;
+    long inFlight[WORKER_BATCHES];
+    int inFlightCount;
+    char in[SEAT_BUFFER_SIZE];
+    size_t inLength;
+} Worker;
+
+/*
+ * a tournament shared out between workers. retry holds the batches of
+ * workers that died, which are handed out before any others
+ */
+typedef struct {
+    Tournament* tournament;
+    char** argv;
+    Batch* batches;
+    long batchCount;
+    long completed;
+    long* retry;
+    long retryCount;
+    Worker* workers;
+    int workerCount;
+    int prefetch;
+    long steals;
+    int restarts;
+} Coordinator;
+
+void run_coordinator(Game* game, char** argv);
+
+#endif //ASS3_COORDINATOR_H
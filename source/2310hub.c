@@ -14,9 +14,197 @@
  * 8    Player chooses card they don’t have Invalid card choice
  *       or don’t follow suit
  * 9    Received SIGHUP                     Ended due to signal
+ * 10   Can't open the --columns store      Results store error
+ *       or it has a different player count
+ * 11   Can't read or write the             Checkpoint error
+ *       --checkpoint, or it is of a
+ *       different tournament
+ * 12   Can't read or write the --cache,    Cache error
+ *       or it is for a different number
+ *       of players
+ */
+
+/*
+ * OPTION                                   EFFECT
+ * --batch      Queue PLAYED updates and deliver them to each player as one
+ *              MOVES message just before its turn and at the end of the round
+ * --log=block  What to do when output is produced faster than it can be
+ * --log=drop   written: wait for room, throw lines away, or write them
+ * --log=spill:<file>   straight to file instead. A spill file that
+ *              can't be opened is a usage error
+ * --quiet      Only print the final scores
+ * --jsonl      Print a JSON object per trick and one for the final scores
+ * --binary     Print fixed width records, see RecordHeader
+ * --spectate=<name>    Publish each trick to the shared memory ring name
+ *              for 2310spectator, removing it once the game ends
+ * --columns=<dir>      Append each trick and the final scores to the
+ *              columnar store in dir, for 2310query
+ * --telemetry=<name>   Keep live counters in the shared memory name, for
+ *              2310stats, removing it on exit. A name that can't be
+ *              created, or that another running hub is using, is a
+ *              usage error
+ * --tournament=<games> Play games deals of the deck with one --multi
+ *              process per player, printing each game's scores and each
+ *              player's average. Can't be used with --batch, --jsonl,
+ *              --binary, --spectate, --columns, --io=uring or --iostats
+ * --seed=<n>   First shuffle of a tournament, game g uses seed n + g
+ * --window=<n> Most tournament games in progress at once (default 1024)
+ * --checkpoint=<file>  Save the tournament's finished games to file as it
+ *              goes
+ * --resume     Carry on the tournament saved in the --checkpoint file (if
+ *              there is one yet), only playing the games it hasn't finished
+ * --cache=<file>       Take the result of each tournament game from the
+ *              cache in file if the same programs have played the same deal
+ *              in the same seats before, and add the results of the rest.
+ *              Players must be deterministic given their PLAYER_STRATEGY
+ *              (and the spec file it names) and LOAD_ variables, which
+ *              are part of the key
+ * --workers=<n>        Share the tournament's games out between n worker
+ *              hubs, each with its own players, starting again any that
+ *              die. They are given --telemetry, --log and --rusage, and
+ *              add to the coordinator's counters. Can't be used with --pin
+ * --worker=<fd>        Play the games a coordinator sends on the socket
+ *              fd. Used by --workers
+ * --pin        Pin the hub and each player to its own core, all sharing
+ *              the hub's last level cache. Compare the games/sec of
+ *              tournaments run with and without it
+ * --io=syscall Talk to a game's players with a read() or write() per
+ *              message (the default)
+ * --io=uring   Talk to a game's players through one io_uring, if the
+ *              kernel has it, batching a trick's messages into the system
+ *              call that waits for the next play
+ * --iostats    Print the system calls and time per trick after a game
+ * --rusage     Print how each player exited and the CPU time and memory
+ *              it used, after the game or tournament
+ * --trace=<file>       Write a Chrome trace of the hub and its players to
+ *              file when the hub exits: spawning and the handshake of each
+ *              player, dealing, each wait for a play and each PLAYED sent,
+ *              and the players' parsing and choosing of cards. A file
+ *              that can't be created is a usage error
  */
 
 #include "2310hub.h"
+#include "2310tournament.h"
+#include "2310coordinator.h"
+
+// set by handle_sighup
+static volatile sig_atomic_t hungUp = 0;
+
+/**
+ * Reads the leading --options from the command line
+ *
+ * @param argc      number of args
+ * @param argv      values of args
+ * @param options   options to init
+ * @return          number of args consumed as options
+ */
+int init_options(int argc, char** argv, Options* options) {
+    int consumed = 0;
+
+    memset(options, 0, sizeof(Options));
+    options->window = TOURNAMENT_WINDOW;
+
+    for (int i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            options->batchMoves = true;
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            options->resume = true;
+        } else if (strncmp(argv[i], "--checkpoint=",
+                strlen("--checkpoint=")) == 0) {
+            options->checkpointPath = argv[i] + strlen("--checkpoint=");
+        } else if (strncmp(argv[i], "--workers=",
+                strlen("--workers=")) == 0) {
+            options->workers = parse_option_number(argv[i]);
+        } else if (strncmp(argv[i], "--worker=", strlen("--worker=")) == 0) {
+            options->worker = true;
+            options->workerLink = parse_option_number(argv[i]);
+        } else if (strncmp(argv[i], "--cache=", strlen("--cache=")) == 0) {
+            options->cachePath = argv[i] + strlen("--cache=");
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            options->pin = true;
+        } else if (strcmp(argv[i], "--iostats") == 0) {
+            options->ioStats = true;
+        } else if (strcmp(argv[i], "--rusage") == 0) {
+            options->rusage = true;
+        } else if (strncmp(argv[i], "--trace=", strlen("--trace=")) == 0) {
+            options->tracePath = argv[i] + strlen("--trace=");
+        } else if (strncmp(argv[i], "--io=", strlen("--io=")) == 0) {
+            if (!parse_io_backend(argv[i] + strlen("--io="), &options->io)) {
+                quit_on_error(BADARGNUM);
+            }
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            options->output = OUTPUT_QUIET;
+        } else if (strcmp(argv[i], "--jsonl") == 0) {
+            options->output = OUTPUT_JSONL;
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            options->output = OUTPUT_BINARY;
+        } else if (strncmp(argv[i], "--spectate=",
+                strlen("--spectate=")) == 0) {
+            options->spectateName = argv[i] + strlen("--spectate=");
+        } else if (strncmp(argv[i], "--telemetry=",
+                strlen("--telemetry=")) == 0) {
+            options->telemetryName = argv[i] + strlen("--telemetry=");
+        } else if (strncmp(argv[i], "--columns=",
+                strlen("--columns=")) == 0) {
+            options->columnsDir = argv[i] + strlen("--columns=");
+        } else if (strncmp(argv[i], "--tournament=",
+                strlen("--tournament=")) == 0) {
+            options->tournament = parse_option_number(argv[i]);
+        } else if (strncmp(argv[i], "--seed=", strlen("--seed=")) == 0) {
+            options->seed = parse_option_number(argv[i]);
+        } else if (strncmp(argv[i], "--window=", strlen("--window=")) == 0) {
+            options->window = parse_option_number(argv[i]);
+        } else if (strncmp(argv[i], "--log=", strlen("--log=")) == 0) {
+            if (!parse_log_policy(argv[i] + strlen("--log="),
+                    &options->logPolicy, &options->logSpill)) {
+                quit_on_error(BADARGNUM);
+            }
+        } else {
+            quit_on_error(BADARGNUM);
+        }
+        consumed++;
+    }
+
+    if (options->tournament > 0 && (options->batchMoves ||
+            options->output == OUTPUT_JSONL ||
+            options->output == OUTPUT_BINARY ||
+            options->io != IO_SYSCALL || options->ioStats ||
+            options->spectateName != NULL || options->columnsDir != NULL ||
+            options->window < 1)) {
+        quit_on_error(BADARGNUM);
+    }
+    if (((options->checkpointPath != NULL || options->cachePath != NULL) &&
+            options->tournament == 0) ||
+            (options->resume && options->checkpointPath == NULL)) {
+        quit_on_error(BADARGNUM);
+    }
+    if ((options->workers > 0 || options->worker) &&
+            (options->tournament == 0 || options->pin ||
+            options->workers > MAX_PLAYERS)) {
+        quit_on_error(BADARGNUM);
+    }
+
+    return consumed;
+}
+
+/**
+ * Reads the number of a --name=<n> option
+ *
+ * @param arg   the option
+ * @return      the number, at least 0
+ */
+long parse_option_number(const char* arg) {
+    char* end;
+    const char* value = strchr(arg, '=') + 1;
+    long number = strtol(value, &end, 10);
+
+    if (!isdigit((int)*value) || *end != 0 || number < 0 ||
+            number > INT_MAX) {
+        quit_on_error(BADARGNUM);
+    }
+
+    return number;
+}
 
 /**
  * Inits the game and checks all args are ok
@@ -35,6 +223,33 @@ void init_game(int playerCount, char** argv, Game* game) {
 
     game->playerCount = playerCount;
     game->numRounds = (int)(game->deck.count / playerCount);
+
+    game->spectators = NULL;
+    if (game->options.spectateName != NULL) {
+        // spectators are optional, so carry on without them on failure
+        game->spectators = spectate_create(game->options.spectateName);
+    }
+
+    game->placement = NULL;
+    if (game->options.pin) {
+        game->placement = malloc(sizeof(CpuGroup));
+        placement_group(game->placement);
+        placement_pin(placement_cpu(game->placement, 0));
+    }
+
+    if (game->options.telemetryName != NULL && !(game->options.worker
+            ? telemetry_join(game->options.telemetryName)
+            : telemetry_create(game->options.telemetryName, playerCount))) {
+        quit_on_error(BADARGNUM);
+    }
+
+    game->columns = NULL;
+    if (game->options.columnsDir != NULL) {
+        game->columns = columns_open(game->options.columnsDir, playerCount);
+        if (game->columns == NULL) {
+            quit_on_error(RESULTERROR);
+        }
+    }
 }
 
 /**
@@ -44,41 +259,10 @@ void init_game(int playerCount, char** argv, Game* game) {
  * @param deck      deck to init
  */
 void init_deck(const char* deckName, Deck* deck) {
-    char buffer[BUFFER_SIZE];
-    FILE* deckFile = fopen(deckName, "r");
-    if (deckFile == NULL) {
-        quit_on_error(DECKERROR);
-    }
-
-    int deckSize;
-    fgets(buffer, BUFFER_SIZE - 1, deckFile);
-    deckSize = strtol(buffer, NULL, 10);
-    Card* cards = calloc(deckSize, sizeof(Card));
-    for (int i = 0; i < deckSize; i++) {
-        strcpy(buffer, "");
-        if (!fgets(buffer, BUFFER_SIZE - 1, deckFile)) {
-            free(cards);
-            quit_on_error(DECKERROR);
-        }
-
-        if (!valid_card(buffer[0], buffer[1])) {
-            free(cards);
-            quit_on_error(DECKERROR);
-        }
-
-        cards[i].suit = buffer[0];
-        cards[i].rank = buffer[1];
-    }
-
-    if(!valid_deck(cards, deckSize)) {
-        free(deck);
+    if (!read_deck(deckName, &deck->cards, &deck->count)) {
         quit_on_error(DECKERROR);
     }
-
-    deck->cards = cards;
-    deck->count = deckSize;
     deck->used = 0;
-    fclose(deckFile);
 }
 
 /**
@@ -126,7 +310,14 @@ int* init_players(Game game, char** argv, int*** playerPipes) {
         pipe(playerPipes[i][1]);
 
         playerPIDs[i] = create_player_process(args,
-                playerPipes[i][1], playerPipes[i][0]);
+                playerPipes[i][1], playerPipes[i][0],
+                game.placement == NULL ? -1
+                : placement_cpu(game.placement, i + 1));
+        close(playerPipes[i][1][0]);
+        close(playerPipes[i][0][1]);
+        // so later players don't hold this player's pipes open
+        fcntl(playerPipes[i][1][1], F_SETFD, FD_CLOEXEC);
+        fcntl(playerPipes[i][0][0], F_SETFD, FD_CLOEXEC);
     }
 
     if (!verify_players(game.playerCount, playerPipes)) {
@@ -143,10 +334,19 @@ int* init_players(Game game, char** argv, int*** playerPipes) {
  * @param handSize      size of players' hands
  * @param playerCount   number of players in the game
  * @param playerPipes   communication pipes for players
+ * @param hands         hand of each player to fill in, so plays can be
+ *                      checked
  */
 void assign_hands(Deck deck, int handSize,
-        int playerCount, int*** playerPipes) {
+        int playerCount, int*** playerPipes, Hand* hands) {
+    int64_t traced = trace_begin();
+
     for (int i = 0; i < playerCount; i++) {
+        hands[i].cards = 0;
+        for (int j = i * handSize; j < handSize * (i + 1); j++) {
+            hands[i].cards |= card_bit(deck.cards[j]);
+        }
+
         char handBuffer[BUFFER_SIZE];
         char buffer[BUFFER_SIZE];
         memset(&handBuffer, 0, sizeof(handBuffer));
@@ -159,8 +359,27 @@ void assign_hands(Deck deck, int handSize,
             handBuffer[strlen(handBuffer)] = deck.cards[j].rank;
         }
         strcat(handBuffer, "\n");
-        write(playerPipes[i][1][1], handBuffer, strlen(handBuffer));
+        hubio_write(playerPipes, i, handBuffer, strlen(handBuffer));
     }
+    trace_end("assign_hands", traced, NULL, 0);
+}
+
+/**
+ * Checks that a player holds a card and that it follows the lead suit if it
+ * can, then takes it out of their hand
+ *
+ * @param hand      hand of the player
+ * @param card      card the player chose
+ * @param leadSuit  suit_index of the lead card, -1 if the player is leading
+ * @return          true if the play is legal, false otherwise
+ */
+bool take_card(Hand* hand, Card card, int leadSuit) {
+    if (!rules_legal(hand->cards, card_index(card), leadSuit)) {
+        return false;
+    }
+
+    hand->cards &= ~card_bit(card);
+    return true;
 }
 
 /**
@@ -182,11 +401,8 @@ void start_round(int leadPlayer, int playerCount, int*** playerPipes) {
     strcat(buffer, cleadPlayer);
     strcat(buffer, "\n");
 
-    fprintf(stdout, "Lead player=%d\n", leadPlayer);
-    fflush(stdout);
-
     for (int i = 0; i < playerCount; i++) {
-        write(playerPipes[i][1][1], buffer, strlen(buffer));
+        hubio_write(playerPipes, i, buffer, strlen(buffer));
     }
 }
 
@@ -199,29 +415,24 @@ void start_round(int leadPlayer, int playerCount, int*** playerPipes) {
  */
 Card get_play(int currentPlayer, int*** playerPipes) {
     char message[BUFFER_SIZE];
-    size_t bytesRead = 0;
-
-    memset(&message, 0, sizeof(message));
-
-    // get message from player
-    bytesRead = read(playerPipes[currentPlayer][0][0],
-            message, sizeof(message));
-    if (bytesRead == 0) {
-        quit_on_error(PLAYEREOF);
+    int64_t traced = trace_begin();
+
+    // get message from player, which may arrive in more than one piece
+    check_sighup();
+    if (hubio_read(playerPipes, currentPlayer, message,
+            sizeof(message)) == 0) {
+        check_sighup();
+        quit_on_player_error(currentPlayer, PLAYEREOF);
     }
 
     // verify length
     if (strlen(message) != 7) {
-        quit_on_error(BADMSG);
+        quit_on_player_error(currentPlayer, BADMSG);
     }
 
     // verify that the message is PLAY
-    char* buffer = calloc(strlen(message), sizeof(char));
-    strcpy(buffer, message);
-    buffer[strlen("PLAY")] = 0;
-    buffer[strlen(message)] = 0;
-    if (strcmp(buffer, "PLAY") != 0) {
-        quit_on_error(BADMSG);
+    if (strncmp(message, "PLAY", strlen("PLAY")) != 0) {
+        quit_on_player_error(currentPlayer, BADMSG);
     }
 
     // get card played
@@ -231,9 +442,10 @@ Card get_play(int currentPlayer, int*** playerPipes) {
 
     // validate card
     if (!valid_card(cardPlayed.suit, cardPlayed.rank)) {
-        quit_on_error(BADMSG);
+        quit_on_player_error(currentPlayer, BADMSG);
     }
 
+    trace_end("get_play", traced, "player", currentPlayer);
     return cardPlayed;
 }
 
@@ -249,6 +461,7 @@ void print_move(int currentPlayer, Card card,
         int playerCount, int*** playerPipes) {
     char message[BUFFER_SIZE];
     char buffer[BUFFER_SIZE];
+    int64_t traced = trace_begin();
 
     memset(&message, 0, sizeof(message));
     memset(&buffer, 0, sizeof(buffer));
@@ -263,49 +476,62 @@ void print_move(int currentPlayer, Card card,
 
     for (int i = 0; i < playerCount; i++) {
         if (i != currentPlayer) {
-            write(playerPipes[i][1][1], message, strlen(message));
+            hubio_write(playerPipes, i, message, strlen(message));
         }
     }
+    trace_end("print_move", traced, "player", currentPlayer);
 }
 
 /**
- * Calculates which player won the round
+ * Queues the move made by a player for every other player, to be sent later
+ * by flush_moves
  *
+ * @param currentPlayer player that played a card
+ * @param card          card that the player played
  * @param playerCount   number of players in the game
- * @param cardsPlayed   list of cards played with round
- * @return              position of player that won
+ * @param queues        pending moves for each player
  */
-int find_winner(int playerCount, Card* cardsPlayed) {
-    int highestPlayer = 0;
-    Card highestCard = cardsPlayed[0];
-
-    for (int i = 1; i < playerCount; i++) {
-        if ((int)cardsPlayed[i].suit == (int)highestCard.suit &&
-                (int)cardsPlayed[i].rank > (int)highestCard.rank) {
-            highestPlayer = i;
-            highestCard = cardsPlayed[i];
+void queue_move(int currentPlayer, Card card,
+        int playerCount, MoveQueue* queues) {
+    for (int i = 0; i < playerCount; i++) {
+        if (i != currentPlayer) {
+            queues[i].players[queues[i].count] = currentPlayer;
+            queues[i].cards[queues[i].count] = card;
+            queues[i].count++;
         }
     }
-
-    return highestPlayer;
 }
 
 /**
- * Counts the number of d cards played this round
+ * Sends a player every move queued for it as MOVES messages of at most
+ * MAX_BATCH_MOVES moves each, then empties its queue
  *
- * @param playerCount   number of players in the game
- * @param cardsPlayed   list of cards played with round
- * @return              number of d cards played
+ * @param player        player to send the moves to
+ * @param queues        pending moves for each player
+ * @param playerPipes   communication pipes for players
  */
-int count_d_cards(int playerCount, Card* cardsPlayed) {
-    int count = 0;
-    for (int i = 0; i < playerCount; i++) {
-        if ((int)cardsPlayed[i].suit == (int)'D') {
-            count++;
+void flush_moves(int player, MoveQueue* queues, int*** playerPipes) {
+    char message[BUFFER_SIZE];
+    MoveQueue* queue = &queues[player];
+
+    for (int i = 0; i < queue->count; i += MAX_BATCH_MOVES) {
+        int batchSize = queue->count - i;
+        if (batchSize > MAX_BATCH_MOVES) {
+            batchSize = MAX_BATCH_MOVES;
+        }
+
+        int length = sprintf(message, "MOVES%d", batchSize);
+        for (int j = i; j < i + batchSize; j++) {
+            length += sprintf(message + length, ",%d:%c%c",
+                    queue->players[j], queue->cards[j].suit,
+                    queue->cards[j].rank);
         }
+        message[length++] = '\n';
+
+        hubio_write(playerPipes, player, message, length);
     }
 
-    return count;
+    queue->count = 0;
 }
 
 /**
@@ -319,29 +545,125 @@ int count_d_cards(int playerCount, Card* cardsPlayed) {
  *                      they've won
  */
 void print_scores(int playerCount, int threshold, int* scores, int* dCards) {
-    char buffer[BUFFER_SIZE];
-    char intBuffer[BUFFER_SIZE];
-
-    memset(&buffer, 0, sizeof(buffer));
-    memset(intBuffer, 0, sizeof(intBuffer));
+    // up to "nn:-nnnnnnnnnn " per player
+    char* buffer = calloc(playerCount, 16);
+    int length = 0;
 
     for (int i = 0; i < playerCount; i++) {
-        int finalScore;
-        if (dCards[i] < threshold) {
-            finalScore = scores[i] - dCards[i];
-        } else {
-            finalScore = scores[i] + dCards[i];
+        length += sprintf(buffer + length, "%d:%d ", i,
+                rules_final_score(threshold, scores[i], dCards[i]));
+    }
+    buffer[length - 1] = '\n';
+    log_write(STDOUT_FILENO, buffer, length);
+    free(buffer);
+}
+
+/**
+ * Reports a finished trick in the game's output mode. text output is the
+ * "Cards=" line, the "Lead player=" line being printed as the trick starts
+ *
+ * @param game          stats of the game
+ * @param round         number of the round, from 0
+ * @param leadPlayer    player that led the trick
+ * @param winner        player that won the trick
+ * @param cardsPlayed   cards played in the trick, starting with the lead
+ * @param dCount        number of d cards in the trick
+ */
+void report_trick(Game game, int round, int leadPlayer, int winner,
+        Card* cardsPlayed, int dCount) {
+    // big enough for the json form, which is the longest
+    char buffer[BUFFER_SIZE + 6 * MAX_PLAYERS];
+    int length = 0;
+
+    switch (game.options.output) {
+        case OUTPUT_TEXT:
+            length = sprintf(buffer, "Cards=");
+            for (int i = 0; i < game.playerCount; i++) {
+                length += sprintf(buffer + length, "%c.%c ",
+                        cardsPlayed[i].suit, cardsPlayed[i].rank);
+            }
+            buffer[length - 1] = '\n';
+            break;
+        case OUTPUT_QUIET:
+            break;
+        case OUTPUT_JSONL:
+            length = sprintf(buffer, "{\"round\":%d,\"lead\":%d,"
+                    "\"cards\":[", round, leadPlayer);
+            for (int i = 0; i < game.playerCount; i++) {
+                length += sprintf(buffer + length, "\"%c%c\",",
+                        cardsPlayed[i].suit, cardsPlayed[i].rank);
+            }
+            length += sprintf(buffer + length - 1, "],\"winner\":%d,"
+                    "\"d\":%d}\n", winner, dCount) - 1;
+            break;
+        case OUTPUT_BINARY: {
+            RecordHeader header = {'T', game.playerCount, round,
+                    leadPlayer, winner, dCount, 0};
+            memcpy(buffer, &header, sizeof(header));
+            length = sizeof(header);
+            for (int i = 0; i < game.playerCount; i++) {
+                buffer[length++] = card_index(cardsPlayed[i]);
+            }
+            break;
+        }
+    }
+
+    if (length > 0) {
+        log_write(STDOUT_FILENO, buffer, length);
+    }
+}
+
+/**
+ * Reports the final scores in the game's output mode
+ *
+ * @param game          stats of the game
+ * @param scores        list of how many rounds each player has won
+ * @param dCards        list of how many dcards each player has won
+ */
+void report_scores(Game game, int* scores, int* dCards) {
+    // "nn," for each of three lists of numbers
+    char buffer[BUFFER_SIZE + 36 * MAX_PLAYERS];
+    int length = 0;
+
+    switch (game.options.output) {
+        case OUTPUT_TEXT:
+        case OUTPUT_QUIET:
+            print_scores(game.playerCount, game.threshold, scores, dCards);
+            break;
+        case OUTPUT_JSONL:
+            length = sprintf(buffer, "{\"tricks\":[");
+            for (int i = 0; i < game.playerCount; i++) {
+                length += sprintf(buffer + length, "%d,", scores[i]);
+            }
+            length += sprintf(buffer + length - 1, "],\"dcards\":[") - 1;
+            for (int i = 0; i < game.playerCount; i++) {
+                length += sprintf(buffer + length, "%d,", dCards[i]);
+            }
+            length += sprintf(buffer + length - 1, "],\"scores\":[") - 1;
+            for (int i = 0; i < game.playerCount; i++) {
+                length += sprintf(buffer + length, "%d,", rules_final_score(
+                        game.threshold, scores[i], dCards[i]));
+            }
+            length += sprintf(buffer + length - 1, "]}\n") - 1;
+            break;
+        case OUTPUT_BINARY: {
+            RecordHeader header = {'G', game.playerCount, game.numRounds,
+                    0, 0, 0, 0};
+            memcpy(buffer, &header, sizeof(header));
+            length = sizeof(header);
+            for (int i = 0; i < game.playerCount; i++) {
+                int32_t score = rules_final_score(game.threshold, scores[i],
+                        dCards[i]);
+                memcpy(buffer + length, &score, sizeof(score));
+                length += sizeof(score);
+            }
+            break;
         }
-        sprintf(intBuffer, "%d", i);
-        strcat(buffer, intBuffer);
-        strcat(buffer, ":");
-        sprintf(intBuffer, "%d", finalScore);
-        strcat(buffer, intBuffer);
-        strcat(buffer, " ");
-    }
-    buffer[strlen(buffer) - 1] = '\n';
-    fputs(buffer, stdout);
-    fflush(stdout);
+    }
+
+    if (length > 0) {
+        log_write(STDOUT_FILENO, buffer, length);
+    }
 }
 
 /**
@@ -358,7 +680,7 @@ void gameover(int playerCount, int*** playerPipes) {
     strcpy(message, "GAMEOVER\n");
 
     for (int i = 0; i < playerCount; i++) {
-        write(playerPipes[i][1][1], message, strlen(message));
+        hubio_write(playerPipes, i, message, strlen(message));
     }
 }
 
@@ -370,15 +692,45 @@ void gameover(int playerCount, int*** playerPipes) {
  * @return      status. 0 if OK
  */
 int main(int argc, char** argv) {
-    signal(SIGHUP, handle_sighup);
+    supervise_init();
+    // no SA_RESTART, so a hub waiting on a player wakes up to check for it
+    struct sigaction hangup;
+    memset(&hangup, 0, sizeof(hangup));
+    hangup.sa_handler = handle_sighup;
+    sigaction(SIGHUP, &hangup, NULL);
+
+    Game game;
+    int consumed = init_options(argc, argv, &game.options);
+    argc -= consumed;
+    argv += consumed;
+    if (!log_init(game.options.logPolicy, game.options.logSpill)) {
+        quit_on_error(BADARGNUM);
+    }
+    if (game.options.tracePath != NULL &&
+            !trace_start(game.options.tracePath, "2310hub", true)) {
+        quit_on_error(BADARGNUM);
+    }
+
     if (argc < 5) {
         quit_on_error(BADARGNUM);
     }
 
-    Game game;
     game.playerCount = argc - 3;
     init_game(game.playerCount, argv, &game);
 
+    if (game.options.tournament > 0) {
+        if (game.options.worker) {
+            run_worker(&game, argv + 3);
+        } else if (game.options.workers > 0) {
+            run_coordinator(&game, argv);
+        } else {
+            run_tournament(&game, argv + 3);
+        }
+        end_players(&game);
+        telemetry_exit(OK);
+        return OK;
+    }
+
     int*** playerPipes;
     playerPipes = calloc(game.playerCount, sizeof(int**));
     for (int i = 0; i < game.playerCount; i++) {
@@ -389,15 +741,39 @@ int main(int argc, char** argv) {
     }
 
     init_players(game, argv, playerPipes);
+    hubio_init(game.options.io, game.playerCount, playerPipes);
 
-    assign_hands(game.deck, game.numRounds, game.playerCount, playerPipes);
+    game.hands = calloc(game.playerCount, sizeof(Hand));
+    telemetry_game_started();
+    assign_hands(game.deck, game.numRounds, game.playerCount, playerPipes,
+            game.hands);
 
     game_loop(game, playerPipes);
 
     gameover(game.playerCount, playerPipes);
+    hubio_finish();
+    telemetry_game_finished();
+    if (game.options.ioStats) {
+        hubio_stats(game.numRounds);
+    }
+    end_players(&game);
+    telemetry_exit(OK);
     return OK;
 }
 
+/**
+ * waits for the players to exit after the game, killing any that don't,
+ * and reports what they used if asked to
+ *
+ * @param game  game stats
+ */
+void end_players(Game* game) {
+    supervise_reap(REAP_TIMEOUT_MS);
+    if (game->options.rusage) {
+        supervise_report();
+    }
+}
+
 /**
  * main loop for the game logic. prints out scores on finish
  *
@@ -406,37 +782,77 @@ int main(int argc, char** argv) {
  */
 void game_loop(Game game, int*** playerPipes) {
     int leadPlayer = 0;
-    int currentPlayer;
-    int* scores = calloc(game.numRounds, sizeof(int));
-    int* dCards = calloc(game.numRounds, sizeof(int));
+    int* scores = calloc(game.playerCount, sizeof(int));
+    int* dCards = calloc(game.playerCount, sizeof(int));
+    int* finalScores = calloc(game.playerCount, sizeof(int));
+    Card* cardsPlayed = calloc(game.playerCount, sizeof(Card));
+    int* trick = calloc(game.playerCount, sizeof(int));
+    MoveQueue* queues = calloc(game.playerCount, sizeof(MoveQueue));
+    for (int i = 0; i < game.playerCount; i++) {
+        queues[i].players = calloc(game.playerCount, sizeof(int));
+        queues[i].cards = calloc(game.playerCount, sizeof(Card));
+    }
     for (int i = 0; i < game.numRounds; i++) {
+        if (game.options.output == OUTPUT_TEXT) {
+            log_printf(STDOUT_FILENO, "Lead player=%d\n", leadPlayer);
+        }
         start_round(leadPlayer, game.playerCount, playerPipes);
-        currentPlayer = leadPlayer;
-        Card* cardsPlayed = calloc(game.playerCount, sizeof(Card));
-        char cardsBuffer[BUFFER_SIZE];
-        memset(&cardsBuffer, 0, sizeof(cardsBuffer));
-        strcpy(cardsBuffer, "Cards=");
         for (int j = 0; j < game.playerCount; j++) {
-            Card card = get_play(((currentPlayer + j) % game.playerCount),
-                    playerPipes);
-            print_move(((currentPlayer + j) % game.playerCount), card,
-                    game.playerCount, playerPipes);
+            int player = (leadPlayer + j) % game.playerCount;
+            if (game.options.batchMoves) {
+                flush_moves(player, queues, playerPipes);
+            }
+            Card card = get_play(player, playerPipes);
+            if (!take_card(&game.hands[player], card,
+                    j == 0 ? -1 : RULES_SUIT(trick[0]))) {
+                quit_on_player_error(player, BADCARD);
+            }
+            if (game.options.batchMoves) {
+                queue_move(player, card, game.playerCount, queues);
+            } else {
+                print_move(player, card, game.playerCount, playerPipes);
+            }
             cardsPlayed[j] = card;
-            cardsBuffer[strlen(cardsBuffer)] = card.suit;
-            strcat(cardsBuffer, ".");
-            cardsBuffer[strlen(cardsBuffer)] = card.rank;
-            strcat(cardsBuffer, " ");
+            trick[j] = card_index(card);
         }
-        cardsBuffer[strlen(cardsBuffer) - 1] = '\n';
-        fputs(cardsBuffer, stdout);
-        fflush(stdout);
-        leadPlayer = (find_winner(game.playerCount, cardsPlayed) +
-                leadPlayer) % game.playerCount;
-        scores[leadPlayer] += 1;
-        dCards[leadPlayer] += count_d_cards(game.playerCount, cardsPlayed);
+        if (game.options.batchMoves) {
+            for (int j = 0; j < game.playerCount; j++) {
+                flush_moves(j, queues, playerPipes);
+            }
+        }
+        int winner = (rules_winner(game.playerCount, trick) + leadPlayer)
+                % game.playerCount;
+        int dCount = rules_d_count(game.playerCount, trick);
+        telemetry_trick();
+        report_trick(game, i, leadPlayer, winner, cardsPlayed, dCount);
+        scores[winner] += 1;
+        dCards[winner] += dCount;
+        if (game.columns != NULL) {
+            columns_add_trick(game.columns, i, leadPlayer, winner, dCount,
+                    cardsPlayed);
+        }
+        if (game.spectators != NULL) {
+            for (int j = 0; j < game.playerCount; j++) {
+                finalScores[j] = rules_final_score(game.threshold, scores[j],
+                        dCards[j]);
+            }
+            spectate_publish(game.spectators, game.playerCount, i,
+                    leadPlayer, winner, dCount, cardsPlayed, finalScores);
+        }
+        leadPlayer = winner;
     }
 
-    print_scores(game.playerCount, game.threshold, scores, dCards);
+    report_scores(game, scores, dCards);
+    if (game.columns != NULL) {
+        for (int j = 0; j < game.playerCount; j++) {
+            finalScores[j] = rules_final_score(game.threshold, scores[j],
+                    dCards[j]);
+        }
+        columns_add_game(game.columns, game.threshold, scores, dCards,
+                finalScores);
+        columns_close(game.columns);
+    }
+    spectate_finish();
 }
 
 /**
@@ -445,11 +861,18 @@ void game_loop(Game game, int*** playerPipes) {
  * @param args          args to execute player with
  * @param childRead     pipes that player will read from
  * @param childWrite    pipes that palyer will write to
+ * @param cpu           cpu to pin the player to, -1 to leave it unpinned
  * @return              PID of child function
  */
-int create_player_process(char* args[], int childRead[2], int childWrite[2]) {
+int create_player_process(char* args[], int childRead[2], int childWrite[2],
+        int cpu) {
+    int64_t traced = trace_begin();
     int pid = fork();
     if (pid == 0) {
+        // the pin is kept across exec
+        if (cpu != -1) {
+            placement_pin(cpu);
+        }
         // this is the child
         /*
         fputs(args[0], stdout);
@@ -471,11 +894,14 @@ int create_player_process(char* args[], int childRead[2], int childWrite[2]) {
 
         fputs("exec has failed\n", stdout);
         fflush(stdout);
-        quit_on_error(PLAYERERROR);
+        // not quit_on_error, whose atexit handlers are the hub's to run
+        _exit(PLAYERERROR);
     } else if (pid == -1) {
         // fork failed
         quit_on_error(PLAYERERROR);
     }
+    supervise_add(pid, args[0]);
+    trace_end("spawn", traced, "pid", pid);
     return pid;
 }
 
@@ -491,8 +917,10 @@ bool verify_players(int playerCount, int*** playerPipes) {
     for (int i = 0; i < playerCount; i++) {
         strcpy(buffer, "");
         size_t bytesRead = 0;
+        int64_t traced = trace_begin();
 
         bytesRead = read(playerPipes[i][0][0], buffer, 1);
+        check_sighup();
         if (bytesRead == 0) {
             return false;
         }
@@ -500,18 +928,30 @@ bool verify_players(int playerCount, int*** playerPipes) {
         if (strcmp(buffer, "@") != 0) {
             return false;
         }
+        trace_end("handshake", traced, "player", i);
     }
 
     return true;
 }
 
 /**
- * handle SIGHUP signal
+ * handle SIGHUP signal. only notes that it came, so the hub can end through
+ * quit_on_error at check_sighup and still write the queued output
  *
  * @param sig   signal id
  */
 void handle_sighup(int sig) {
-    quit_on_error(SSIGHUP);
+    hungUp = 1;
+}
+
+/**
+ * ends the hub if SIGHUP has been received. called wherever it may have
+ * been waiting, since the signal interrupts the wait
+ */
+void check_sighup(void) {
+    if (hungUp) {
+        quit_on_error(SSIGHUP);
+    }
 }
 
 /**
@@ -531,8 +971,25 @@ void quit_on_error(Status s) {
             "Player EOF\n",
             "Invalid message\n",
             "Invalid card choice\n",
-            "Ended due to signal\n"};
+            "Ended due to signal\n",
+            "Results store error\n",
+            "Checkpoint error\n",
+            "Cache error\n"};
+    spectate_finish();
+    telemetry_exit(s);
+    supervise_kill();
     fputs(statusMessages[s], stderr);
     fflush(stderr);
     exit(s);
+}
+
+/**
+ * end function due to something a player did, counting it against them
+ *
+ * @param player    player at fault
+ * @param s         status of program to exit on
+ */
+void quit_on_player_error(int player, Status s) {
+    telemetry_error(player, s);
+    quit_on_error(s);
 }
\ No newline at end of file
@@ -6,8 +6,18 @@
 #define ASS3_2310HUB_H
 
 #include "2310shared.h"
+#include "2310rules.h"
+#include "2310log.h"
+#include "2310spectate.h"
+#include "2310columns.h"
+#include "2310placement.h"
+#include "2310hubio.h"
+#include "2310telemetry.h"
+#include "2310supervise.h"
+#include "2310trace.h"
 
 #define BUFFER_SIZE 255
+#define MAX_BATCH_MOVES 32
 
 typedef enum {
     OK = 0,
@@ -19,7 +29,10 @@ typedef enum {
     PLAYEREOF = 6,
     BADMSG = 7,
     BADCARD = 8,
-    SSIGHUP = 9
+    SSIGHUP = 9,
+    RESULTERROR = 10,
+    CHECKPOINTERROR = 11,
+    CACHEERROR = 12
 } Status;
 
 typedef struct {
@@ -28,38 +41,112 @@ typedef struct {
     Card* cards;
 } Deck;
 
+typedef enum {
+    OUTPUT_TEXT = 0,
+    OUTPUT_QUIET = 1,
+    OUTPUT_JSONL = 2,
+    OUTPUT_BINARY = 3
+} OutputMode;
+
+/*
+ * --binary output is a series of records, each a RecordHeader followed by
+ * playerCount entries: a card_index byte per card for a trick ('T'), in play
+ * order starting with the lead, or an int32_t final score per player at the
+ * end of the game ('G'). all values are in host byte order
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t playerCount;
+    uint8_t round;
+    uint8_t lead;
+    uint8_t winner;
+    uint8_t dCards;
+    uint16_t reserved;
+} RecordHeader;
+
+typedef struct {
+    bool batchMoves;
+    OutputMode output;
+    LogPolicy logPolicy;
+    const char* logSpill;
+    const char* spectateName;
+    const char* columnsDir;
+    const char* telemetryName;
+    long tournament;
+    uint64_t seed;
+    int window;
+    const char* checkpointPath;
+    bool resume;
+    const char* cachePath;
+    int workers;
+    bool worker;
+    int workerLink;
+    bool pin;
+    IoBackend io;
+    bool ioStats;
+    bool rusage;
+    const char* tracePath;
+} Options;
+
+typedef struct {
+    int count;
+    int* players;
+    Card* cards;
+} MoveQueue;
+
+typedef struct {
+    uint64_t cards;
+} Hand;
+
 typedef struct {
     Deck deck;
     int threshold;
     int playerCount;
     int numRounds;
+    Options options;
+    SpectateRing* spectators;
+    ColumnStore* columns;
+    CpuGroup* placement;
+    Hand* hands;
 } Game;
 
+int init_options(int argc, char** argv, Options* options);
+long parse_option_number(const char* arg);
+
 void init_game(int playerCount, char** argv, Game* game);
 void init_deck(const char* deckName, Deck* deck);
 void init_threshold(const char* thresholdArg, int* threshold);
 int* init_players(Game game, char** argv, int*** playerPipes);
 
 void assign_hands(Deck deck, int handSize,
-        int playerCount, int*** playerPipes);
+        int playerCount, int*** playerPipes, Hand* hands);
+bool take_card(Hand* hand, Card card, int leadSuit);
 
 void start_round(int leadPlayer, int playerCount, int*** playerPipes);
 Card get_play(int currentPlayer, int*** playerPipes);
 void print_move(int currentPlayer, Card card,
         int playerCount, int*** playerPipes);
-int find_winner(int playerCount, Card* cardsPlayed);
-int count_d_cards(int playerCount, Card* cardsPlayed);
+void queue_move(int currentPlayer, Card card,
+        int playerCount, MoveQueue* queues);
+void flush_moves(int player, MoveQueue* queues, int*** playerPipes);
 void print_scores(int playerCount, int threshold, int* scores, int* dCards);
+void report_trick(Game game, int round, int leadPlayer, int winner,
+        Card* cardsPlayed, int dCount);
+void report_scores(Game game, int* scores, int* dCards);
 void gameover(int playerCount, int*** playerPipes);
 
 int main(int argc, char** argv);
 void game_loop(Game game, int*** playerPipes);
 
-int create_player_process(char** args, int childRead[2], int childWrite[2]);
+void end_players(Game* game);
+int create_player_process(char** args, int childRead[2], int childWrite[2],
+        int cpu);
 
 bool verify_players(int playerCount, int*** playerPipes);
 
 void handle_sighup(int sig);
+void check_sighup(void);
 void quit_on_error(Status s);
+void quit_on_player_error(int player, Status s);
 
 #endif //ASS3_2310HUB_H
@@ -0,0 +1,446 @@
+//
+// Created by caleb on 2019-10-15.
+//
+/*
+ * Reading and writing the players' pipes for a single game.
+ *
+ * By default each message is a plain write() and each play is read with
+ * read().
+ *
+ * With --io=uring an io_uring is used instead. A multishot read is kept
+ * armed on every player, filling buffers from a provided buffer ring, and
+ * writes are only queued. Everything queued goes to the kernel in the one
+ * io_uring_enter that also waits for the next play, so a trick's
+ * broadcasts cost no system calls of their own. The writes queued between
+ * two waits are linked so they happen in order. It makes far fewer system
+ * calls, but on one CPU a trick took longer than with read() and write()
+ * at every player count measured, so it is not the default.
+ *
+ * Linked writes keep their order, but writes queued before and after a
+ * wait could pass each other if a player's pipe were full. A game sends a
+ * player far less than a pipe holds, so this never happens.
+ *
+ * If the kernel can't do any of that (no io_uring, or no multishot reads)
+ * the plain system calls are used.
+ */
+
+#include "2310hub.h"
+
+static IoBackend backend = IO_SYSCALL;
+static Uring ring;
+static long syscalls;
+static double started;
+
+/**
+ * parses an io backend of the form uring or syscall
+ *
+ * @param spec      backend to parse
+ * @param backend   backend to put value into
+ * @return          true if legal, false otherwise
+ */
+bool parse_io_backend(const char* spec, IoBackend* backend) {
+    if (strcmp(spec, "uring") == 0) {
+        *backend = IO_URING;
+    } else if (strcmp(spec, "syscall") == 0) {
+        *backend = IO_SYSCALL;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * checks the kernel supports an io_uring operation
+ *
+ * @param fd    the io_uring
+ * @param op    the operation
+ * @return      true if supported
+ */
+static bool uring_supports(int fd, int op) {
+    size_t size = sizeof(struct io_uring_probe) +
+            256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    bool supported = false;
+
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+            256) == 0 && op <= probe->last_op) {
+        supported = (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+    free(probe);
+
+    return supported;
+}
+
+/**
+ * hands a buffer (back) to the kernel for reads to fill
+ *
+ * @param bid   id of the buffer
+ */
+static void provide_buffer(int bid) {
+    unsigned short tail = ring.buffers->tail;
+    struct io_uring_buf* buffer =
+            &ring.buffers->bufs[tail & (URING_BUFFERS - 1)];
+
+    buffer->addr = (uintptr_t)(ring.bufferData + bid * URING_BUFFER_SIZE);
+    buffer->len = URING_BUFFER_SIZE;
+    buffer->bid = bid;
+    __atomic_store_n(&ring.buffers->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * sends everything queued to the kernel and waits for completions
+ *
+ * @param waitFor   number of completions to wait for, 0 to not wait
+ * @return          false if a signal (SIGHUP, which ends the hub)
+ *                  interrupted the wait
+ */
+static bool uring_enter(unsigned waitFor) {
+    long submitted = syscall(__NR_io_uring_enter, ring.fd, ring.queued,
+            waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    syscalls++;
+    if (submitted == -1 && errno == EINTR) {
+        return false;
+    }
+
+    if (submitted > 0) {
+        ring.queued -= submitted;
+    }
+    ring.lastWrite = NULL;
+    return true;
+}
+
+/**
+ * gets the next free submission, making room if the queue is full
+ *
+ * @return  the submission, zeroed
+ */
+static struct io_uring_sqe* next_sqe(void) {
+    unsigned tail = *ring.sqTail;
+
+    if (tail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE) >
+            ring.sqMask) {
+        uring_enter(0);
+    }
+
+    struct io_uring_sqe* sqe = &ring.sqes[tail & ring.sqMask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring.sqArray[tail & ring.sqMask] = tail & ring.sqMask;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring.queued++;
+
+    return sqe;
+}
+
+/**
+ * arms a multishot read of a player's pipe
+ *
+ * @param player    the player
+ */
+static void arm_read(int player) {
+    struct io_uring_sqe* sqe = next_sqe();
+
+    sqe->opcode = URING_OP_READ_MULTISHOT;
+    sqe->fd = ring.readFds[player];
+    sqe->off = -1;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = player;
+    // nothing is linked to a read
+    ring.lastWrite = NULL;
+}
+
+/**
+ * handles a finished read of a player's pipe
+ *
+ * @param cqe   the completion
+ */
+static void read_done(struct io_uring_cqe* cqe) {
+    PlayerInput* input = &ring.inputs[cqe->user_data];
+
+    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+        int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        int length = cqe->res;
+        // a line too long for the buffer is invalid whatever the rest is
+        if (length > URING_LINE_SIZE - 1 - input->length) {
+            length = URING_LINE_SIZE - 1 - input->length;
+        }
+        memcpy(input->data + input->length,
+                ring.bufferData + bid * URING_BUFFER_SIZE, length);
+        input->length += length;
+        provide_buffer(bid);
+    }
+
+    if (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS)) {
+        input->eof = true;
+    } else if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        arm_read(cqe->user_data);
+    }
+}
+
+/**
+ * handles every completion the kernel has posted
+ */
+static void reap(void) {
+    unsigned head = *ring.cqHead;
+
+    while (head != __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe* cqe = &ring.cqes[head & ring.cqMask];
+        if (cqe->user_data & URING_WRITE) {
+            int slot = cqe->user_data & ~URING_WRITE;
+            // a failed write cancels the rest of its chain, so the game
+            // can't go on
+            if (cqe->res != ring.messageLengths[slot]) {
+                quit_on_player_error(ring.messageSeats[slot], PLAYEREOF);
+            }
+            telemetry_queued(ring.messageSeats[slot],
+                    -ring.messageLengths[slot]);
+            ring.freeMessages[ring.freeCount++] = slot;
+        } else {
+            read_done(cqe);
+        }
+        head++;
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * maps the rings of a new io_uring
+ *
+ * @param params    parameters the io_uring was set up with
+ * @return          true if everything could be mapped
+ */
+static bool map_rings(struct io_uring_params* params) {
+    size_t sqSize = params->sq_off.array +
+            params->sq_entries * sizeof(unsigned);
+    size_t cqSize = params->cq_off.cqes +
+            params->cq_entries * sizeof(struct io_uring_cqe);
+    char* rings = mmap(NULL, sqSize > cqSize ? sqSize : cqSize,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd,
+            IORING_OFF_SQ_RING);
+    ring.sqes = mmap(NULL, params->sq_entries * sizeof(struct io_uring_sqe),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd,
+            IORING_OFF_SQES);
+    ring.buffers = mmap(NULL, URING_BUFFERS * sizeof(struct io_uring_buf),
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (rings == MAP_FAILED || ring.sqes == MAP_FAILED ||
+            ring.buffers == MAP_FAILED) {
+        return false;
+    }
+
+    ring.sqHead = (unsigned*)(rings + params->sq_off.head);
+    ring.sqTail = (unsigned*)(rings + params->sq_off.tail);
+    ring.sqMask = *(unsigned*)(rings + params->sq_off.ring_mask);
+    ring.sqArray = (unsigned*)(rings + params->sq_off.array);
+    ring.cqHead = (unsigned*)(rings + params->cq_off.head);
+    ring.cqTail = (unsigned*)(rings + params->cq_off.tail);
+    ring.cqMask = *(unsigned*)(rings + params->cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe*)(rings + params->cq_off.cqes);
+
+    return true;
+}
+
+/**
+ * sets up an io_uring for the players' pipes and arms a read on each
+ *
+ * @param playerCount   number of players
+ * @param playerPipes   communication pipes of players
+ * @return              true if the kernel can do everything needed
+ */
+static bool uring_setup(int playerCount, int*** playerPipes) {
+    struct io_uring_params params;
+    struct io_uring_buf_reg registration;
+
+    memset(&params, 0, sizeof(params));
+    ring.fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (ring.fd < 0) {
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+            !uring_supports(ring.fd, URING_OP_READ_MULTISHOT) ||
+            !map_rings(&params)) {
+        close(ring.fd);
+        return false;
+    }
+
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (uintptr_t)ring.buffers;
+    registration.ring_entries = URING_BUFFERS;
+    registration.bgid = URING_BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PBUF_RING,
+            &registration, 1) != 0) {
+        close(ring.fd);
+        return false;
+    }
+    ring.bufferData = malloc(URING_BUFFERS * URING_BUFFER_SIZE);
+    for (int i = 0; i < URING_BUFFERS; i++) {
+        provide_buffer(i);
+    }
+
+    ring.messages = malloc(URING_WRITES * URING_MESSAGE_SIZE);
+    ring.messageLengths = calloc(URING_WRITES, sizeof(int));
+    ring.messageSeats = calloc(URING_WRITES, sizeof(int));
+    ring.freeMessages = calloc(URING_WRITES, sizeof(int));
+    for (ring.freeCount = 0; ring.freeCount < URING_WRITES;
+            ring.freeCount++) {
+        ring.freeMessages[ring.freeCount] = ring.freeCount;
+    }
+
+    ring.playerCount = playerCount;
+    ring.readFds = calloc(playerCount, sizeof(int));
+    ring.inputs = calloc(playerCount, sizeof(PlayerInput));
+    for (int i = 0; i < playerCount; i++) {
+        ring.readFds[i] = playerPipes[i][0][0];
+        arm_read(i);
+    }
+    uring_enter(0);
+
+    return true;
+}
+
+/**
+ * starts the player io, after the players have said they are ready
+ *
+ * @param wanted        backend asked for
+ * @param playerCount   number of players
+ * @param playerPipes   communication pipes of players
+ * @return              backend in use, IO_SYSCALL if io_uring can't be
+ */
+IoBackend hubio_init(IoBackend wanted, int playerCount, int*** playerPipes) {
+    backend = IO_SYSCALL;
+    if (wanted == IO_URING && uring_setup(playerCount, playerPipes)) {
+        backend = IO_URING;
+    }
+    syscalls = 0;
+    started = now_seconds();
+
+    return backend;
+}
+
+/**
+ * sends a message to a player. with io_uring it only goes once the hub
+ * next waits for a play, or at hubio_finish. a message that a SIGHUP
+ * interrupts may not be sent, as the hub is about to end
+ *
+ * @param playerPipes   communication pipes of players
+ * @param player        player to send to
+ * @param message       the message
+ * @param length        length of message, at most URING_MESSAGE_SIZE
+ */
+void hubio_write(int*** playerPipes, int player, const char* message,
+        int length) {
+    telemetry_sent(1, length);
+    if (backend == IO_SYSCALL) {
+        write(playerPipes[player][1][1], message, length);
+        syscalls++;
+        return;
+    }
+
+    while (ring.freeCount == 0) {
+        if (!uring_enter(1)) {
+            return;
+        }
+        reap();
+    }
+    int slot = ring.freeMessages[--ring.freeCount];
+    memcpy(ring.messages[slot], message, length);
+    ring.messageLengths[slot] = length;
+    ring.messageSeats[slot] = player;
+    telemetry_queued(player, length);
+
+    struct io_uring_sqe* previous = ring.lastWrite;
+    struct io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = playerPipes[player][1][1];
+    sqe->addr = (uintptr_t)ring.messages[slot];
+    sqe->len = length;
+    sqe->off = -1;
+    sqe->user_data = URING_WRITE | slot;
+    // next_sqe may have sent the chain so far to the kernel
+    if (previous != NULL && ring.lastWrite != NULL) {
+        previous->flags |= IOSQE_IO_LINK;
+    }
+    ring.lastWrite = sqe;
+}
+
+/**
+ * reads from a player until a message ends with a newline
+ *
+ * @param playerPipes   communication pipes of players
+ * @param player        player to read from
+ * @param buffer        buffer for the message, null terminated
+ * @param size          size of buffer
+ * @return              length of the message, 0 on EOF or if a SIGHUP
+ *                      interrupted the read
+ */
+int hubio_read(int*** playerPipes, int player, char* buffer, int size) {
+    int length = 0;
+
+    if (backend == IO_SYSCALL) {
+        while (length == 0 || (buffer[length - 1] != '\n' &&
+                length < size - 1)) {
+            ssize_t got = read(playerPipes[player][0][0], buffer + length,
+                    size - 1 - length);
+            syscalls++;
+            if (got <= 0) {
+                return 0;
+            }
+            length += got;
+        }
+        buffer[length] = 0;
+        telemetry_received(length);
+        return length;
+    }
+
+    PlayerInput* input = &ring.inputs[player];
+    while (!input->eof && input->length < URING_LINE_SIZE - 1 &&
+            memchr(input->data, '\n', input->length) == NULL) {
+        // the writes finish without waiting on us, so wait for them too
+        // rather than waking up for each
+        if (!uring_enter(URING_WRITES - ring.freeCount + 1)) {
+            return 0;
+        }
+        reap();
+    }
+    if (memchr(input->data, '\n', input->length) == NULL &&
+            input->length < URING_LINE_SIZE - 1) {
+        return 0;
+    }
+
+    // everything read so far, as read() would have given it
+    length = input->length < size - 1 ? input->length : size - 1;
+    memcpy(buffer, input->data, length);
+    buffer[length] = 0;
+    input->length = 0;
+    telemetry_received(length);
+
+    return length;
+}
+
+/**
+ * sends everything still queued and waits for it to be written, unless
+ * a SIGHUP interrupts
+ */
+void hubio_finish(void) {
+    if (backend == IO_SYSCALL) {
+        return;
+    }
+
+    uring_enter(0);
+    reap();
+    while (ring.freeCount < URING_WRITES && uring_enter(1)) {
+        reap();
+    }
+}
+
+/**
+ * prints the system calls and time taken per trick
+ *
+ * @param tricks    number of tricks played
+ */
+void hubio_stats(int tricks) {
+    double usec = (now_seconds() - started) * 1e6;
+    log_printf(STDOUT_FILENO, "Io=%s tricks=%d syscalls/trick=%.2f "
+            "usec/trick=%.2f\n", backend == IO_URING ? "uring" : "syscall",
+            tricks, (double)syscalls / tricks, usec / tricks);
+}
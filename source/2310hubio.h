@@ -0,0 +1,80 @@
+//
+// Created by caleb on 2019-10-15.
+//
+
+#ifndef ASS3_HUBIO_H
+#define ASS3_HUBIO_H
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+#include "2310shared.h"
+
+// newer than some linux/io_uring.h headers, so not always in the enum
+#define URING_OP_READ_MULTISHOT 49
+#define URING_ENTRIES 256
+#define URING_BUFFERS 256
+#define URING_BUFFER_SIZE 256
+#define URING_BUFFER_GROUP 0
+#define URING_WRITES 256
+#define URING_MESSAGE_SIZE 256
+#define URING_LINE_SIZE 256
+#define URING_WRITE (1ULL << 32)
+
+typedef enum {
+    IO_SYSCALL = 0,
+    IO_URING = 1
+} IoBackend;
+
+/*
+ * what has been read from a player but not yet asked for
+ */
+typedef struct {
+    char data[URING_LINE_SIZE];
+    int length;
+    bool eof;
+} PlayerInput;
+
+/*
+ * an io_uring with its mapped rings. every player's read end has a
+ * multishot read armed, filling buffers from a provided buffer ring.
+ * writes are copied into one of URING_WRITES message slots and queued,
+ * linked to the write queued before them, until the hub next waits
+ */
+typedef struct {
+    int fd;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned* sqArray;
+    struct io_uring_sqe* sqes;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+    unsigned queued;
+    struct io_uring_sqe* lastWrite;
+    struct io_uring_buf_ring* buffers;
+    char* bufferData;
+    char (*messages)[URING_MESSAGE_SIZE];
+    int* messageLengths;
+    int* messageSeats;
+    int* freeMessages;
+    int freeCount;
+    int playerCount;
+    int* readFds;
+    PlayerInput* inputs;
+} Uring;
+
+bool parse_io_backend(const char* spec, IoBackend* backend);
+IoBackend hubio_init(IoBackend backend, int playerCount, int*** playerPipes);
+void hubio_write(int*** playerPipes, int player, const char* message,
+        int length);
+int hubio_read(int*** playerPipes, int player, char* buffer, int size);
+void hubio_finish(void);
+void hubio_stats(int tricks);
+
+#endif //ASS3_HUBIO_H
@@ -0,0 +1,309 @@
+//
+// Created by caleb on 2019-10-15.
+//
+/*
+ * A stand in player for load testing the hub. It plays legally (with the
+ * strategy named by PLAYER_STRATEGY, alice if unset) but waits before each
+ * play and can break the protocol on purpose, all set from the environment
+ * since players only get the protocol args:
+ *
+ * VARIABLE                 EFFECT
+ * LOAD_SEED=<n>            Seed of the delays and faults (default 1). Each
+ *                          play's come from the seed, the seat and the play
+ *                          (in --multi, its game and card), so seats and
+ *                          games don't all get the same ones, and the same
+ *                          seed always gives the same run
+ * LOAD_DELAY=fixed:<us>    Wait us microseconds before each play
+ * LOAD_DELAY=exp:<us>      Wait an exponential time with mean us
+ * LOAD_DELAY=pareto:<us>,<alpha>   Wait a pareto time of at least us, with
+ *                          a heavier tail the smaller alpha is
+ * LOAD_FAULTS=<fault>:<rate>,...   Chance of each fault per play, one of
+ *      split       write the play in two parts with a pause between
+ *      coalesce    hold the play back to go out in one write with the
+ *                  next, or when the hub has nothing more for us (only
+ *                  without PLAYER_THREADS)
+ *      garbage     send a line of junk instead of the play
+ *      eof         close stdout and exit instead of playing
+ *
+ * With --multi, PLAYER_THREADS works as for any player. Exit codes are those
+ * of the other players; a bad LOAD_ variable is an Invalid strategy.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "2310baseplayer.h"
+
+#define LOAD_HOLD_SIZE 4096
+#define LOAD_GARBAGE_SIZE 32
+#define LOAD_SPLIT_PAUSE_US 100
+
+typedef enum {
+    DELAY_NONE = 0,
+    DELAY_FIXED = 1,
+    DELAY_EXP = 2,
+    DELAY_PARETO = 3
+} DelayKind;
+
+typedef enum {
+    FAULT_SPLIT = 0,
+    FAULT_COALESCE = 1,
+    FAULT_GARBAGE = 2,
+    FAULT_EOF = 3,
+    NUM_FAULTS = 4
+} Fault;
+
+typedef struct {
+    DelayKind delay;
+    double delayUs;
+    double alpha;
+    double rates[NUM_FAULTS];
+    uint64_t seed;
+    pthread_mutex_t lock;
+    char held[LOAD_HOLD_SIZE];
+    int heldLength;
+} Load;
+
+static const char* faultNames[NUM_FAULTS] = {"split", "coalesce", "garbage",
+        "eof"};
+
+static Load load = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * gets a uniform random number in (0, 1]
+ *
+ * @param random    state of the generator
+ * @return          the number
+ */
+static double load_uniform(uint64_t* random) {
+    return ((random_next(random) >> 11) + 1) * 0x1.0p-53;
+}
+
+/**
+ * sleeps for a number of microseconds
+ *
+ * @param us    microseconds to sleep
+ */
+static void load_sleep(double us) {
+    struct timespec wait;
+
+    if (us <= 0) {
+        return;
+    }
+    wait.tv_sec = (time_t)(us / 1e6);
+    wait.tv_nsec = (long)((us - wait.tv_sec * 1e6) * 1e3);
+    nanosleep(&wait, NULL);
+}
+
+/**
+ * gets how long to wait before a play
+ *
+ * @param random    state of the play's generator
+ * @return          microseconds to wait
+ */
+static double load_delay(uint64_t* random) {
+    switch (load.delay) {
+        case DELAY_FIXED:
+            return load.delayUs;
+        case DELAY_EXP:
+            return -load.delayUs * log(load_uniform(random));
+        case DELAY_PARETO:
+            return load.delayUs / pow(load_uniform(random), 1 / load.alpha);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * writes out any plays held back by coalesce
+ */
+static void load_flush(void) {
+    if (load.heldLength > 0) {
+        write(STDOUT_FILENO, load.held, load.heldLength);
+        load.heldLength = 0;
+    }
+}
+
+/**
+ * sends a play, after its delay and with whatever fault comes up
+ *
+ * @param message   play to send
+ * @param length    length of message
+ */
+static void load_send(const char* message, int length) {
+    // a play is made once a game, so this is the same however the
+    // PLAYER_THREADS happen to take turns
+    uint64_t random = hash_bytes(message, length, load.seed);
+    double delay = load_delay(&random);
+    double roll[NUM_FAULTS];
+    for (int i = 0; i < NUM_FAULTS; i++) {
+        roll[i] = load_uniform(&random);
+    }
+
+    load_sleep(delay);
+
+    pthread_mutex_lock(&load.lock);
+    if (roll[FAULT_EOF] <= load.rates[FAULT_EOF]) {
+        load_flush();
+        close(STDOUT_FILENO);
+        exit(OK);
+    } else if (roll[FAULT_GARBAGE] <= load.rates[FAULT_GARBAGE]) {
+        char garbage[LOAD_GARBAGE_SIZE];
+        int garbageLength = 1 + random_next(&random) %
+                (LOAD_GARBAGE_SIZE - 1);
+        for (int i = 0; i < garbageLength - 1; i++) {
+            garbage[i] = '!' + random_next(&random) % ('~' - '!');
+        }
+        garbage[garbageLength - 1] = '\n';
+        load_flush();
+        write(STDOUT_FILENO, garbage, garbageLength);
+    } else if (roll[FAULT_COALESCE] <= load.rates[FAULT_COALESCE] &&
+            load.heldLength + length <= LOAD_HOLD_SIZE) {
+        memcpy(load.held + load.heldLength, message, length);
+        load.heldLength += length;
+    } else if (roll[FAULT_SPLIT] <= load.rates[FAULT_SPLIT]) {
+        int first = 1 + random_next(&random) % (length - 1);
+        load_flush();
+        write(STDOUT_FILENO, message, first);
+        load_sleep(LOAD_SPLIT_PAUSE_US);
+        write(STDOUT_FILENO, message + first, length - first);
+    } else if (load.heldLength > 0) {
+        memcpy(load.held + load.heldLength, message, length);
+        load.heldLength += length;
+        load_flush();
+    } else {
+        write(STDOUT_FILENO, message, length);
+    }
+    pthread_mutex_unlock(&load.lock);
+}
+
+/**
+ * sends held plays once the hub has nothing waiting for us, as it may be
+ * waiting on them
+ */
+static void load_wait(void) {
+    struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+
+    pthread_mutex_lock(&load.lock);
+    if (load.heldLength > 0 && poll(&input, 1, 0) == 0) {
+        load_flush();
+    }
+    pthread_mutex_unlock(&load.lock);
+}
+
+/**
+ * reads LOAD_DELAY
+ *
+ * @param spec  value of LOAD_DELAY
+ * @return      true if it is valid
+ */
+static bool parse_delay(const char* spec) {
+    int length = 0;
+
+    if (strcmp(spec, "none") == 0) {
+        load.delay = DELAY_NONE;
+        return true;
+    } else if (sscanf(spec, "fixed:%lf%n", &load.delayUs, &length) == 1) {
+        load.delay = DELAY_FIXED;
+    } else if (sscanf(spec, "exp:%lf%n", &load.delayUs, &length) == 1) {
+        load.delay = DELAY_EXP;
+    } else if (sscanf(spec, "pareto:%lf,%lf%n", &load.delayUs, &load.alpha,
+            &length) == 2 && load.alpha > 0) {
+        load.delay = DELAY_PARETO;
+    } else {
+        return false;
+    }
+
+    return spec[length] == 0 && load.delayUs >= 0;
+}
+
+/**
+ * reads LOAD_FAULTS
+ *
+ * @param spec  value of LOAD_FAULTS
+ * @return      true if it is valid
+ */
+static bool parse_faults(const char* spec) {
+    while (*spec != 0) {
+        int fault = 0;
+        int length = 0;
+        double rate;
+
+        while (fault < NUM_FAULTS &&
+                (strncmp(spec, faultNames[fault], strlen(faultNames[fault]))
+                != 0 || spec[strlen(faultNames[fault])] != ':')) {
+            fault++;
+        }
+        if (fault == NUM_FAULTS) {
+            return false;
+        }
+        spec += strlen(faultNames[fault]) + 1;
+        if (sscanf(spec, "%lf%n", &rate, &length) != 1 || rate < 0 ||
+                rate > 1) {
+            return false;
+        }
+        load.rates[fault] = rate;
+        spec += length;
+        if (*spec == ',') {
+            spec++;
+        } else if (*spec != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * reads LOAD_SEED, mixing in our seat
+ *
+ * @param spec  value of LOAD_SEED
+ * @return      true if it is a number
+ */
+static bool parse_seed(const char* spec) {
+    char* end;
+    errno = 0;
+    uint64_t seed = strtoull(spec, &end, 10);
+    if (!isdigit(spec[0]) || *end != 0 || errno == ERANGE) {
+        return false;
+    }
+
+    int seat = player_seat();
+    load.seed = hash_bytes(&seat, sizeof(seat),
+            hash_bytes(&seed, sizeof(seed), HASH_START));
+    return true;
+}
+
+/**
+ * sets up the delays and faults and gets the strategy to play legally with
+ *
+ * @return  the spec of the strategy, NULL if a LOAD_ variable is invalid
+ */
+const char* player_strategy(void) {
+    PlayerIo io = {load_send, load_wait};
+
+    if (!parse_seed(getenv("LOAD_SEED") != NULL ? getenv("LOAD_SEED")
+            : "1")) {
+        return NULL;
+    }
+    if (getenv("LOAD_DELAY") != NULL && !parse_delay(getenv("LOAD_DELAY"))) {
+        return NULL;
+    }
+    if (getenv("LOAD_FAULTS") != NULL &&
+            !parse_faults(getenv("LOAD_FAULTS"))) {
+        return NULL;
+    }
+    if (getenv("PLAYER_THREADS") != NULL) {
+        // a worker can play after the main thread has checked for input
+        load.rates[FAULT_COALESCE] = 0;
+    }
+    set_player_io(&io);
+
+    if (getenv("PLAYER_STRATEGY") == NULL) {
+        return strategy_builtin("alice");
+    }
+    return strategy_load(getenv("PLAYER_STRATEGY"));
+}
@@ -0,0 +1,343 @@
+//
+// Created by caleb on 2019-10-02.
+//
+/*
+ * Transcript logging off the game thread.
+ *
+ * Game threads format a line and push it into a bounded lock-free ring
+ * (many producers, one consumer). A writer thread drains the ring and writes
+ * runs of records for the same fd with a single write(). A line longer than
+ * a record takes several, claimed together so it is never split by another
+ * producer's. When the ring is full the LogPolicy decides whether the
+ * producer waits, throws the line away, or writes it synchronously to a
+ * spill file instead. log_drain waits for the writer to catch up.
+ *
+ * Until log_init is called, and after log_shutdown, log_write just calls
+ * write() so the output is never lost.
+ */
+
+#include "2310log.h"
+
+static Logger logger;
+static atomic_bool started;
+
+/**
+ * parses a policy of the form block, drop or spill:<file>
+ *
+ * @param spec      policy to parse
+ * @param policy    policy to put value into
+ * @param spillFile file to spill to, or NULL if not spilling
+ * @return          true if legal, false otherwise
+ */
+bool parse_log_policy(const char* spec, LogPolicy* policy,
+        const char** spillFile) {
+    *spillFile = NULL;
+    if (strcmp(spec, "block") == 0) {
+        *policy = LOG_BLOCK;
+    } else if (strcmp(spec, "drop") == 0) {
+        *policy = LOG_DROP;
+    } else if (strncmp(spec, "spill:", strlen("spill:")) == 0 &&
+            spec[strlen("spill:")] != 0) {
+        *policy = LOG_SPILL;
+        *spillFile = spec + strlen("spill:");
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * writes all of a buffer to a file descriptor
+ *
+ * @param fd        file to write to
+ * @param data      bytes to write
+ * @param length    number of bytes
+ */
+static void write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+/**
+ * tries to claim as many free records in a row as the bytes need, in one
+ * claim so no other producer's records can come between them, and fill
+ * them
+ *
+ * @param fd        file the records are for
+ * @param data      bytes of the records
+ * @param length    number of bytes, at most LOG_RING_SIZE records' worth
+ * @return          true if pushed, false if the ring is too full
+ */
+static bool try_push(int fd, const char* data, int length) {
+    size_t count = (length + LOG_RECORD_SIZE - 1) / LOG_RECORD_SIZE;
+    size_t position = atomic_load_explicit(&logger.head,
+            memory_order_relaxed);
+
+    while (true) {
+        // the writer frees records in order, so if the last is free so
+        // are the ones before it
+        LogRecord* last = &logger.records[(position + count - 1) %
+                LOG_RING_SIZE];
+        size_t sequence = atomic_load_explicit(&last->sequence,
+                memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence -
+                (intptr_t)(position + count - 1);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&logger.head,
+                    &position, position + count, memory_order_relaxed,
+                    memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = atomic_load_explicit(&logger.head,
+                    memory_order_relaxed);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        LogRecord* record = &logger.records[(position + i) % LOG_RING_SIZE];
+        int size = length - i * LOG_RECORD_SIZE;
+        record->fd = fd;
+        record->length = size < LOG_RECORD_SIZE ? size : LOG_RECORD_SIZE;
+        memcpy(record->data, data + i * LOG_RECORD_SIZE, record->length);
+        atomic_store_explicit(&record->sequence, position + i + 1,
+                memory_order_release);
+    }
+    sem_post(&logger.pending);
+
+    return true;
+}
+
+/**
+ * pushes the records of a line, applying the policy to the whole line if
+ * the ring is full
+ *
+ * @param fd        file the line is for
+ * @param data      bytes of the line
+ * @param length    number of bytes, at most LOG_RING_SIZE records' worth
+ */
+static void push_record(int fd, const char* data, int length) {
+    while (!try_push(fd, data, length)) {
+        switch (logger.policy) {
+            case LOG_BLOCK:
+                sched_yield();
+                break;
+            case LOG_DROP:
+                atomic_fetch_add_explicit(&logger.dropped,
+                        (length + LOG_RECORD_SIZE - 1) / LOG_RECORD_SIZE,
+                        memory_order_relaxed);
+                return;
+            case LOG_SPILL:
+                write_all(logger.spillFd, data, length);
+                return;
+        }
+    }
+}
+
+/**
+ * writer thread. each wakeup drains every record that is ready, batching
+ * consecutive records for the same file into one write
+ *
+ * @param arg   unused
+ * @return      NULL
+ */
+static void* writer_thread(void* arg) {
+    char* batch = malloc(LOG_BATCH_SIZE);
+    int batchFd = -1;
+    size_t batchLength = 0;
+    bool running = true;
+
+    while (running) {
+        sem_wait(&logger.pending);
+        running = atomic_load(&logger.running);
+
+        while (true) {
+            LogRecord* record =
+                    &logger.records[logger.tail % LOG_RING_SIZE];
+            size_t sequence = atomic_load_explicit(&record->sequence,
+                    memory_order_acquire);
+            if (sequence != logger.tail + 1) {
+                break;
+            }
+
+            if (record->fd != batchFd ||
+                    batchLength + record->length > LOG_BATCH_SIZE) {
+                write_all(batchFd, batch, batchLength);
+                atomic_store_explicit(&logger.written, logger.tail,
+                        memory_order_release);
+                batchFd = record->fd;
+                batchLength = 0;
+            }
+            memcpy(batch + batchLength, record->data, record->length);
+            batchLength += record->length;
+
+            atomic_store_explicit(&record->sequence,
+                    logger.tail + LOG_RING_SIZE, memory_order_release);
+            logger.tail++;
+        }
+
+        write_all(batchFd, batch, batchLength);
+        batchLength = 0;
+        atomic_store_explicit(&logger.written, logger.tail,
+                memory_order_release);
+    }
+
+    free(batch);
+    return NULL;
+}
+
+/**
+ * a forked child has no writer thread, so it must write directly
+ */
+static void forget_writer(void) {
+    atomic_store(&started, false);
+}
+
+/**
+ * starts the writer thread. log_shutdown is registered to run at exit so
+ * queued records are written however the program ends
+ *
+ * @param policy    what to do when the ring is full
+ * @param spillFile file to spill to for LOG_SPILL, otherwise unused
+ * @return          true if started, false otherwise
+ */
+bool log_init(LogPolicy policy, const char* spillFile) {
+    logger.policy = policy;
+    logger.spillFd = -1;
+    if (policy == LOG_SPILL) {
+        logger.spillFd = open(spillFile, O_WRONLY | O_CREAT | O_APPEND,
+                0644);
+        if (logger.spillFd == -1) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        atomic_init(&logger.records[i].sequence, i);
+    }
+    atomic_init(&logger.head, 0);
+    logger.tail = 0;
+    atomic_init(&logger.written, 0);
+    atomic_init(&logger.dropped, 0);
+    atomic_init(&logger.running, true);
+    sem_init(&logger.pending, 0, 0);
+
+    // signals go to the game thread, which is the one waiting to be
+    // woken by them
+    sigset_t all;
+    sigset_t previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &previous);
+    int created = pthread_create(&logger.writer, NULL, writer_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (created != 0) {
+        return false;
+    }
+
+    atomic_store(&started, true);
+    pthread_atfork(NULL, NULL, forget_writer);
+    atexit(log_shutdown);
+    return true;
+}
+
+/**
+ * queues bytes to be written to a file, split into records that are
+ * claimed together so they stay whole
+ *
+ * @param fd        file to write to
+ * @param data      bytes to write
+ * @param length    number of bytes
+ */
+void log_write(int fd, const char* data, int length) {
+    if (!atomic_load_explicit(&started, memory_order_acquire)) {
+        write_all(fd, data, length);
+        return;
+    }
+
+    // more than the whole ring could never be claimed at once
+    for (int i = 0; i < length; i += LOG_RING_SIZE * LOG_RECORD_SIZE) {
+        int chunk = length - i;
+        if (chunk > LOG_RING_SIZE * LOG_RECORD_SIZE) {
+            chunk = LOG_RING_SIZE * LOG_RECORD_SIZE;
+        }
+        push_record(fd, data + i, chunk);
+    }
+}
+
+/**
+ * formats a line and queues it to be written to a file
+ *
+ * @param fd        file to write to
+ * @param format    printf style format
+ */
+void log_printf(int fd, const char* format, ...) {
+    char buffer[LOG_RECORD_SIZE];
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length >= (int)sizeof(buffer)) {
+        char* longBuffer = malloc(length + 1);
+        va_start(args, format);
+        vsnprintf(longBuffer, length + 1, format, args);
+        va_end(args);
+        log_write(fd, longBuffer, length);
+        free(longBuffer);
+    } else if (length > 0) {
+        log_write(fd, buffer, length);
+    }
+}
+
+/**
+ * waits until every line queued so far has been written, for a caller that
+ * must not record something before the line saying so is out
+ */
+void log_drain(void) {
+    if (!atomic_load_explicit(&started, memory_order_acquire)) {
+        return;
+    }
+
+    size_t queued = atomic_load(&logger.head);
+    while (atomic_load_explicit(&logger.written, memory_order_acquire) <
+            queued) {
+        sched_yield();
+    }
+}
+
+/**
+ * gets the number of records thrown away by LOG_DROP
+ *
+ * @return  number of records dropped
+ */
+size_t log_dropped(void) {
+    return atomic_load(&logger.dropped);
+}
+
+/**
+ * writes everything still queued and stops the writer thread
+ */
+void log_shutdown(void) {
+    if (!atomic_exchange(&started, false)) {
+        return;
+    }
+
+    atomic_store(&logger.running, false);
+    sem_post(&logger.pending);
+    pthread_join(logger.writer, NULL);
+
+    if (logger.spillFd != -1) {
+        close(logger.spillFd);
+    }
+}
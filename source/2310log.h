@@ -0,0 +1,58 @@
+//
+// Created by caleb on 2019-10-02.
+//
+
+#ifndef ASS3_LOG_H
+#define ASS3_LOG_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <fcntl.h>
+
+#include "2310shared.h"
+
+#define LOG_RECORD_SIZE 248
+#define LOG_RING_SIZE 1024
+#define LOG_BATCH_SIZE 8192
+
+typedef enum {
+    LOG_BLOCK = 0,
+    LOG_DROP = 1,
+    LOG_SPILL = 2
+} LogPolicy;
+
+typedef struct {
+    atomic_size_t sequence;
+    int fd;
+    int length;
+    char data[LOG_RECORD_SIZE];
+} LogRecord;
+
+typedef struct {
+    LogRecord records[LOG_RING_SIZE];
+    atomic_size_t head;
+    size_t tail;
+    atomic_size_t written;
+    sem_t pending;
+    atomic_bool running;
+    atomic_size_t dropped;
+    LogPolicy policy;
+    int spillFd;
+    pthread_t writer;
+} Logger;
+
+bool parse_log_policy(const char* spec, LogPolicy* policy,
+        const char** spillFile);
+bool log_init(LogPolicy policy, const char* spillFile);
+void log_write(int fd, const char* data, int length);
+void log_printf(int fd, const char* format, ...);
+void log_drain(void);
+size_t log_dropped(void);
+void log_shutdown(void);
+
+#endif //ASS3_LOG_H
@@ -0,0 +1,374 @@
+//
+// Created by caleb on 2019-10-14.
+//
+/*
+ * Multi game mode of the player framework, started as
+ *
+ *      player --multi
+ *
+ * One process plays one seat of any number of games at once, as used by
+ * 2310hub --tournament. Every message in either direction starts with
+ * G<id>: for the game it belongs to. A game is started by
+ *
+ *      G<id>:GAME<players>,<myid>,<threshold>,<handsize>
+ *
+ * then gets the usual HAND, NEWROUND, PLAYED and GAMEOVER messages, and
+ * the player answers G<id>:PLAY<card>. GAMEOVER ends only its own game;
+ * the process exits on EOF.
+ *
+ * With PLAYER_THREADS=n the games are split between n worker threads by
+ * id, each with its own table of games, and the main thread only reads
+ * lines and hands them out. Replies are short single writes, so workers
+ * can share stdout, and a player io that holds replies back must lock.
+ */
+
+#include "2310multi.h"
+
+/**
+ * gets the first slot to look for a game in
+ *
+ * @param table     table to look in
+ * @param id        id of the game
+ * @return          index of the slot
+ */
+static int table_slot(const GameTable* table, long id) {
+    return (int)(((uint64_t)id * 0x9E3779B97F4A7C15ULL) >> 32) &
+            (table->size - 1);
+}
+
+/**
+ * inits an empty table
+ *
+ * @param table     table to init
+ */
+void table_init(GameTable* table) {
+    table->size = MULTI_TABLE_SIZE;
+    table->count = 0;
+    table->games = malloc(table->size * sizeof(MultiGame));
+    for (int i = 0; i < table->size; i++) {
+        table->games[i].id = -1;
+    }
+}
+
+/**
+ * finds a game
+ *
+ * @param table     table to look in
+ * @param id        id of the game
+ * @return          the game, NULL if there isn't one
+ */
+MultiGame* table_find(GameTable* table, long id) {
+    for (int i = table_slot(table, id); table->games[i].id != -1;
+            i = (i + 1) & (table->size - 1)) {
+        if (table->games[i].id == id) {
+            return &table->games[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * doubles the size of a table
+ *
+ * @param table     table to grow
+ */
+static void table_grow(GameTable* table) {
+    MultiGame* old = table->games;
+    int oldSize = table->size;
+
+    table->size *= 2;
+    table->games = malloc(table->size * sizeof(MultiGame));
+    for (int i = 0; i < table->size; i++) {
+        table->games[i].id = -1;
+    }
+    for (int i = 0; i < oldSize; i++) {
+        if (old[i].id != -1) {
+            int slot = table_slot(table, old[i].id);
+            while (table->games[slot].id != -1) {
+                slot = (slot + 1) & (table->size - 1);
+            }
+            table->games[slot] = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * adds a game, growing the table if need be
+ *
+ * @param table     table to add to
+ * @param id        id of the game
+ * @return          the new game with only its id set, NULL if the id is
+ *                  already in use
+ */
+MultiGame* table_add(GameTable* table, long id) {
+    if (table_find(table, id) != NULL) {
+        return NULL;
+    }
+    if (2 * (table->count + 1) > table->size) {
+        table_grow(table);
+    }
+
+    int slot = table_slot(table, id);
+    while (table->games[slot].id != -1) {
+        slot = (slot + 1) & (table->size - 1);
+    }
+    table->games[slot].id = id;
+    table->count++;
+
+    return &table->games[slot];
+}
+
+/**
+ * removes a game, moving back any games after it that would no longer be
+ * found
+ *
+ * @param table     table to remove from
+ * @param id        id of the game
+ */
+void table_remove(GameTable* table, long id) {
+    MultiGame* game = table_find(table, id);
+    if (game == NULL) {
+        return;
+    }
+
+    int mask = table->size - 1;
+    int hole = game - table->games;
+    table->games[hole].id = -1;
+    table->count--;
+
+    for (int i = (hole + 1) & mask; table->games[i].id != -1;
+            i = (i + 1) & mask) {
+        int home = table_slot(table, table->games[i].id);
+        // move the game back if the hole is between its home and it
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table->games[hole] = table->games[i];
+            table->games[i].id = -1;
+            hole = i;
+        }
+    }
+}
+
+/**
+ * plays our card in a game and tells the hub
+ *
+ * @param worker    worker the game belongs to
+ * @param game      game to play in
+ */
+static void play_turn(MultiWorker* worker, MultiGame* game) {
+    char reply[BUFFER_SIZE];
+    int64_t traced = trace_begin();
+    Card card = cached_move(&game->cache, &game->state);
+    trace_end("cached_move", traced, "game", game->id);
+    int index = card_index(card);
+
+    game->hand[RULES_SUIT(index)] &= ~(1u << RULES_RANK(index));
+    record_play(&game->state, index);
+    precompute_moves(&game->cache, worker->strategy, game->hand);
+
+    int length = sprintf(reply, "G%ld:PLAY%c%c\n", game->id, card.suit,
+            card.rank);
+    player_send(reply, length);
+}
+
+/**
+ * starts a game from a GAME message
+ *
+ * @param worker    worker to add the game to
+ * @param id        id of the game
+ * @param message   message without the G<id>: prefix
+ */
+static void start_game(MultiWorker* worker, long id, const char* message) {
+    int playerCount, position, threshold, handSize, length = 0;
+
+    if (sscanf(message, "GAME%d,%d,%d,%d%n", &playerCount, &position,
+            &threshold, &handSize, &length) != 4 ||
+            message[length] != 0 || playerCount < 2 ||
+            playerCount > MAX_PLAYERS || position < 0 ||
+            position >= playerCount || threshold < 2 || handSize < 1) {
+        quit_on_error(BADMESSAGE);
+    }
+
+    MultiGame* game = table_add(&worker->games, id);
+    if (game == NULL) {
+        quit_on_error(BADMESSAGE);
+    }
+    game->stats.playerCount = playerCount;
+    game->stats.position = position;
+    game->stats.threshold = threshold;
+    game->stats.handSize = handSize;
+    game->stats.currentPlayer = 0;
+    memset(game->hand, 0, sizeof(game->hand));
+    init_state(&game->state, playerCount, threshold);
+    precompute_moves(&game->cache, worker->strategy, game->hand);
+}
+
+/**
+ * handles one line from the hub
+ *
+ * @param worker    worker the game of the line belongs to
+ * @param line      line without its newline, modified
+ */
+void multi_message(MultiWorker* worker, char* line) {
+    int64_t traced = trace_begin();
+    char* end;
+
+    if (line[0] != 'G' || !isdigit((int)line[1])) {
+        quit_on_error(BADMESSAGE);
+    }
+    long id = strtol(line + 1, &end, 10);
+    if (*end != ':') {
+        quit_on_error(BADMESSAGE);
+    }
+    char* message = end + 1;
+
+    if (strncmp(message, "GAME", 4) == 0 && isdigit((int)message[4])) {
+        start_game(worker, id, message);
+        return;
+    }
+
+    MultiGame* game = table_find(&worker->games, id);
+    if (game == NULL) {
+        quit_on_error(BADMESSAGE);
+    }
+
+    Instruction instruction;
+    instruction.type = calloc(MAX_INSTRUCTION_LEN, sizeof(char));
+    instruction.argc = 0;
+    instruction.args = NULL;
+    get_instruction_type(message, &instruction.type);
+
+    PlayerState* state = &game->state;
+    if (strcmp(instruction.type, "HAND") == 0) {
+        get_hand_args(message, &instruction.argc, &instruction.args);
+        if (instruction.argc != game->stats.handSize) {
+            quit_on_error(BADMESSAGE);
+        }
+        init_hand(instruction.argc, instruction.args, game->hand);
+        precompute_moves(&game->cache, worker->strategy, game->hand);
+    } else if (strcmp(instruction.type, "NEWROUND") == 0) {
+        get_newround_args(message, &instruction.argc, &instruction.args);
+        int lead = strtol(instruction.args[0], NULL, 10);
+        if (lead >= game->stats.playerCount) {
+            quit_on_error(BADMESSAGE);
+        }
+        start_trick(state, lead);
+        if (lead == game->stats.position) {
+            play_turn(worker, game);
+        }
+    } else if (strcmp(instruction.type, "PLAYED") == 0) {
+        get_played_args(message, &instruction.argc, &instruction.args);
+        int player = strtol(instruction.args[0], NULL, 10);
+        if (state->played == state->playerCount || player !=
+                (state->leadPlayer + state->played) % state->playerCount) {
+            quit_on_error(BADMESSAGE);
+        }
+        Card card = {instruction.args[1][0], instruction.args[1][1]};
+        record_play(state, card_index(card));
+        if (state->played < state->playerCount &&
+                (player + 1) % state->playerCount == game->stats.position) {
+            play_turn(worker, game);
+        }
+    } else if (strcmp(instruction.type, "GAMEOVER") == 0) {
+        table_remove(&worker->games, id);
+    } else {
+        quit_on_error(BADMESSAGE);
+    }
+
+    free_instruction(&instruction);
+    trace_end("message", traced, "game", id);
+}
+
+/**
+ * handles lines from a worker's queue until it gets a NULL one
+ *
+ * @param arg   the MultiWorker
+ * @return      NULL
+ */
+static void* work(void* arg) {
+    MultiWorker* worker = (MultiWorker*)arg;
+    LineQueue* queue = &worker->queue;
+
+    while (true) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->count == 0) {
+            pthread_cond_wait(&queue->ready, &queue->lock);
+        }
+        char* line = queue->lines[queue->head];
+        queue->head = (queue->head + 1) % MULTI_QUEUE_SIZE;
+        queue->count--;
+        pthread_cond_signal(&queue->space);
+        pthread_mutex_unlock(&queue->lock);
+
+        if (line == NULL) {
+            return NULL;
+        }
+        multi_message(worker, line);
+        free(line);
+    }
+}
+
+/**
+ * adds a line to a worker's queue, waiting for room
+ *
+ * @param queue     queue to add to
+ * @param line      malloced line, or NULL to stop the worker
+ */
+static void push_line(LineQueue* queue, char* line) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == MULTI_QUEUE_SIZE) {
+        pthread_cond_wait(&queue->space, &queue->lock);
+    }
+    queue->lines[(queue->head + queue->count) % MULTI_QUEUE_SIZE] = line;
+    queue->count++;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * plays games until the hub closes stdin
+ *
+ * @param strategy  strategy to play every game with
+ * @param threads   number of worker threads, 0 to play on this thread
+ */
+void run_multi(const StrategyTable* strategy, int threads) {
+    int workerCount = threads == 0 ? 1 : threads;
+    MultiWorker* workers = calloc(workerCount, sizeof(MultiWorker));
+    pthread_t* ids = calloc(workerCount, sizeof(pthread_t));
+    char* line;
+
+    for (int i = 0; i < workerCount; i++) {
+        workers[i].strategy = strategy;
+        table_init(&workers[i].games);
+        if (threads != 0) {
+            LineQueue* queue = &workers[i].queue;
+            pthread_mutex_init(&queue->lock, NULL);
+            pthread_cond_init(&queue->ready, NULL);
+            pthread_cond_init(&queue->space, NULL);
+            queue->lines = calloc(MULTI_QUEUE_SIZE, sizeof(char*));
+            pthread_create(&ids[i], NULL, work, &workers[i]);
+        }
+    }
+
+    player_handshake();
+
+    while ((line = player_receive()) != NULL) {
+        if (threads == 0) {
+            multi_message(&workers[0], line);
+        } else {
+            long id = line[0] == 'G' ? strtol(line + 1, NULL, 10) : 0;
+            push_line(&workers[(id < 0 ? -id : id) % workerCount].queue,
+                    strdup(line));
+        }
+    }
+
+    if (threads != 0) {
+        for (int i = 0; i < workerCount; i++) {
+            push_line(&workers[i].queue, NULL);
+        }
+        for (int i = 0; i < workerCount; i++) {
+            pthread_join(ids[i], NULL);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+//
+// Created by caleb on 2019-10-14.
+//
+
+#ifndef ASS3_MULTI_H
+#define ASS3_MULTI_H
+
+#include <pthread.h>
+
+#include "2310baseplayer.h"
+
+#define MULTI_TABLE_SIZE 256
+#define MULTI_QUEUE_SIZE 1024
+#define MAX_MULTI_THREADS 64
+
+/*
+ * one game of a multi game player. id is -1 for an empty slot of the table
+ */
+typedef struct {
+    long id;
+    GameStats stats;
+    uint32_t hand[NUM_SUITS];
+    PlayerState state;
+    MoveCache cache;
+} MultiGame;
+
+/*
+ * games by id, open addressing with linear probing. size is a power of 2
+ * and at most half the slots are used
+ */
+typedef struct {
+    int size;
+    int count;
+    MultiGame* games;
+} GameTable;
+
+/*
+ * lines waiting for a worker, a ring of MULTI_QUEUE_SIZE lines. a NULL line
+ * tells the worker to stop
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t space;
+    int head;
+    int count;
+    char** lines;
+} LineQueue;
+
+typedef struct {
+    const StrategyTable* strategy;
+    GameTable games;
+    LineQueue queue;
+} MultiWorker;
+
+void table_init(GameTable* table);
+MultiGame* table_find(GameTable* table, long id);
+MultiGame* table_add(GameTable* table, long id);
+void table_remove(GameTable* table, long id);
+
+void multi_message(MultiWorker* worker, char* line);
+void run_multi(const StrategyTable* strategy, int threads);
+
+#endif //ASS3_MULTI_H
@@ -0,0 +1,178 @@
+//
+// Created by caleb on 2019-10-15.
+//
+/*
+ * Core placement for the hub and its players. Every move is a pipe round
+ * trip between the hub and a player, so they run fastest on cores sharing
+ * a cache. The cache topology comes from sysfs; without it (or with only
+ * one cpu) everything goes on the cpus we are allowed, in order.
+ */
+
+// cpu sets and sched_getcpu
+#define _GNU_SOURCE
+#include <sched.h>
+
+#include "2310placement.h"
+
+/**
+ * reads a sysfs cpu list such as 0-3,8,10-11
+ *
+ * @param list  the list
+ * @param set   set to put the cpus in
+ * @return      true if the list is valid
+ */
+static bool parse_cpu_list(const char* list, cpu_set_t* set) {
+    CPU_ZERO(set);
+
+    while (*list != 0 && *list != '\n') {
+        char* end;
+        long first = strtol(list, &end, 10);
+        long last = first;
+        if (end == list) {
+            return false;
+        }
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list) {
+                return false;
+            }
+        }
+        for (long cpu = first; cpu <= last && cpu < MAX_CPUS; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        list = *end == ',' ? end + 1 : end;
+    }
+
+    return true;
+}
+
+/**
+ * reads a sysfs file of a cpu's cache
+ *
+ * @param cpu       the cpu
+ * @param index     index of the cache
+ * @param name      name of the file
+ * @param buffer    buffer of CPU_PATH_SIZE to read into
+ * @return          true if the file could be read
+ */
+static bool read_cache_file(int cpu, int index, const char* name,
+        char* buffer) {
+    char path[CPU_PATH_SIZE];
+    snprintf(path, CPU_PATH_SIZE, CPU_PATH, cpu, index, name);
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    bool ok = fgets(buffer, CPU_PATH_SIZE, file) != NULL;
+    fclose(file);
+
+    return ok;
+}
+
+/**
+ * finds the cpus sharing a cache with a cpu
+ *
+ * @param cpu       the cpu
+ * @param level     level of the cache, 0 for the last level
+ * @param set       set to put the sharing cpus in
+ * @return          level of the cache found, 0 if there isn't one
+ */
+static int shared_cache(int cpu, int level, cpu_set_t* set) {
+    char buffer[CPU_PATH_SIZE];
+    int found = 0;
+
+    for (int index = 0; index < MAX_CACHE_INDEX; index++) {
+        if (!read_cache_file(cpu, index, "level", buffer)) {
+            break;
+        }
+        int cacheLevel = strtol(buffer, NULL, 10);
+        if ((level == 0 && cacheLevel > found) || cacheLevel == level) {
+            if (read_cache_file(cpu, index, "shared_cpu_list", buffer) &&
+                    parse_cpu_list(buffer, set)) {
+                found = cacheLevel;
+            }
+        }
+    }
+
+    return found;
+}
+
+/**
+ * finds the cpus to place the hub and its players on: those we may run on
+ * that share a last level cache with the cpu we are on now
+ *
+ * @param group     group to fill
+ * @return          true if the cache topology was found
+ */
+bool placement_group(CpuGroup* group) {
+    cpu_set_t allowed, last, near;
+    int current = sched_getcpu();
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        CPU_ZERO(&allowed);
+        CPU_SET(current < 0 ? 0 : current, &allowed);
+    }
+    if (current < 0 || !CPU_ISSET(current, &allowed)) {
+        for (current = 0; !CPU_ISSET(current, &allowed); current++) {
+        }
+    }
+
+    bool found = shared_cache(current, 0, &last) != 0;
+    if (found) {
+        CPU_AND(&last, &last, &allowed);
+    } else {
+        CPU_OR(&last, &allowed, &allowed);
+    }
+
+    // take each L2 in turn, starting with ours
+    group->count = 0;
+    for (int cpu = current; CPU_COUNT(&last) > 0 &&
+            group->count < MAX_CPUS; cpu = (cpu + 1) % MAX_CPUS) {
+        if (!CPU_ISSET(cpu, &last)) {
+            continue;
+        }
+        if (shared_cache(cpu, 2, &near) == 0) {
+            CPU_ZERO(&near);
+            CPU_SET(cpu, &near);
+        }
+        CPU_AND(&near, &near, &last);
+        for (int other = cpu; CPU_COUNT(&near) > 0;
+                other = (other + 1) % MAX_CPUS) {
+            if (CPU_ISSET(other, &near)) {
+                group->cpus[group->count++] = other;
+                CPU_CLR(other, &near);
+                CPU_CLR(other, &last);
+            }
+        }
+    }
+
+    return found;
+}
+
+/**
+ * gets the cpu for a slot, the hub being slot 0 and player i slot i + 1.
+ * slots wrap around once every cpu of the group is used
+ *
+ * @param group     group to place in
+ * @param slot      the slot
+ * @return          the cpu
+ */
+int placement_cpu(const CpuGroup* group, int slot) {
+    return group->cpus[slot % group->count];
+}
+
+/**
+ * pins the calling process to a cpu. pinning is only a speed up, so
+ * failing to pin is ignored
+ *
+ * @param cpu   cpu to pin to
+ */
+void placement_pin(int cpu) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
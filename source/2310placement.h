@@ -0,0 +1,29 @@
+//
+// Created by caleb on 2019-10-15.
+//
+
+#ifndef ASS3_PLACEMENT_H
+#define ASS3_PLACEMENT_H
+
+#include "2310shared.h"
+
+#define CPU_PATH "/sys/devices/system/cpu/cpu%d/cache/index%d/%s"
+#define CPU_PATH_SIZE 128
+#define MAX_CACHE_INDEX 8
+#define MAX_CPUS 1024
+
+/*
+ * the cpus the hub and its players are pinned to, all sharing the hub's
+ * last level cache. cpus that share an L2 are next to each other, so
+ * neighbouring slots are as close as they can be
+ */
+typedef struct {
+    int count;
+    int cpus[MAX_CPUS];
+} CpuGroup;
+
+bool placement_group(CpuGroup* group);
+int placement_cpu(const CpuGroup* group, int slot);
+void placement_pin(int cpu);
+
+#endif //ASS3_PLACEMENT_H
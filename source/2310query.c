@@ -0,0 +1,409 @@
+//
+// Created by caleb on 2019-10-06.
+//
+/*
+ * EXIT CONDITION                               MESSAGE
+ * 0    Normal exit
+ * 1    Incorrect arguments                     Usage: 2310query store
+ *                                              lead-suits|seats|
+ *                                              count column op value|
+ *                                              sum column
+ * 2    Store missing or unreadable             Store error
+ *
+ * QUERY                    RESULT
+ * lead-suits               tricks led in each suit and how often the
+ *                          leader won them
+ * seats                    per seat averages of tricks, d cards and score,
+ *                          and how many games the seat reached the threshold
+ * count column op value    number of values in column for which
+ *                          "value op value" holds. op is one of
+ *                          = != < <= > >=
+ * sum column               total of all values in column
+ */
+
+#include "2310columns.h"
+
+typedef enum {
+    EQ = 0,
+    NE = 1,
+    LT = 2,
+    LE = 3,
+    GT = 4,
+    GE = 5
+} Op;
+
+/*
+ * counts the values from start to end of a width byte column that pass test.
+ * kept to a flat loop over one type so the compiler vectorises it
+ */
+#define COUNT_WHERE(type, test) { \
+    const type* values = (const type*)column->data; \
+    for (uint64_t i = start; i < end; i++) { \
+        count += (values[i] test value); \
+    } \
+}
+
+/**
+ * prints the usage message and exits
+ */
+void usage(void) {
+    fputs("Usage: 2310query store lead-suits|seats|count column op value|"
+            "sum column\n", stderr);
+    exit(1);
+}
+
+/**
+ * maps a column of the store, exiting if it can't be read
+ *
+ * @param store         directory of the store
+ * @param id            which column
+ * @param playerCount   number of players in the games of the store
+ * @param column        column to init
+ */
+void map_or_quit(const char* store, int id, int playerCount,
+        MappedColumn* column) {
+    if (!column_map(store, id, playerCount, column)) {
+        fputs("Store error\n", stderr);
+        exit(2);
+    }
+}
+
+/**
+ * parses a comparison operator
+ *
+ * @param text  text of the operator
+ * @return      the operator, exits if not legal
+ */
+Op parse_op(const char* text) {
+    const char* ops[] = {"=", "!=", "<", "<=", ">", ">="};
+    for (int i = 0; i < 6; i++) {
+        if (strcmp(text, ops[i]) == 0) {
+            return i;
+        }
+    }
+
+    usage();
+    return EQ;
+}
+
+/**
+ * checks whether every value between min and max passes a comparison
+ *
+ * @param min   smallest value
+ * @param max   largest value
+ * @param op    comparison
+ * @param value value compared against
+ * @return      true if they all pass, false otherwise
+ */
+bool all_pass(int32_t min, int32_t max, Op op, int32_t value) {
+    switch (op) {
+        case EQ:
+            return min == value && max == value;
+        case NE:
+            return value < min || value > max;
+        case LT:
+            return max < value;
+        case LE:
+            return max <= value;
+        case GT:
+            return min > value;
+        case GE:
+            return min >= value;
+    }
+
+    return false;
+}
+
+/**
+ * checks whether no value between min and max passes a comparison
+ *
+ * @param min   smallest value
+ * @param max   largest value
+ * @param op    comparison
+ * @param value value compared against
+ * @return      true if none of them pass, false otherwise
+ */
+bool none_pass(int32_t min, int32_t max, Op op, int32_t value) {
+    switch (op) {
+        case EQ:
+            return value < min || value > max;
+        case NE:
+            return min == value && max == value;
+        case LT:
+            return min >= value;
+        case LE:
+            return min > value;
+        case GT:
+            return max <= value;
+        case GE:
+            return max < value;
+    }
+
+    return false;
+}
+
+/**
+ * counts the values from start to end of a column that pass a comparison
+ *
+ * @param column    column to scan
+ * @param start     index of the first value
+ * @param end       index after the last value
+ * @param op        comparison
+ * @param value     value compared against
+ * @return          number of values that pass
+ */
+uint64_t count_range(const MappedColumn* column, uint64_t start,
+        uint64_t end, Op op, int32_t value) {
+    uint64_t count = 0;
+
+    if (column->width == 1) {
+        switch (op) {
+            case EQ:
+                COUNT_WHERE(uint8_t, ==);
+                break;
+            case NE:
+                COUNT_WHERE(uint8_t, !=);
+                break;
+            case LT:
+                COUNT_WHERE(uint8_t, <);
+                break;
+            case LE:
+                COUNT_WHERE(uint8_t, <=);
+                break;
+            case GT:
+                COUNT_WHERE(uint8_t, >);
+                break;
+            case GE:
+                COUNT_WHERE(uint8_t, >=);
+                break;
+        }
+    } else {
+        switch (op) {
+            case EQ:
+                COUNT_WHERE(int32_t, ==);
+                break;
+            case NE:
+                COUNT_WHERE(int32_t, !=);
+                break;
+            case LT:
+                COUNT_WHERE(int32_t, <);
+                break;
+            case LE:
+                COUNT_WHERE(int32_t, <=);
+                break;
+            case GT:
+                COUNT_WHERE(int32_t, >);
+                break;
+            case GE:
+                COUNT_WHERE(int32_t, >=);
+                break;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * counts the values of a column that pass a comparison, using the block
+ * stats to skip blocks that can't match and count blocks that all match
+ *
+ * @param column    column to scan
+ * @param op        comparison
+ * @param value     value compared against
+ * @return          number of values that pass
+ */
+uint64_t count_where(const MappedColumn* column, Op op, int32_t value) {
+    uint64_t blockValues = (uint64_t)COLUMN_BLOCK_ROWS * column->stride;
+    uint64_t totalValues = column->rows * column->stride;
+    uint64_t count = 0;
+
+    for (uint64_t start = 0; start < totalValues; start += blockValues) {
+        uint64_t end = start + blockValues;
+        if (end > totalValues) {
+            end = totalValues;
+        }
+
+        uint64_t block = start / blockValues;
+        if (block < column->blocks) {
+            BlockStats stats = column->stats[block];
+            if (none_pass(stats.min, stats.max, op, value)) {
+                continue;
+            }
+            if (all_pass(stats.min, stats.max, op, value)) {
+                count += end - start;
+                continue;
+            }
+        }
+
+        count += count_range(column, start, end, op, value);
+    }
+
+    return count;
+}
+
+/**
+ * adds up every value of a column
+ *
+ * @param column    column to add up
+ * @return          the total
+ */
+int64_t sum_column(const MappedColumn* column) {
+    uint64_t totalValues = column->rows * column->stride;
+    int64_t sum = 0;
+
+    if (column->width == 1) {
+        for (uint64_t i = 0; i < totalValues; i++) {
+            sum += column->data[i];
+        }
+    } else {
+        const int32_t* values = (const int32_t*)column->data;
+        for (uint64_t i = 0; i < totalValues; i++) {
+            sum += values[i];
+        }
+    }
+
+    return sum;
+}
+
+/**
+ * prints how many tricks were led in each suit and how often the leader
+ * went on to win them
+ *
+ * @param store         directory of the store
+ * @param playerCount   number of players in the games of the store
+ */
+void lead_suits(const char* store, int playerCount) {
+    const char suits[] = {'S', 'C', 'D', 'H'};
+    MappedColumn lead, winner, cards;
+    uint64_t tricks[NUM_SUITS] = {0};
+    uint64_t wins[NUM_SUITS] = {0};
+
+    map_or_quit(store, TRICK_LEAD, playerCount, &lead);
+    map_or_quit(store, TRICK_WINNER, playerCount, &winner);
+    map_or_quit(store, TRICK_CARDS, playerCount, &cards);
+
+    uint64_t rows = lead.rows;
+    if (winner.rows < rows) {
+        rows = winner.rows;
+    }
+    if (cards.rows < rows) {
+        rows = cards.rows;
+    }
+
+    for (uint64_t i = 0; i < rows; i++) {
+        int suit = cards.data[i * playerCount + lead.data[i]] / NUM_RANKS;
+        tricks[suit]++;
+        wins[suit] += lead.data[i] == winner.data[i];
+    }
+
+    for (int i = 0; i < NUM_SUITS; i++) {
+        printf("Suit=%c tricks=%llu leader won=%llu rate=%.4f\n", suits[i],
+                (unsigned long long)tricks[i], (unsigned long long)wins[i],
+                tricks[i] == 0 ? 0.0 : (double)wins[i] / tricks[i]);
+    }
+
+    column_unmap(&lead);
+    column_unmap(&winner);
+    column_unmap(&cards);
+}
+
+/**
+ * prints per seat averages over every game in the store
+ *
+ * @param store         directory of the store
+ * @param playerCount   number of players in the games of the store
+ */
+void seats(const char* store, int playerCount) {
+    MappedColumn threshold, tricks, dCards, scores;
+
+    map_or_quit(store, GAME_THRESHOLD, playerCount, &threshold);
+    map_or_quit(store, GAME_TRICKS, playerCount, &tricks);
+    map_or_quit(store, GAME_DCARDS, playerCount, &dCards);
+    map_or_quit(store, GAME_SCORES, playerCount, &scores);
+
+    uint64_t games = threshold.rows;
+    if (tricks.rows < games) {
+        games = tricks.rows;
+    }
+    if (dCards.rows < games) {
+        games = dCards.rows;
+    }
+    if (scores.rows < games) {
+        games = scores.rows;
+    }
+
+    for (int seat = 0; seat < playerCount; seat++) {
+        int64_t trickTotal = 0, dTotal = 0, scoreTotal = 0;
+        uint64_t reached = 0;
+        for (uint64_t i = 0; i < games; i++) {
+            uint64_t index = i * playerCount + seat;
+            int32_t d = column_value(&dCards, index);
+            trickTotal += column_value(&tricks, index);
+            dTotal += d;
+            scoreTotal += column_value(&scores, index);
+            reached += d >= column_value(&threshold, i);
+        }
+
+        double count = games == 0 ? 1.0 : (double)games;
+        printf("Seat=%d games=%llu tricks=%.4f dcards=%.4f "
+                "reached threshold=%llu score=%.4f\n", seat,
+                (unsigned long long)games, trickTotal / count,
+                dTotal / count, (unsigned long long)reached,
+                scoreTotal / count);
+    }
+
+    column_unmap(&threshold);
+    column_unmap(&tricks);
+    column_unmap(&dCards);
+    column_unmap(&scores);
+}
+
+/**
+ * main function of ./2310query
+ *
+ * @param argc  number of args
+ * @param argv  values of args
+ * @return      status. 0 if OK
+ */
+int main(int argc, char** argv) {
+    int playerCount;
+
+    if (argc < 3) {
+        usage();
+    }
+
+    if (!read_store_players(argv[1], &playerCount)) {
+        fputs("Store error\n", stderr);
+        return 2;
+    }
+
+    if (strcmp(argv[2], "lead-suits") == 0 && argc == 3) {
+        lead_suits(argv[1], playerCount);
+    } else if (strcmp(argv[2], "seats") == 0 && argc == 3) {
+        seats(argv[1], playerCount);
+    } else if (strcmp(argv[2], "count") == 0 && argc == 6) {
+        int id = column_by_name(argv[3]);
+        if (id == -1) {
+            usage();
+        }
+        Op op = parse_op(argv[4]);
+        MappedColumn column;
+        map_or_quit(argv[1], id, playerCount, &column);
+        printf("%llu\n", (unsigned long long)count_where(&column, op,
+                strtol(argv[5], NULL, 10)));
+        column_unmap(&column);
+    } else if (strcmp(argv[2], "sum") == 0 && argc == 4) {
+        int id = column_by_name(argv[3]);
+        if (id == -1) {
+            usage();
+        }
+        MappedColumn column;
+        map_or_quit(argv[1], id, playerCount, &column);
+        printf("%lld\n", (long long)sum_column(&column));
+        column_unmap(&column);
+    } else {
+        usage();
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+//
+// Created by caleb on 2019-10-13.
+//
+/*
+ * The rules of the game, shared by the hub, players and simulators. Cards
+ * are packed with card_index and hands are 64 bit masks with bit card_index
+ * set for each card held. Everything is inline and nothing allocates, so
+ * the rules cost the same wherever they are used.
+ */
+
+#ifndef ASS3_RULES_H
+#define ASS3_RULES_H
+
+#include "2310shared.h"
+
+#define RULES_SUIT_D 2
+#define RULES_SUIT_BITS ((1ULL << NUM_RANKS) - 1)
+
+#define RULES_SUIT(card) ((card) / NUM_RANKS)
+#define RULES_RANK(card) ((card) % NUM_RANKS)
+
+/*
+ * final score of a player from the tricks and d cards they won. d cards
+ * count against the player unless they won at least threshold of them
+ */
+#define RULES_FINAL_SCORE(threshold, tricks, dCards) \
+        ((dCards) < (threshold) ? (tricks) - (dCards) : (tricks) + (dCards))
+
+// fails to compile if test is false
+#define RULES_SELF_TEST(name, test) \
+        typedef char rules_test_##name[(test) ? 1 : -1]
+
+RULES_SELF_TEST(below_threshold, RULES_FINAL_SCORE(4, 5, 3) == 2);
+RULES_SELF_TEST(at_threshold, RULES_FINAL_SCORE(4, 5, 4) == 9);
+RULES_SELF_TEST(above_threshold, RULES_FINAL_SCORE(4, 0, 6) == 6);
+RULES_SELF_TEST(no_d_cards, RULES_FINAL_SCORE(2, 7, 0) == 7);
+RULES_SELF_TEST(all_d_cards_lost, RULES_FINAL_SCORE(9, 1, 8) == -7);
+RULES_SELF_TEST(d_is_diamonds, RULES_SUIT_D == 2);
+RULES_SELF_TEST(card_suit, RULES_SUIT(3 * NUM_RANKS + 5) == 3);
+RULES_SELF_TEST(card_rank, RULES_RANK(3 * NUM_RANKS + 5) == 5);
+
+/**
+ * calculates a player's score at the end of the game
+ *
+ * @param threshold     number of d cards that must be won for them to be
+ *                      counted as positive
+ * @param tricks        number of tricks the player won
+ * @param dCards        number of d cards in the tricks the player won
+ * @return              final score of the player
+ */
+static inline int rules_final_score(int threshold, int tricks, int dCards) {
+    return RULES_FINAL_SCORE(threshold, tricks, dCards);
+}
+
+/**
+ * checks whether a card beats the best card of a trick so far
+ *
+ * @param card  card played
+ * @param best  best card of the trick so far
+ * @return      true if card is the same suit and higher, false otherwise
+ */
+static inline bool rules_beats(int card, int best) {
+    return RULES_SUIT(card) == RULES_SUIT(best) && card > best;
+}
+
+/**
+ * works out who won a trick
+ *
+ * @param count     number of cards in the trick
+ * @param cards     cards of the trick, starting with the lead
+ * @return          position from the lead of the winning card
+ */
+static inline int rules_winner(int count, const int* cards) {
+    int winner = 0;
+
+    for (int i = 1; i < count; i++) {
+        if (rules_beats(cards[i], cards[winner])) {
+            winner = i;
+        }
+    }
+
+    return winner;
+}
+
+/**
+ * counts the d cards in a trick
+ *
+ * @param count     number of cards in the trick
+ * @param cards     cards of the trick
+ * @return          number of d cards
+ */
+static inline int rules_d_count(int count, const int* cards) {
+    int dCards = 0;
+
+    for (int i = 0; i < count; i++) {
+        dCards += RULES_SUIT(cards[i]) == RULES_SUIT_D;
+    }
+
+    return dCards;
+}
+
+/**
+ * gets the ranks of one suit in a hand
+ *
+ * @param hand  mask of cards
+ * @param suit  suit_index of the suit
+ * @return      mask with bit r set if the hand holds rank r of suit
+ */
+static inline uint32_t rules_suit_mask(uint64_t hand, int suit) {
+    return (hand >> (suit * NUM_RANKS)) & RULES_SUIT_BITS;
+}
+
+/**
+ * counts the d cards in a mask of cards
+ *
+ * @param cards     mask of cards, eg. every card of a trick
+ * @return          number of d cards
+ */
+static inline int rules_d_in(uint64_t cards) {
+    return __builtin_popcount(rules_suit_mask(cards, RULES_SUIT_D));
+}
+
+/**
+ * checks whether a play is legal: the card must be in the hand, and follow
+ * the lead suit if the hand has any of it
+ *
+ * @param hand      mask of cards held
+ * @param card      card played
+ * @param leadSuit  suit_index of the lead card, -1 if leading
+ * @return          true if legal, false otherwise
+ */
+static inline bool rules_legal(uint64_t hand, int card, int leadSuit) {
+    if ((hand & (1ULL << card)) == 0) {
+        return false;
+    }
+
+    return leadSuit == -1 || RULES_SUIT(card) == leadSuit ||
+            rules_suit_mask(hand, leadSuit) == 0;
+}
+
+#endif //ASS3_RULES_H
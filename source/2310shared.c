@@ -4,6 +4,124 @@
 
 #include "2310shared.h"
 
+/**
+ * packs a legal card into a number from 0 to 63. suits are in the order
+ * S, C, D, H and each has NUM_RANKS ranks, 0-9 then a-f
+ *
+ * @param card  card to pack
+ * @return      index of card
+ */
+int card_index(Card card) {
+    int suit = suit_index(card.suit);
+    int rank = isdigit((int)card.rank) ? card.rank - '0'
+            : card.rank - 'a' + 10;
+
+    return suit * NUM_RANKS + rank;
+}
+
+/**
+ * unpacks a card packed by card_index
+ *
+ * @param index index of card, 0 to 63
+ * @return      the card
+ */
+Card index_card(int index) {
+    const char suits[] = {'S', 'C', 'D', 'H'};
+    const char ranks[] = "0123456789abcdef";
+    Card card;
+
+    card.suit = suits[index / NUM_RANKS];
+    card.rank = ranks[index % NUM_RANKS];
+
+    return card;
+}
+
+/**
+ * gets the bit of a legal card in a 64 bit hand mask, see card_index
+ *
+ * @param card  card to get bit of
+ * @return      mask with only the card's bit set
+ */
+uint64_t card_bit(Card card) {
+    return (uint64_t)1 << card_index(card);
+}
+
+/**
+ * gets the position of a suit in the order S, C, D, H
+ *
+ * @param suit  suit to find
+ * @return      index of suit, -1 if not a suit
+ */
+int suit_index(char suit) {
+    const char suits[] = {'S', 'C', 'D', 'H'};
+    for (int i = 0; i < NUM_SUITS; i++) {
+        if (suit == suits[i]) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * fills a deck with every legal card, in card_index order
+ *
+ * @param deck  list of NUM_SUITS * NUM_RANKS cards to fill
+ */
+void full_deck(Card* deck) {
+    for (int i = 0; i < NUM_SUITS * NUM_RANKS; i++) {
+        deck[i] = index_card(i);
+    }
+}
+
+/**
+ * gets the next number from a splitmix64 generator. the same seed always
+ * gives the same numbers, so simulated deals can be repeated
+ *
+ * @param state     state of the generator, updated
+ * @return          next random number
+ */
+uint64_t random_next(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * shuffles a list of cards in place (Fisher-Yates)
+ *
+ * @param cards     list of cards to shuffle
+ * @param count     number of cards
+ * @param state     state of the random generator, updated
+ */
+void shuffle_cards(Card* cards, int count, uint64_t* state) {
+    for (int i = count - 1; i > 0; i--) {
+        int j = random_next(state) % (i + 1);
+        Card swap = cards[i];
+        cards[i] = cards[j];
+        cards[j] = swap;
+    }
+}
+
+/**
+ * FNV-1a hash of some bytes
+ *
+ * @param data      bytes to hash
+ * @param length    number of bytes
+ * @param hash      hash so far, HASH_START to begin
+ * @return          the hash including data
+ */
+uint64_t hash_bytes(const void* data, size_t length, uint64_t hash) {
+    const uint8_t* bytes = data;
+
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * HASH_PRIME;
+    }
+
+    return hash;
+}
+
 /**
  * verfies that a card is legal
  *
@@ -69,6 +187,50 @@ bool valid_deck(Card* deck, int size) {
     return true;
 }
 
+/**
+ * reads a deck file: the number of cards on the first line, then a card
+ * (suit then rank) on each line after
+ *
+ * @param deckName  name of the deck file
+ * @param cards     set to the cards read, which the caller frees
+ * @param count     set to the number of cards
+ * @return          false if the file can't be read or isn't a legal deck
+ */
+bool read_deck(const char* deckName, Card** cards, int* count) {
+    char buffer[DECK_LINE_SIZE];
+    FILE* deckFile = fopen(deckName, "r");
+    if (deckFile == NULL) {
+        return false;
+    }
+
+    int deckSize;
+    fgets(buffer, DECK_LINE_SIZE - 1, deckFile);
+    deckSize = strtol(buffer, NULL, 10);
+    Card* deck = calloc(deckSize, sizeof(Card));
+    for (int i = 0; i < deckSize; i++) {
+        strcpy(buffer, "");
+        if (!fgets(buffer, DECK_LINE_SIZE - 1, deckFile) ||
+                !valid_card(buffer[0], buffer[1])) {
+            free(deck);
+            fclose(deckFile);
+            return false;
+        }
+
+        deck[i].suit = buffer[0];
+        deck[i].rank = buffer[1];
+    }
+    fclose(deckFile);
+
+    if (!valid_deck(deck, deckSize)) {
+        free(deck);
+        return false;
+    }
+
+    *cards = deck;
+    *count = deckSize;
+    return true;
+}
+
 /**
  * verifies if the number of players is legal
  *
@@ -148,4 +310,15 @@ bool valid_position(const char* position, int playerCount) {
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+/**
+ * gets the time in seconds from an arbitrary start
+ *
+ * @return  time in seconds
+ */
+double now_seconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
@@ -10,7 +10,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <ctype.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <signal.h>
@@ -20,11 +22,28 @@ typedef struct {
     char rank;
 } Card;
 
+#define NUM_SUITS 4
+#define NUM_RANKS 16
+#define MAX_PLAYERS (NUM_SUITS * NUM_RANKS)
+#define DECK_LINE_SIZE 255
+#define HASH_START 0xcbf29ce484222325ULL
+#define HASH_PRIME 0x100000001b3ULL
+
+int card_index(Card card);
+Card index_card(int index);
+uint64_t card_bit(Card card);
+int suit_index(char suit);
+void full_deck(Card* deck);
+uint64_t random_next(uint64_t* state);
+void shuffle_cards(Card* cards, int count, uint64_t* state);
+uint64_t hash_bytes(const void* data, size_t length, uint64_t hash);
 bool valid_card(char suit, char rank);
 bool valid_deck(Card* deck, int size);
+bool read_deck(const char* deckName, Card** cards, int* count);
 bool valid_player_count(const char* playerCount);
 bool valid_threshold(const char* threshold);
 bool valid_hand_size(const char* handSize);
 bool valid_position(const char* position, int playerCount);
+double now_seconds(void);
 
 #endif //ASS3_SHARED_H
@@ -0,0 +1,174 @@
+//
+// Created by caleb on 2019-10-09.
+//
+/*
+ * EXIT CONDITION                               MESSAGE
+ * 0    Normal exit
+ * 1    Incorrect arguments                     Usage: 2310sim [--games=n]
+ *                                              [--seed=n] [--cards=n]
+ *                                              [--threshold=n] [--scalar]
+ *                                              [--check] strategy0
+ *                                              strategy1 {strategy}
+ * 2    --check found the engines disagree      Check failed
+ */
+
+#include <time.h>
+
+#include "2310batch.h"
+
+#define CHUNK_GAMES 65536
+
+typedef struct {
+    long games;
+    uint64_t seed;
+    int cards;
+    int threshold;
+    bool scalar;
+    bool check;
+    int playerCount;
+    Strategy seats[MAX_PLAYERS];
+} SimOptions;
+
+/**
+ * prints the usage message and exits
+ */
+void usage(void) {
+    fputs("Usage: 2310sim [--games=n] [--seed=n] [--cards=n] "
+            "[--threshold=n] [--scalar] [--check] strategy0 strategy1 "
+            "{strategy}\n", stderr);
+    exit(1);
+}
+
+/**
+ * reads the command line, exiting on anything illegal
+ *
+ * @param argc      number of args
+ * @param argv      values of args
+ * @param options   options to init
+ */
+void init_sim(int argc, char** argv, SimOptions* options) {
+    options->games = 100000;
+    options->seed = 1;
+    options->cards = NUM_SUITS * NUM_RANKS;
+    options->threshold = 4;
+    options->scalar = false;
+    options->check = false;
+    options->playerCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--games=", 8) == 0) {
+            options->games = strtol(argv[i] + 8, NULL, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            options->seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--cards=", 8) == 0) {
+            options->cards = strtol(argv[i] + 8, NULL, 10);
+        } else if (strncmp(argv[i], "--threshold=", 12) == 0) {
+            if (!valid_threshold(argv[i] + 12)) {
+                usage();
+            }
+            options->threshold = strtol(argv[i] + 12, NULL, 10);
+        } else if (strcmp(argv[i], "--scalar") == 0) {
+            options->scalar = true;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            options->check = true;
+        } else if (options->playerCount == MAX_PLAYERS ||
+                !parse_strategy(argv[i],
+                &options->seats[options->playerCount++])) {
+            usage();
+        }
+    }
+
+    if (options->playerCount < 2 || options->games < 1 ||
+            options->cards < options->playerCount ||
+            options->cards > NUM_SUITS * NUM_RANKS) {
+        usage();
+    }
+}
+
+/**
+ * deals the next count games of the run into a batch
+ *
+ * @param batch     batch to deal into
+ * @param count     number of games to deal
+ * @param seed      state of the random generator, updated
+ */
+void deal_batch(Batch* batch, int count, uint64_t* seed) {
+    Card deck[NUM_SUITS * NUM_RANKS];
+
+    for (int game = 0; game < count; game++) {
+        full_deck(deck);
+        shuffle_cards(deck, NUM_SUITS * NUM_RANKS, seed);
+        batch_deal(batch, game, deck);
+    }
+}
+
+/**
+ * main function of ./2310sim. plays games with random deals and prints
+ * each seat's average score
+ *
+ * @param argc  number of args
+ * @param argv  values of args
+ * @return      status. 0 if OK
+ */
+int main(int argc, char** argv) {
+    SimOptions options;
+    init_sim(argc, argv, &options);
+
+    int numRounds = options.cards / options.playerCount;
+    bool avx2 = !options.scalar && batch_avx2_supported();
+    int64_t totals[MAX_PLAYERS] = {0};
+    int scores[MAX_PLAYERS];
+    uint64_t seed = options.seed;
+    double start = now_seconds();
+
+    for (long done = 0; done < options.games; done += CHUNK_GAMES) {
+        int count = options.games - done < CHUNK_GAMES
+                ? options.games - done : CHUNK_GAMES;
+        Batch* batch = batch_create(count, options.playerCount,
+                options.threshold, numRounds, options.seats);
+        uint64_t chunkSeed = seed;
+        deal_batch(batch, count, &seed);
+
+        if (avx2) {
+            batch_play_avx2(batch);
+        } else {
+            batch_play_scalar(batch);
+        }
+
+        if (options.check) {
+            Batch* reference = batch_create(count, options.playerCount,
+                    options.threshold, numRounds, options.seats);
+            deal_batch(reference, count, &chunkSeed);
+            batch_play_scalar(reference);
+            if (!batch_equal(batch, reference)) {
+                fputs("Check failed\n", stderr);
+                return 2;
+            }
+            batch_free(reference);
+        }
+
+        for (int game = 0; game < count; game++) {
+            batch_scores(batch, game, scores);
+            for (int seat = 0; seat < options.playerCount; seat++) {
+                totals[seat] += scores[seat];
+            }
+        }
+        batch_free(batch);
+    }
+
+    double seconds = now_seconds() - start;
+    const char* names[] = {"alice", "bob"};
+    for (int seat = 0; seat < options.playerCount; seat++) {
+        printf("Seat=%d strategy=%s score=%.4f\n", seat,
+                names[options.seats[seat]],
+                (double)totals[seat] / options.games);
+    }
+    printf("Games=%ld engine=%s seconds=%.3f games/sec=%.0f\n",
+            options.games, avx2 ? "avx2" : "scalar", seconds,
+            options.games / seconds);
+    if (options.check) {
+        printf("Check passed\n");
+    }
+
+    return 0;
+}
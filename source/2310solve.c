@@ -0,0 +1,582 @@
+//
+// Created by caleb on 2019-10-19.
+//
+/*
+ * EXIT CONDITION                               MESSAGE
+ * 0    Normal exit
+ * 1    Incorrect arguments                     Usage: 2310solve [--deals=n]
+ *                                              [--seed=n] [--threads=n]
+ *                                              deck threshold strategy0
+ *                                              strategy1 {strategy}
+ * 2    Problem reading / parsing the deck      Deck error
+ * 3    Less than P cards in the deck           Not enough cards
+ *
+ * Works out how well each seat could have done on a deal with every hand
+ * known, to measure how much a strategy gives away. The other seats are
+ * deterministic, so a seat's best score is a best response to them: the
+ * most it can score by choosing each of its own cards, the others playing
+ * their strategies as they would. Regret is that best score less the
+ * seat's score when it plays its own strategy too.
+ *
+ * The deck is dealt the way 2310hub deals it. With --deals, deal g is the
+ * deck shuffled from seed + g instead, the same deal as game g of a hub
+ * --tournament with that --seed.
+ *
+ * The search is depth first over the seat's choices. Its state is the mask
+ * of cards still to be played, since each hand is its dealt cards that
+ * are still unplayed. Positions at the start of a trick are kept in a
+ * transposition table shared by every thread; the table has no locks, as
+ * each entry is stored with its key xored with its value and a torn entry
+ * just fails to match. Cards of a suit with no unplayed card of another
+ * hand between them are equivalent, so only the highest of them is tried,
+ * and a seat's choices are tried highest first and stop once one reaches
+ * the most the seat could still score. The root is split into a task for
+ * each seat and first card, shared between --threads threads.
+ */
+
+#include <pthread.h>
+#include <time.h>
+#include <limits.h>
+
+#include "2310batch.h"
+
+#define SOLVE_TABLE_BITS 22
+#define SOLVE_MIX 0x9e3779b97f4a7c15ULL
+#define SOLVE_NONE (-1000)
+#define SOLVE_EXACT (1ULL << 32)
+#define NO_CARD (-1)
+
+typedef struct {
+    long deals;
+    uint64_t seed;
+    int threads;
+    const char* deckName;
+    int threshold;
+    int playerCount;
+    Strategy seats[MAX_PLAYERS];
+} SolveOptions;
+
+/*
+ * an entry of the transposition table: check is the key xored with data,
+ * data the best value from the position, with SOLVE_EXACT set unless it is
+ * only an upper bound
+ */
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} TableEntry;
+
+/*
+ * the deal being solved and the tasks of its root. best is the best score
+ * found so far for each seat
+ */
+typedef struct {
+    const SolveOptions* options;
+    int numRounds;
+    uint64_t hands[MAX_PLAYERS];
+    uint64_t dealHash;
+    bool dangerMatters;
+    TableEntry* table;
+    pthread_mutex_t lock;
+    int nextTask;
+    int taskCount;
+    int best[MAX_PLAYERS];
+    long positions;
+} Solver;
+
+/*
+ * the state of a game being searched: cards still to be played, the seat
+ * leading the trick and the d cards each seat has won
+ */
+typedef struct {
+    uint64_t remaining;
+    int lead;
+    int mostD;
+    uint8_t dCards[MAX_PLAYERS];
+} Position;
+
+/*
+ * one thread's search for the best score of seat. forced is the card the
+ * seat must play at its first choice, NO_CARD once it has been played
+ */
+typedef struct {
+    Solver* solver;
+    int seat;
+    int forced;
+    long positions;
+} Search;
+
+/**
+ * prints the usage message and exits
+ */
+void usage(void) {
+    fputs("Usage: 2310solve [--deals=n] [--seed=n] [--threads=n] deck "
+            "threshold strategy0 strategy1 {strategy}\n", stderr);
+    exit(1);
+}
+
+/**
+ * reads the command line, exiting on anything illegal
+ *
+ * @param argc      number of args
+ * @param argv      values of args
+ * @param options   options to init
+ */
+void init_solve(int argc, char** argv, SolveOptions* options) {
+    int named = 0;
+
+    options->deals = 0;
+    options->seed = 1;
+    options->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    options->deckName = NULL;
+    options->playerCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--deals=", 8) == 0) {
+            options->deals = strtol(argv[i] + 8, NULL, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            options->seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            options->threads = strtol(argv[i] + 10, NULL, 10);
+        } else if (named == 0) {
+            options->deckName = argv[i];
+            named++;
+        } else if (named == 1) {
+            if (!valid_threshold(argv[i])) {
+                usage();
+            }
+            options->threshold = strtol(argv[i], NULL, 10);
+            named++;
+        } else if (options->playerCount == MAX_PLAYERS ||
+                !parse_strategy(argv[i],
+                &options->seats[options->playerCount++])) {
+            usage();
+        }
+    }
+
+    if (named < 2 || options->playerCount < 2 || options->deals < 0 ||
+            options->threads < 1) {
+        usage();
+    }
+}
+
+/**
+ * gets the score a seat's d cards add to its tricks at the end of a game
+ *
+ * @param threshold     d card threshold
+ * @param dCards        d cards the seat won
+ * @return              the score of the d cards
+ */
+int d_score(int threshold, int dCards) {
+    return rules_final_score(threshold, 0, dCards);
+}
+
+/**
+ * gets the card a seat's strategy plays
+ *
+ * @param solver    solver of the deal
+ * @param seat      seat to play
+ * @param hand      mask of cards the seat holds
+ * @param leadSuit  suit of the lead card, -1 if the seat is leading
+ * @param danger    the danger flag of bob's rules
+ * @return          card_index of the card played
+ */
+int strategy_card(const Solver* solver, int seat, uint64_t hand,
+        int leadSuit, bool danger) {
+    uint32_t suits[NUM_SUITS];
+
+    for (int suit = 0; suit < NUM_SUITS; suit++) {
+        suits[suit] = rules_suit_mask(hand, suit);
+    }
+    if (solver->options->seats[seat] == STRATEGY_ALICE) {
+        return alice_choose(suits, leadSuit);
+    }
+
+    return bob_choose(suits, leadSuit, danger);
+}
+
+/**
+ * gets the cards worth trying of those a seat may play: the highest of each
+ * run of its cards with no unplayed card of another hand between them
+ *
+ * @param legal     mask of cards the seat may play
+ * @param live      mask of cards still in some hand or in the trick
+ * @return          mask of cards to try
+ */
+uint64_t distinct_cards(uint64_t legal, uint64_t live) {
+    uint64_t cards = 0;
+
+    for (int suit = 0; suit < NUM_SUITS; suit++) {
+        uint32_t own = rules_suit_mask(legal, suit);
+        uint32_t all = rules_suit_mask(live, suit);
+        while (own != 0) {
+            int rank = __builtin_ctz(own);
+            uint32_t above = all & ~((2u << rank) - 1);
+            if (above == 0 || (own & (above & -above)) == 0) {
+                cards |= 1ULL << (suit * NUM_RANKS + rank);
+            }
+            own &= own - 1;
+        }
+    }
+
+    return cards;
+}
+
+/**
+ * gets the transposition table key of a position at the start of a trick.
+ * the other seats' d cards are only part of it while they can still
+ * change whether bob is in danger
+ *
+ * @param search    search of the position
+ * @param position  the position
+ * @return          the key, never 0
+ */
+uint64_t position_key(const Search* search, const Position* position) {
+    const Solver* solver = search->solver;
+    bool danger = position->mostD >= solver->options->threshold - 2;
+    uint32_t state = position->lead | search->seat << 8 |
+            position->dCards[search->seat] << 16 | danger << 24;
+    uint64_t key = hash_bytes(&position->remaining,
+            sizeof(position->remaining), solver->dealHash);
+
+    key = hash_bytes(&state, sizeof(state), key);
+    if (solver->dangerMatters && !danger) {
+        key = hash_bytes(position->dCards, solver->options->playerCount, key);
+    }
+
+    return key == 0 ? 1 : key;
+}
+
+/**
+ * gets the most the searching seat could score from the start of the
+ * trick it is about to play in: every trick left and, if they take it
+ * over the threshold, every d card left
+ *
+ * @param search    search being done
+ * @param position  position of the game
+ * @param dPlayed   number of d cards played so far this trick
+ * @return          the bound
+ */
+int score_bound(const Search* search, const Position* position,
+        int dPlayed) {
+    const Solver* solver = search->solver;
+    int threshold = solver->options->threshold;
+    int tricks = __builtin_popcountll(solver->hands[search->seat] &
+            position->remaining);
+    int dCards = position->dCards[search->seat];
+    int most = dCards + rules_d_in(position->remaining) + dPlayed;
+
+    // d_score falls until the threshold then rises, so the most is at an end
+    return tricks + (d_score(threshold, most) > d_score(threshold, dCards)
+            ? d_score(threshold, most) : d_score(threshold, dCards));
+}
+
+int solve_trick(Search* search, Position* position, int alpha);
+
+/**
+ * plays the rest of a trick, trying each of the searching seat's choices.
+ * a value above alpha is exact, any other is only an upper bound
+ *
+ * @param search    search being done
+ * @param position  position of the game, put back as it was on return
+ * @param trick     cards played so far this trick
+ * @param count     number of cards played so far
+ * @param dPlayed   number of d cards played so far
+ * @param alpha     score the seat already has a way to beat
+ * @return          the most the seat can score from the start of the
+ *                  trick on (tricks plus the score of its final d cards),
+ *                  SOLVE_NONE if the forced card can't be played
+ */
+int solve_play(Search* search, Position* position, int* trick, int count,
+        int dPlayed, int alpha) {
+    const Solver* solver = search->solver;
+    int playerCount = solver->options->playerCount;
+    int threshold = solver->options->threshold;
+
+    if (count == playerCount) {
+        int winner = (position->lead + rules_winner(count, trick)) %
+                playerCount;
+        int won = winner == search->seat;
+        int lead = position->lead;
+        int mostD = position->mostD;
+        position->dCards[winner] += dPlayed;
+        if (position->dCards[winner] > position->mostD) {
+            position->mostD = position->dCards[winner];
+        }
+        position->lead = winner;
+        int value = won + solve_trick(search, position, alpha - won);
+        position->lead = lead;
+        position->mostD = mostD;
+        position->dCards[winner] -= dPlayed;
+        return value;
+    }
+
+    int seat = (position->lead + count) % playerCount;
+    uint64_t hand = solver->hands[seat] & position->remaining;
+    int leadSuit = count == 0 ? -1 : RULES_SUIT(trick[0]);
+    uint64_t choices;
+    int bound = INT_MAX;
+    if (seat != search->seat) {
+        choices = 1ULL << strategy_card(solver, seat, hand, leadSuit,
+                dPlayed > 0 && position->mostD >= threshold - 2);
+    } else {
+        uint64_t legal = hand;
+        if (leadSuit != -1 && rules_suit_mask(hand, leadSuit) != 0) {
+            legal &= RULES_SUIT_BITS << (leadSuit * NUM_RANKS);
+        }
+        uint64_t live = position->remaining;
+        for (int i = 0; i < count; i++) {
+            live |= 1ULL << trick[i];
+        }
+        choices = distinct_cards(legal, live);
+        if (search->forced != NO_CARD) {
+            choices &= 1ULL << search->forced;
+            search->forced = NO_CARD;
+        }
+        bound = score_bound(search, position, dPlayed);
+        if (bound <= alpha) {
+            return bound;
+        }
+    }
+
+    int best = SOLVE_NONE;
+    while (choices != 0 && best < bound) {
+        int card = 63 - __builtin_clzll(choices);
+        choices &= ~(1ULL << card);
+        position->remaining &= ~(1ULL << card);
+        trick[count] = card;
+        int value = solve_play(search, position, trick, count + 1,
+                dPlayed + (RULES_SUIT(card) == RULES_SUIT_D),
+                best > alpha ? best : alpha);
+        position->remaining |= 1ULL << card;
+        if (value > best) {
+            best = value;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * finds the most the searching seat can score from the start of a trick,
+ * using the transposition table. a value above alpha is exact, any other
+ * is only an upper bound
+ *
+ * @param search    search being done
+ * @param position  position of the game, put back as it was on return
+ * @param alpha     score the seat already has a way to beat
+ * @return          the most the seat can score from here on (tricks plus
+ *                  the score of its final d cards), SOLVE_NONE if the
+ *                  forced card can't be played
+ */
+int solve_trick(Search* search, Position* position, int alpha) {
+    const Solver* solver = search->solver;
+    int trick[MAX_PLAYERS];
+
+    if ((solver->hands[search->seat] & position->remaining) == 0) {
+        return d_score(solver->options->threshold,
+                position->dCards[search->seat]);
+    }
+
+    search->positions++;
+    bool forced = search->forced != NO_CARD;
+    uint64_t key = position_key(search, position);
+    TableEntry* entry = &solver->table[key * SOLVE_MIX >>
+            (64 - SOLVE_TABLE_BITS)];
+    uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    if (!forced && (__atomic_load_n(&entry->check, __ATOMIC_RELAXED) ^
+            data) == key && ((data & SOLVE_EXACT) != 0 ||
+            (int32_t)data <= alpha)) {
+        return (int32_t)data;
+    }
+
+    int value = solve_play(search, position, trick, 0, 0, alpha);
+    if (!forced) {
+        data = (uint32_t)value | (value > alpha ? SOLVE_EXACT : 0);
+        __atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+    }
+
+    return value;
+}
+
+/**
+ * takes tasks of the root until there are none left. task t is seat
+ * t / numRounds playing the (t % numRounds)'th card of its hand first
+ *
+ * @param arg   the solver
+ * @return      NULL
+ */
+void* work(void* arg) {
+    Solver* solver = arg;
+    Position position;
+    Search search;
+
+    search.solver = solver;
+    search.positions = 0;
+    while (true) {
+        pthread_mutex_lock(&solver->lock);
+        int task = solver->nextTask++;
+        pthread_mutex_unlock(&solver->lock);
+        if (task >= solver->taskCount) {
+            break;
+        }
+
+        search.seat = task / solver->numRounds;
+        uint64_t hand = solver->hands[search.seat];
+        for (int i = 0; i < task % solver->numRounds; i++) {
+            hand &= hand - 1;
+        }
+        search.forced = __builtin_ctzll(hand);
+
+        memset(&position, 0, sizeof(Position));
+        for (int seat = 0; seat < solver->options->playerCount; seat++) {
+            position.remaining |= solver->hands[seat];
+        }
+        pthread_mutex_lock(&solver->lock);
+        int alpha = solver->best[search.seat];
+        pthread_mutex_unlock(&solver->lock);
+        int value = solve_trick(&search, &position, alpha);
+
+        pthread_mutex_lock(&solver->lock);
+        if (value > solver->best[search.seat]) {
+            solver->best[search.seat] = value;
+        }
+        pthread_mutex_unlock(&solver->lock);
+    }
+
+    pthread_mutex_lock(&solver->lock);
+    solver->positions += search.positions;
+    pthread_mutex_unlock(&solver->lock);
+    return NULL;
+}
+
+/**
+ * finds the best score of every seat on a deal
+ *
+ * @param solver    solver with the options and table
+ * @param deck      dealt deck
+ * @param best      best score of each seat to fill in
+ */
+void solve_deal(Solver* solver, const Card* deck, int* best) {
+    int playerCount = solver->options->playerCount;
+    int threads = solver->options->threads;
+
+    for (int seat = 0; seat < playerCount; seat++) {
+        solver->hands[seat] = 0;
+        for (int i = 0; i < solver->numRounds; i++) {
+            solver->hands[seat] |=
+                    card_bit(deck[seat * solver->numRounds + i]);
+        }
+        solver->best[seat] = SOLVE_NONE;
+    }
+    // entries of earlier deals are left in the table, keyed apart
+    solver->dealHash = hash_bytes(solver->hands,
+            playerCount * sizeof(uint64_t), HASH_START);
+    solver->nextTask = 0;
+    solver->taskCount = playerCount * solver->numRounds;
+
+    pthread_t* workers = calloc(threads, sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, work, solver);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    for (int seat = 0; seat < playerCount; seat++) {
+        best[seat] = solver->best[seat];
+    }
+}
+
+/**
+ * plays a deal with every seat following its strategy
+ *
+ * @param options   options of the run
+ * @param numRounds number of rounds
+ * @param deck      dealt deck
+ * @param scores    score of each seat to fill in
+ */
+void play_deal(const SolveOptions* options, int numRounds, const Card* deck,
+        int* scores) {
+    Batch* batch = batch_create(1, options->playerCount, options->threshold,
+            numRounds, options->seats);
+
+    batch_deal(batch, 0, deck);
+    batch_play_scalar(batch);
+    batch_scores(batch, 0, scores);
+    batch_free(batch);
+}
+
+/**
+ * main function of ./2310solve. prints each seat's score, best score and
+ * regret on each deal, then their averages
+ *
+ * @param argc  number of args
+ * @param argv  values of args
+ * @return      status. 0 if OK
+ */
+int main(int argc, char** argv) {
+    SolveOptions options;
+    Solver solver;
+    Card* cards;
+    int count;
+
+    init_solve(argc, argv, &options);
+    if (!read_deck(options.deckName, &cards, &count)) {
+        fputs("Deck error\n", stderr);
+        return 2;
+    }
+    if (count < options.playerCount) {
+        fputs("Not enough cards\n", stderr);
+        return 3;
+    }
+
+    memset(&solver, 0, sizeof(Solver));
+    solver.options = &options;
+    solver.numRounds = count / options.playerCount;
+    solver.table = calloc(1 << SOLVE_TABLE_BITS, sizeof(TableEntry));
+    pthread_mutex_init(&solver.lock, NULL);
+    for (int seat = 0; seat < options.playerCount; seat++) {
+        solver.dangerMatters |= options.seats[seat] == STRATEGY_BOB;
+    }
+
+    const char* names[] = {"alice", "bob"};
+    long deals = options.deals == 0 ? 1 : options.deals;
+    int64_t totals[MAX_PLAYERS] = {0}, bestTotals[MAX_PLAYERS] = {0};
+    int scores[MAX_PLAYERS], best[MAX_PLAYERS];
+    Card* deck = malloc(count * sizeof(Card));
+    double start = now_seconds();
+
+    for (long deal = 0; deal < deals; deal++) {
+        memcpy(deck, cards, count * sizeof(Card));
+        if (options.deals > 0) {
+            uint64_t seed = options.seed + deal;
+            shuffle_cards(deck, count, &seed);
+        }
+        play_deal(&options, solver.numRounds, deck, scores);
+        solve_deal(&solver, deck, best);
+
+        for (int seat = 0; seat < options.playerCount; seat++) {
+            printf("Deal=%ld seat=%d strategy=%s score=%d best=%d "
+                    "regret=%d\n", deal, seat, names[options.seats[seat]],
+                    scores[seat], best[seat], best[seat] - scores[seat]);
+            totals[seat] += scores[seat];
+            bestTotals[seat] += best[seat];
+        }
+    }
+
+    double seconds = now_seconds() - start;
+    for (int seat = 0; seat < options.playerCount; seat++) {
+        printf("Seat=%d strategy=%s score=%.4f best=%.4f regret=%.4f\n",
+                seat, names[options.seats[seat]],
+                (double)totals[seat] / deals,
+                (double)bestTotals[seat] / deals,
+                (double)(bestTotals[seat] - totals[seat]) / deals);
+    }
+    printf("Deals=%ld threads=%d positions=%ld seconds=%.3f\n", deals,
+            options.threads, solver.positions, seconds);
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+//
+// Created by caleb on 2019-10-04.
+//
+/*
+ * Live trick events for spectators.
+ *
+ * The hub publishes every trick into a ring in POSIX shared memory. It never
+ * waits for readers: each slot is a seqlock, so a reader that is too slow
+ * sees the slot's sequence move past the event it wanted, skips ahead to
+ * the oldest event still in the ring and carries on from there. The hub
+ * removes the ring's name when its game ends, however it ends.
+ */
+
+#include "2310spectate.h"
+
+static SpectateRing* published;
+static const char* publishedName;
+static pid_t owner;
+
+/**
+ * creates (or takes over) the shared memory ring for a game
+ *
+ * @param name  shm_open name of the ring, eg. /2310game, which must last
+ *              until spectate_finish
+ * @return      the mapped ring, NULL on failure
+ */
+SpectateRing* spectate_create(const char* name) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(SpectateRing)) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    SpectateRing* ring = mmap(NULL, sizeof(SpectateRing),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        return NULL;
+    }
+
+    // invalidate everything first so readers of an old game skip ahead
+    atomic_store(&ring->head, 0);
+    for (int i = 0; i < SPECTATE_SLOTS; i++) {
+        atomic_store(&ring->events[i].sequence, 0);
+    }
+    atomic_store(&ring->finished, false);
+    ring->writerPid = getpid();
+    ring->magic = SPECTATE_MAGIC;
+    published = ring;
+    publishedName = name;
+    owner = getpid();
+
+    return ring;
+}
+
+/**
+ * maps an existing ring read only
+ *
+ * @param name  shm_open name of the ring
+ * @return      the mapped ring, NULL on failure
+ */
+SpectateRing* spectate_attach(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    SpectateRing* ring = mmap(NULL, sizeof(SpectateRing), PROT_READ,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (ring->magic != SPECTATE_MAGIC) {
+        munmap(ring, sizeof(SpectateRing));
+        return NULL;
+    }
+
+    return ring;
+}
+
+/**
+ * publishes a finished trick. only the hub may call this
+ *
+ * @param ring          ring to publish to
+ * @param playerCount   number of players in the game
+ * @param round         number of the round, from 0
+ * @param leadPlayer    player that led the trick
+ * @param winner        player that won the trick
+ * @param dCount        number of d cards in the trick
+ * @param cardsPlayed   cards played in the trick, starting with the lead
+ * @param scores        final score of each player as things stand
+ */
+void spectate_publish(SpectateRing* ring, int playerCount, int round,
+        int leadPlayer, int winner, int dCount, Card* cardsPlayed,
+        int* scores) {
+    uint64_t number = atomic_load_explicit(&ring->head,
+            memory_order_relaxed);
+    SpectateEvent* event = &ring->events[number % SPECTATE_SLOTS];
+
+    atomic_store_explicit(&event->sequence, 2 * number + 1,
+            memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    event->event = number;
+    event->playerCount = playerCount;
+    event->round = round;
+    event->lead = leadPlayer;
+    event->winner = winner;
+    event->dCards = dCount;
+    for (int i = 0; i < playerCount; i++) {
+        event->cards[(leadPlayer + i) % playerCount] =
+                card_index(cardsPlayed[i]);
+        event->scores[i] = scores[i];
+    }
+
+    atomic_store_explicit(&event->sequence, 2 * number + 2,
+            memory_order_release);
+    atomic_store_explicit(&ring->head, number + 1, memory_order_release);
+}
+
+/**
+ * marks the game being published as over, so spectators stop once they
+ * have caught up, and removes the ring's name. spectators already attached
+ * keep their mapping. does nothing if there is no ring, or in a child
+ * process of the hub
+ */
+void spectate_finish(void) {
+    if (published == NULL || getpid() != owner) {
+        return;
+    }
+
+    atomic_store_explicit(&published->finished, true, memory_order_release);
+    shm_unlink(publishedName);
+    published = NULL;
+}
+
+/**
+ * gets the oldest event a reader can still hope to read
+ *
+ * @param ring  ring being read
+ * @return      number of the event
+ */
+static uint64_t oldest_event(SpectateRing* ring) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    return head >= SPECTATE_SLOTS ? head - SPECTATE_SLOTS + 1 : 0;
+}
+
+/**
+ * reads the next event without ever blocking the hub
+ *
+ * @param ring  ring to read from
+ * @param next  number of the event wanted. moved on past the event read,
+ *              or to the oldest event still in the ring after an overrun
+ * @param event event to copy into
+ * @return      SPECTATE_OK if read, SPECTATE_EMPTY if there is nothing new,
+ *              SPECTATE_OVERRUN if events were lost
+ */
+SpectateResult spectate_read(SpectateRing* ring, uint64_t* next,
+        SpectateEvent* event) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head < *next) {
+        // a new game has taken over the ring
+        *next = 0;
+        return SPECTATE_OVERRUN;
+    }
+
+    if (head == *next) {
+        return SPECTATE_EMPTY;
+    }
+
+    if (head - *next > SPECTATE_SLOTS) {
+        *next = head - SPECTATE_SLOTS;
+        return SPECTATE_OVERRUN;
+    }
+
+    SpectateEvent* slot = &ring->events[*next % SPECTATE_SLOTS];
+    uint64_t before = atomic_load_explicit(&slot->sequence,
+            memory_order_acquire);
+    if (before != 2 * *next + 2) {
+        // overwritten, or being overwritten, by a later event
+        *next = oldest_event(ring);
+        return SPECTATE_OVERRUN;
+    }
+
+    event->event = slot->event;
+    event->playerCount = slot->playerCount;
+    event->round = slot->round;
+    event->lead = slot->lead;
+    event->winner = slot->winner;
+    event->dCards = slot->dCards;
+    memcpy(event->cards, slot->cards, sizeof(event->cards));
+    memcpy(event->scores, slot->scores, sizeof(event->scores));
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) !=
+            before) {
+        *next = oldest_event(ring);
+        return SPECTATE_OVERRUN;
+    }
+
+    (*next)++;
+    return SPECTATE_OK;
+}
@@ -0,0 +1,63 @@
+//
+// Created by caleb on 2019-10-04.
+//
+
+#ifndef ASS3_SPECTATE_H
+#define ASS3_SPECTATE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "2310shared.h"
+
+#define SPECTATE_MAGIC 0x32333130
+#define SPECTATE_SLOTS 256
+
+/*
+ * one finished trick. cards are card_index values in seat order and scores
+ * are what each seat would finish on if the game ended after this trick
+ */
+typedef struct {
+    atomic_uint_fast64_t sequence;
+    uint64_t event;
+    uint8_t playerCount;
+    uint8_t round;
+    uint8_t lead;
+    uint8_t winner;
+    uint8_t dCards;
+    uint8_t cards[MAX_PLAYERS];
+    int16_t scores[MAX_PLAYERS];
+} SpectateEvent;
+
+/*
+ * written by one hub, read by any number of spectators. event n lives in
+ * slot n % SPECTATE_SLOTS, whose sequence is odd while the hub is writing
+ * it and 2n + 2 once it is complete
+ */
+typedef struct {
+    uint32_t magic;
+    int32_t writerPid;
+    atomic_uint_fast64_t head;
+    atomic_bool finished;
+    SpectateEvent events[SPECTATE_SLOTS];
+} SpectateRing;
+
+typedef enum {
+    SPECTATE_OK = 0,
+    SPECTATE_EMPTY = 1,
+    SPECTATE_OVERRUN = 2
+} SpectateResult;
+
+SpectateRing* spectate_create(const char* name);
+SpectateRing* spectate_attach(const char* name);
+void spectate_publish(SpectateRing* ring, int playerCount, int round,
+        int leadPlayer, int winner, int dCount, Card* cardsPlayed,
+        int* scores);
+void spectate_finish(void);
+SpectateResult spectate_read(SpectateRing* ring, uint64_t* next,
+        SpectateEvent* event);
+
+#endif //ASS3_SPECTATE_H
@@ -0,0 +1,113 @@
+//
+// Created by caleb on 2019-10-04.
+//
+/*
+ * EXIT CONDITION                               MESSAGE
+ * 0    Game finished
+ * 1    Incorrect number of arguments           Usage: 2310spectator name
+ * 2    No game is publishing to name           No such game
+ * 3    The hub died before the game finished   Hub gone
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include "2310spectate.h"
+
+#define POLL_NANOSECONDS 1000000
+
+/**
+ * prints a trick event to stdout
+ *
+ * @param event event to print
+ */
+void print_event(SpectateEvent* event) {
+    const char suits[] = {'S', 'C', 'D', 'H'};
+    const char ranks[] = "0123456789abcdef";
+
+    printf("Round=%d lead=%d winner=%d d=%d Cards=", event->round,
+            event->lead, event->winner, event->dCards);
+    for (int i = 0; i < event->playerCount; i++) {
+        printf("%c.%c ", suits[event->cards[i] / NUM_RANKS],
+                ranks[event->cards[i] % NUM_RANKS]);
+    }
+    printf("Scores=");
+    for (int i = 0; i < event->playerCount; i++) {
+        printf(i == 0 ? "%d:%d" : " %d:%d", i, event->scores[i]);
+    }
+    printf("\n");
+}
+
+/**
+ * checks whether the hub publishing to a ring is still running
+ *
+ * @param ring  ring being followed
+ * @return      false only if the hub no longer exists
+ */
+bool hub_alive(SpectateRing* ring) {
+    return kill(ring->writerPid, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * main function of ./2310spectator. follows a game published by
+ * 2310hub --spectate=name until it finishes, or the hub dies
+ *
+ * @param argc  number of args
+ * @param argv  values of args
+ * @return      status. 0 if OK
+ */
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fputs("Usage: 2310spectator name\n", stderr);
+        return 1;
+    }
+
+    SpectateRing* ring = spectate_attach(argv[1]);
+    if (ring == NULL) {
+        fputs("No such game\n", stderr);
+        return 2;
+    }
+
+    struct timespec poll = {0, POLL_NANOSECONDS};
+    SpectateEvent event;
+    uint64_t next = 0;
+    bool waiting = false;
+    while (true) {
+        uint64_t wanted = next;
+        bool finished = atomic_load(&ring->finished);
+        // checked before reading, so nothing the hub published is missed
+        bool gone = waiting && !finished && !hub_alive(ring);
+
+        switch (spectate_read(ring, &next, &event)) {
+            case SPECTATE_OK:
+                waiting = false;
+                print_event(&event);
+                break;
+            case SPECTATE_OVERRUN:
+                waiting = false;
+                if (next < wanted) {
+                    printf("New game\n");
+                } else {
+                    printf("Missed %llu events\n",
+                            (unsigned long long)(next - wanted));
+                }
+                break;
+            case SPECTATE_EMPTY:
+                if (finished) {
+                    return 0;
+                }
+                if (gone) {
+                    // the hub had no chance to remove its ring
+                    shm_unlink(argv[1]);
+                    fflush(stdout);
+                    fputs("Hub gone\n", stderr);
+                    return 3;
+                }
+                waiting = true;
+                fflush(stdout);
+                nanosleep(&poll, NULL);
+                break;
+        }
+    }
+}
@@ -0,0 +1,175 @@
+//
+// Created by caleb on 2019-10-16.
+//
+/*
+ * EXIT CONDITION                               MESSAGE
+ * 0    Hub exited
+ * 1    Incorrect arguments                     Usage: 2310stats name
+ *                                              [--interval=ms]
+ * 2    No hub is publishing to name            No such hub
+ * 3    Hub was killed before it could exit     Hub gone
+ *      (the counters are removed)
+ */
+
+#include <errno.h>
+#include <time.h>
+
+#include "2310telemetry.h"
+
+#define DEFAULT_INTERVAL_MS 1000
+
+/*
+ * the counters at one moment, to take rates from
+ */
+typedef struct {
+    double time;
+    uint64_t gamesStarted;
+    uint64_t gamesFinished;
+    uint64_t tricks;
+    uint64_t messagesOut;
+    uint64_t bytesOut;
+    uint64_t messagesIn;
+    uint64_t bytesIn;
+} Sample;
+
+/**
+ * reads the counters
+ *
+ * @param counters  counters to read
+ * @param sample    sample to fill
+ */
+void take_sample(Telemetry* counters, Sample* sample) {
+    sample->time = now_seconds();
+    sample->gamesStarted = atomic_load_explicit(&counters->gamesStarted,
+            memory_order_relaxed);
+    sample->gamesFinished = atomic_load_explicit(&counters->gamesFinished,
+            memory_order_relaxed);
+    sample->tricks = atomic_load_explicit(&counters->tricks,
+            memory_order_relaxed);
+    sample->messagesOut = atomic_load_explicit(&counters->messagesOut,
+            memory_order_relaxed);
+    sample->bytesOut = atomic_load_explicit(&counters->bytesOut,
+            memory_order_relaxed);
+    sample->messagesIn = atomic_load_explicit(&counters->messagesIn,
+            memory_order_relaxed);
+    sample->bytesIn = atomic_load_explicit(&counters->bytesIn,
+            memory_order_relaxed);
+}
+
+/**
+ * prints the totals and the rates since the last sample
+ *
+ * @param counters  counters being followed
+ * @param last      previous sample
+ * @param sample    this sample
+ */
+void print_rates(Telemetry* counters, Sample* last, Sample* sample) {
+    double seconds = sample->time - last->time;
+    uint64_t queued = 0;
+    uint64_t deepest = 0;
+
+    for (int i = 0; i < counters->playerCount && i < MAX_PLAYERS; i++) {
+        uint64_t depth = atomic_load_explicit(&counters->queued[i],
+                memory_order_relaxed);
+        queued += depth;
+        deepest = depth > deepest ? depth : deepest;
+    }
+
+    printf("Started=%llu finished=%llu active=%llu games/sec=%.1f "
+            "tricks/sec=%.1f outMessages/sec=%.1f outBytes/sec=%.0f "
+            "inMessages/sec=%.1f inBytes/sec=%.0f queued=%llu "
+            "deepest=%llu\n",
+            (unsigned long long)sample->gamesStarted,
+            (unsigned long long)sample->gamesFinished,
+            (unsigned long long)(sample->gamesStarted -
+            sample->gamesFinished),
+            (sample->gamesFinished - last->gamesFinished) / seconds,
+            (sample->tricks - last->tricks) / seconds,
+            (sample->messagesOut - last->messagesOut) / seconds,
+            (sample->bytesOut - last->bytesOut) / seconds,
+            (sample->messagesIn - last->messagesIn) / seconds,
+            (sample->bytesIn - last->bytesIn) / seconds,
+            (unsigned long long)queued, (unsigned long long)deepest);
+    fflush(stdout);
+}
+
+/**
+ * prints the hub's exit status and every error a seat caused
+ *
+ * @param counters  counters being followed
+ * @param status    exit status of the hub
+ */
+void print_exit(Telemetry* counters, int status) {
+    printf("Exited status=%d\n", status);
+    for (int i = 0; i < counters->playerCount && i < MAX_PLAYERS; i++) {
+        for (int j = 0; j < TELEMETRY_STATUSES; j++) {
+            uint64_t count = atomic_load_explicit(&counters->errors[i][j],
+                    memory_order_relaxed);
+            if (count > 0) {
+                printf("Error seat=%d status=%d count=%llu\n", i, j,
+                        (unsigned long long)count);
+            }
+        }
+    }
+}
+
+/**
+ * checks whether the hub is still running
+ *
+ * @param counters  counters of the hub
+ * @return          false if its process is gone
+ */
+bool hub_alive(Telemetry* counters) {
+    return kill(counters->writerPid, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * main function of ./2310stats. prints the rates of a hub run with
+ * --telemetry=name every interval until it exits, or is killed
+ *
+ * @param argc  number of args
+ * @param argv  values of args
+ * @return      status. 0 if OK
+ */
+int main(int argc, char** argv) {
+    long interval = DEFAULT_INTERVAL_MS;
+
+    if (argc == 3) {
+        interval = strncmp(argv[2], "--interval=", 11) == 0
+                ? strtol(argv[2] + 11, NULL, 10) : 0;
+    }
+    if ((argc != 2 && argc != 3) || interval <= 0) {
+        fputs("Usage: 2310stats name [--interval=ms]\n", stderr);
+        return 1;
+    }
+
+    Telemetry* counters = telemetry_attach(argv[1]);
+    if (counters == NULL) {
+        fputs("No such hub\n", stderr);
+        return 2;
+    }
+
+    struct timespec wait = {interval / 1000, interval % 1000 * 1000000};
+    Sample last, sample;
+    take_sample(counters, &last);
+    while (true) {
+        nanosleep(&wait, NULL);
+        // checked first, so a hub that exits in between has its status
+        bool alive = hub_alive(counters);
+        int status = atomic_load_explicit(&counters->status,
+                memory_order_acquire);
+        take_sample(counters, &sample);
+        print_rates(counters, &last, &sample);
+        if (status != -1) {
+            print_exit(counters, status);
+            return 0;
+        }
+        if (!alive) {
+            // the hub had no chance to remove its counters
+            shm_unlink(argv[1]);
+            fputs("Hub gone\n", stderr);
+            return 3;
+        }
+        last = sample;
+    }
+}
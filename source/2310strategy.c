@@ -0,0 +1,314 @@
+//
+// Created by caleb on 2019-10-11.
+//
+/*
+ * Table driven strategies.
+ *
+ * A strategy is written as rules, one per line:
+ *
+ *      [danger] lead|follow|void [suit ...] highest|lowest
+ *
+ * lead     we are leading the trick
+ * follow   we have a card in the lead suit, so must play one of them
+ * void     we have no card in the lead suit
+ * danger   the rule replaces the plain one when some player has won at
+ *          least threshold - 2 d cards and a d card has been played this
+ *          trick. without a danger rule the plain one is used
+ *
+ * lead and void rules give the suits (S, C, D or H) to check in order, and
+ * the card is taken from the first one we have. suits left out are checked
+ * after them in the order S, C, D, H. a # starts a comment. every strategy
+ * needs a plain lead, follow and void rule.
+ *
+ * Compiling a strategy works out its decision for every lead suit, danger
+ * and set of suits held, so choosing a card is a table lookup and a bit
+ * scan however the rules are written.
+ */
+
+#include "2310strategy.h"
+
+typedef struct {
+    const char* name;
+    const char* spec;
+} BuiltinStrategy;
+
+static const BuiltinStrategy builtins[] = {
+        {"alice",
+                "lead S C D H highest\n"
+                "follow lowest\n"
+                "void D H S C highest\n"},
+        {"bob",
+                "lead D H S C lowest\n"
+                "danger follow highest\n"
+                "danger void S C H D lowest\n"
+                "follow lowest\n"
+                "void S C D H highest\n"}};
+
+/**
+ * gets the spec of a strategy built into every player
+ *
+ * @param name  name of the strategy, eg. alice
+ * @return      the spec, NULL if there is no such strategy
+ */
+const char* strategy_builtin(const char* name) {
+    for (int i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if (strcmp(builtins[i].name, name) == 0) {
+            return builtins[i].spec;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * gets the spec of a strategy, either built in or read from a file
+ *
+ * @param name  name of a built in strategy or path of a spec file
+ * @return      malloced copy of the spec, NULL if it can't be found
+ */
+char* strategy_load(const char* name) {
+    const char* builtin = strategy_builtin(name);
+    if (builtin != NULL) {
+        return strdup(builtin);
+    }
+
+    FILE* file = fopen(name, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    char* spec = calloc(STRATEGY_FILE_SIZE + 1, sizeof(char));
+    size_t length = fread(spec, sizeof(char), STRATEGY_FILE_SIZE + 1, file);
+    fclose(file);
+    if (length > STRATEGY_FILE_SIZE) {
+        free(spec);
+        return NULL;
+    }
+    spec[length] = 0;
+
+    return spec;
+}
+
+/**
+ * parses a single rule
+ *
+ * @param line  text of the rule, modified
+ * @param rules rules to put the rule into, [danger][RuleType]
+ * @return      true if legal, false otherwise
+ */
+static bool parse_rule(char* line, Rule rules[2][NUM_RULE_TYPES]) {
+    const char* types[] = {"lead", "follow", "void"};
+    char* save;
+    char* word = strtok_r(line, " \t", &save);
+    bool danger = false;
+
+    if (word != NULL && strcmp(word, "danger") == 0) {
+        danger = true;
+        word = strtok_r(NULL, " \t", &save);
+    }
+    if (word == NULL) {
+        return false;
+    }
+
+    Rule* rule = NULL;
+    RuleType type = RULE_LEAD;
+    for (int i = 0; i < NUM_RULE_TYPES; i++) {
+        if (strcmp(word, types[i]) == 0) {
+            type = i;
+            rule = &rules[danger][i];
+        }
+    }
+    if (rule == NULL || rule->present) {
+        return false;
+    }
+
+    rule->present = true;
+    rule->count = 0;
+    while ((word = strtok_r(NULL, " \t", &save)) != NULL) {
+        int suit = strlen(word) == 1 ? suit_index(word[0]) : -1;
+        if (suit != -1 && type != RULE_FOLLOW &&
+                rule->count < NUM_SUITS) {
+            for (int i = 0; i < rule->count; i++) {
+                if (rule->order[i] == suit) {
+                    return false;
+                }
+            }
+            rule->order[rule->count++] = suit;
+        } else if (strcmp(word, "highest") == 0 ||
+                strcmp(word, "lowest") == 0) {
+            rule->highest = word[0] == 'h';
+            return strtok_r(NULL, " \t", &save) == NULL;
+        } else {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * parses a strategy spec into its rules
+ *
+ * @param spec  text of the strategy
+ * @param rules rules to init, [danger][RuleType]. danger rules that aren't
+ *              given are copied from the plain ones, but not marked present
+ * @return      true if legal, false otherwise
+ */
+bool strategy_parse(const char* spec, Rule rules[2][NUM_RULE_TYPES]) {
+    char* text = strdup(spec);
+    char* save;
+    bool legal = true;
+
+    memset(rules, 0, 2 * NUM_RULE_TYPES * sizeof(Rule));
+    for (char* line = strtok_r(text, "\n", &save); line != NULL && legal;
+            line = strtok_r(NULL, "\n", &save)) {
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = 0;
+        }
+        if (strspn(line, " \t\r") != strlen(line)) {
+            line[strcspn(line, "\r")] = 0;
+            legal = parse_rule(line, rules);
+        }
+    }
+    free(text);
+
+    for (int i = 0; i < NUM_RULE_TYPES && legal; i++) {
+        legal = rules[0][i].present;
+        if (!rules[1][i].present) {
+            rules[1][i] = rules[0][i];
+            rules[1][i].present = false;
+        }
+    }
+
+    return legal;
+}
+
+/**
+ * works out the decision of a rule for a set of suits held
+ *
+ * @param rule      rule to follow
+ * @param held      bit s set if suit s is held
+ * @param leadSuit  suit of the lead card, for follow rules
+ * @param type      which kind of rule it is
+ * @return          the decision
+ */
+static uint8_t decide(const Rule* rule, int held, int leadSuit,
+        RuleType type) {
+    uint8_t extra = DECISION_VALID | (rule->highest ? DECISION_HIGHEST : 0);
+
+    if (held == 0) {
+        return 0;
+    }
+    if (type == RULE_FOLLOW) {
+        return extra | leadSuit;
+    }
+    for (int i = 0; i < rule->count; i++) {
+        if (held & (1 << rule->order[i])) {
+            return extra | rule->order[i];
+        }
+    }
+    for (int suit = 0; suit < NUM_SUITS; suit++) {
+        if (held & (1 << suit)) {
+            return extra | suit;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * builds the decision table of parsed rules
+ *
+ * @param rules rules of the strategy, [danger][RuleType]
+ * @param table table to fill
+ */
+void strategy_build(Rule rules[2][NUM_RULE_TYPES], StrategyTable* table) {
+    for (int danger = 0; danger < 2; danger++) {
+        for (int held = 0; held < STRATEGY_HELD; held++) {
+            table->decisions[0][danger][held] = decide(
+                    &rules[danger][RULE_LEAD], held, -1, RULE_LEAD);
+            for (int suit = 0; suit < NUM_SUITS; suit++) {
+                RuleType type = held & (1 << suit) ? RULE_FOLLOW : RULE_VOID;
+                table->decisions[suit + 1][danger][held] = decide(
+                        &rules[danger][type], held, suit, type);
+            }
+        }
+    }
+}
+
+/**
+ * compiles a strategy spec into a decision table
+ *
+ * @param spec  text of the strategy
+ * @param table table to fill
+ * @return      true if the spec is legal, false otherwise
+ */
+bool strategy_compile(const char* spec, StrategyTable* table) {
+    Rule rules[2][NUM_RULE_TYPES];
+
+    if (!strategy_parse(spec, rules)) {
+        return false;
+    }
+    strategy_build(rules, table);
+
+    return true;
+}
+
+/**
+ * writes the rules marked present as a one line spec, rules separated by
+ * "; "
+ *
+ * @param rules     rules of the strategy, [danger][RuleType]
+ * @param buffer    buffer of STRATEGY_LINE_SIZE to put the line into
+ */
+void strategy_format(Rule rules[2][NUM_RULE_TYPES], char* buffer) {
+    const char* types[] = {"lead", "follow", "void"};
+    const char suits[] = {'S', 'C', 'D', 'H'};
+    int length = 0;
+
+    buffer[0] = 0;
+    for (int danger = 1; danger >= 0; danger--) {
+        for (int i = 0; i < NUM_RULE_TYPES; i++) {
+            Rule* rule = &rules[danger][i];
+            if (!rule->present) {
+                continue;
+            }
+            length += sprintf(buffer + length, "%s%s%s", length ? "; " : "",
+                    danger ? "danger " : "", types[i]);
+            for (int j = 0; j < rule->count; j++) {
+                length += sprintf(buffer + length, " %c",
+                        suits[rule->order[j]]);
+            }
+            length += sprintf(buffer + length, " %s",
+                    rule->highest ? "highest" : "lowest");
+        }
+    }
+}
+
+/**
+ * chooses a card with a compiled strategy
+ *
+ * @param table     compiled strategy
+ * @param hand      mask of ranks held for each suit
+ * @param leadSuit  suit of the lead card, -1 if we are leading
+ * @param danger    true if some player has won at least threshold - 2
+ *                  d cards and d cards have been played this trick
+ * @return          card_index of the card to play, -1 if the hand is empty
+ */
+int strategy_choose(const StrategyTable* table, const uint32_t* hand,
+        int leadSuit, bool danger) {
+    int held = (hand[0] != 0) | (hand[1] != 0) << 1 | (hand[2] != 0) << 2
+            | (hand[3] != 0) << 3;
+    uint8_t decision = table->decisions[leadSuit + 1][danger][held];
+
+    if (!(decision & DECISION_VALID)) {
+        return -1;
+    }
+
+    int suit = decision & DECISION_SUIT;
+    int rank = decision & DECISION_HIGHEST ? 31 - __builtin_clz(hand[suit])
+            : __builtin_ctz(hand[suit]);
+
+    return suit * NUM_RANKS + rank;
+}
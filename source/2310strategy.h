@@ -0,0 +1,53 @@
+//
+// Created by caleb on 2019-10-11.
+//
+
+#ifndef ASS3_STRATEGY_H
+#define ASS3_STRATEGY_H
+
+#include "2310shared.h"
+
+#define STRATEGY_LEADS (NUM_SUITS + 1)
+#define STRATEGY_HELD (1 << NUM_SUITS)
+#define STRATEGY_FILE_SIZE 4096
+#define STRATEGY_LINE_SIZE 256
+
+#define DECISION_SUIT 0x03
+#define DECISION_HIGHEST 0x04
+#define DECISION_VALID 0x80
+
+typedef enum {
+    RULE_LEAD = 0,
+    RULE_FOLLOW = 1,
+    RULE_VOID = 2,
+    NUM_RULE_TYPES = 3
+} RuleType;
+
+typedef struct {
+    bool present;
+    bool highest;
+    int count;
+    int order[NUM_SUITS];
+} Rule;
+
+/*
+ * a compiled strategy. decisions[leadSuit + 1][danger][held] is the move
+ * for every situation, where held has bit s set if the hand holds any card
+ * of suit s. a decision is the suit to play from, DECISION_HIGHEST if the
+ * highest card of it is played rather than the lowest, and DECISION_VALID
+ * unless the hand is empty
+ */
+typedef struct {
+    uint8_t decisions[STRATEGY_LEADS][2][STRATEGY_HELD];
+} StrategyTable;
+
+const char* strategy_builtin(const char* name);
+char* strategy_load(const char* name);
+bool strategy_parse(const char* spec, Rule rules[2][NUM_RULE_TYPES]);
+void strategy_build(Rule rules[2][NUM_RULE_TYPES], StrategyTable* table);
+bool strategy_compile(const char* spec, StrategyTable* table);
+void strategy_format(Rule rules[2][NUM_RULE_TYPES], char* buffer);
+int strategy_choose(const StrategyTable* table, const uint32_t* hand,
+        int leadSuit, bool danger);
+
+#endif //ASS3_STRATEGY_H
@@ -0,0 +1,164 @@
+//
+// Created by caleb on 2019-10-16.
+//
+/*
+ * Looking after the player processes.
+ *
+ * Every player the hub starts is recorded here. However the hub ends -
+ * normally, through quit_on_error, or on SIGHUP, SIGINT or SIGTERM - its
+ * players are reaped, and any still running are killed first, so nothing
+ * is left behind as a zombie or an orphan. Reaping with wait4 also gives
+ * each player's CPU time and peak memory, which --rusage prints.
+ *
+ * supervise_kill is called from signal handlers, so it only uses kill
+ * and wait4.
+ */
+
+#include "2310supervise.h"
+
+static Supervisor supervisor;
+
+/**
+ * kills and reaps every player, then dies of the signal that got us here
+ *
+ * @param sig   signal id
+ */
+static void handle_termination(int sig) {
+    supervise_kill();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/**
+ * starts supervising, with no players yet
+ */
+void supervise_init(void) {
+    supervisor.owner = getpid();
+    supervisor.count = 0;
+    signal(SIGINT, handle_termination);
+    signal(SIGTERM, handle_termination);
+}
+
+/**
+ * records a player process, in the place of one that has been reaped if
+ * they are all taken
+ *
+ * @param pid       process id of the player
+ * @param program   program the player runs
+ */
+void supervise_add(pid_t pid, const char* program) {
+    int slot = supervisor.count;
+
+    for (int i = 0; slot == MAX_PLAYERS && i < MAX_PLAYERS; i++) {
+        if (supervisor.children[i].reaped) {
+            slot = i;
+        }
+    }
+    if (slot == MAX_PLAYERS) {
+        return;
+    }
+
+    Child* child = &supervisor.children[slot];
+    child->pid = pid;
+    child->program = program;
+    child->reaped = false;
+    if (slot == supervisor.count) {
+        supervisor.count++;
+    }
+}
+
+/**
+ * waits for a player to exit
+ *
+ * @param child     the player
+ * @param options   options for wait4, WNOHANG to not wait
+ * @return          true if it has been reaped
+ */
+static bool reap(Child* child, int options) {
+    if (!child->reaped && wait4(child->pid, &child->status, options,
+            &child->usage) == child->pid) {
+        child->reaped = true;
+    }
+
+    return child->reaped;
+}
+
+/**
+ * waits for one player to exit
+ *
+ * @param pid   process id of the player
+ * @return      its wait status
+ */
+int supervise_wait(pid_t pid) {
+    for (int i = 0; i < supervisor.count; i++) {
+        if (supervisor.children[i].pid == pid) {
+            reap(&supervisor.children[i], 0);
+            return supervisor.children[i].status;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * kills every player still running and reaps them all
+ */
+void supervise_kill(void) {
+    if (getpid() != supervisor.owner) {
+        return;
+    }
+
+    for (int i = 0; i < supervisor.count; i++) {
+        if (!supervisor.children[i].reaped) {
+            kill(supervisor.children[i].pid, SIGKILL);
+        }
+    }
+    for (int i = 0; i < supervisor.count; i++) {
+        reap(&supervisor.children[i], 0);
+    }
+}
+
+/**
+ * gives the players time to exit on their own, then kills the rest
+ *
+ * @param timeoutMs     milliseconds to wait
+ */
+void supervise_reap(int timeoutMs) {
+    struct timespec poll = {0, REAP_POLL_NANOSECONDS};
+
+    for (int waited = 0; waited <= timeoutMs; waited++) {
+        int running = 0;
+        for (int i = 0; i < supervisor.count; i++) {
+            running += !reap(&supervisor.children[i], WNOHANG);
+        }
+        if (running == 0) {
+            return;
+        }
+        nanosleep(&poll, NULL);
+    }
+
+    supervise_kill();
+}
+
+/**
+ * prints how each player exited and the CPU time and memory it used
+ */
+void supervise_report(void) {
+    for (int i = 0; i < supervisor.count; i++) {
+        Child* child = &supervisor.children[i];
+        if (!child->reaped) {
+            continue;
+        }
+
+        const char* how = WIFSIGNALED(child->status) ? "signal" : "exit";
+        int code = WIFSIGNALED(child->status) ? WTERMSIG(child->status)
+                : WEXITSTATUS(child->status);
+        log_printf(STDOUT_FILENO, "Player=%d program=%s %s=%d user=%.3f "
+                "sys=%.3f maxrss=%ldKB\n", i, child->program, how, code,
+                child->usage.ru_utime.tv_sec +
+                child->usage.ru_utime.tv_usec / 1e6,
+                child->usage.ru_stime.tv_sec +
+                child->usage.ru_stime.tv_usec / 1e6,
+                child->usage.ru_maxrss);
+    }
+}
@@ -0,0 +1,46 @@
+//
+// Created by caleb on 2019-10-16.
+//
+
+#ifndef ASS3_SUPERVISE_H
+#define ASS3_SUPERVISE_H
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#include "2310shared.h"
+#include "2310log.h"
+
+#define REAP_POLL_NANOSECONDS 1000000
+#define REAP_TIMEOUT_MS 1000
+
+/*
+ * a player process. usage and status are only set once it is reaped
+ */
+typedef struct {
+    pid_t pid;
+    const char* program;
+    bool reaped;
+    int status;
+    struct rusage usage;
+} Child;
+
+/*
+ * every player process the hub has started. owner is the hub, so a child
+ * that fails to exec doesn't kill its siblings on the way out
+ */
+typedef struct {
+    pid_t owner;
+    volatile sig_atomic_t count;
+    Child children[MAX_PLAYERS];
+} Supervisor;
+
+void supervise_init(void);
+void supervise_add(pid_t pid, const char* program);
+int supervise_wait(pid_t pid);
+void supervise_kill(void);
+void supervise_reap(int timeoutMs);
+void supervise_report(void);
+
+#endif //ASS3_SUPERVISE_H
@@ -0,0 +1,513 @@
+//
+// Created by caleb on 2019-10-12.
+//
+/*
+ * EXIT CONDITION                               MESSAGE
+ * 0    Normal exit
+ * 1    Incorrect arguments                     Usage: 2310sweep [--deals=n]
+ *                                              [--seed=n] [--players=n]
+ *                                              [--cards=n] [--threshold=n]
+ *                                              [--threads=n] [--top=n]
+ *                                              [--vary=rule,...] base
+ *                                              opponent
+ * 2    base or opponent can't be loaded        Invalid strategy
+ *
+ * Plays every variant of base's rule family against opponent over the same
+ * deals and prints the variants ranked by average score. A variant changes
+ * the suit order (any of the 24) and highest/lowest choice of each varied
+ * rule. --vary picks the rules to vary from lead, follow, void,
+ * danger-lead, danger-follow and danger-void; the default is
+ * lead,follow,void. The variant plays seat 0 and opponent every other seat.
+ *
+ * The deals are shuffled and encoded once, then shared read only by the
+ * workers. Work is split into tasks of one variant and DEAL_CHUNK deals.
+ * Each worker starts with an even share of the tasks and, when it runs
+ * out, steals the back half of another worker's remaining tasks.
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "2310batch.h"
+
+#define DEAL_CHUNK 1024
+#define NUM_ORDERS 24
+#define MAX_VARIANTS (1L << 22)
+
+typedef struct {
+    long deals;
+    uint64_t seed;
+    int playerCount;
+    int cards;
+    int threshold;
+    int threads;
+    int top;
+    int varied;
+    int vary[2 * NUM_RULE_TYPES];
+} SweepOptions;
+
+typedef struct {
+    pthread_mutex_t lock;
+    long next;
+    long end;
+} TaskRange;
+
+typedef struct {
+    const SweepOptions* options;
+    const Batch* deals;
+    Rule base[2][NUM_RULE_TYPES];
+    StrategyTable opponent;
+    int orders[NUM_ORDERS][NUM_SUITS];
+    long chunks;
+    TaskRange* ranges;
+    int64_t* totals;
+} Sweep;
+
+typedef struct {
+    Sweep* sweep;
+    int id;
+} Worker;
+
+/**
+ * prints the usage message and exits
+ */
+void usage(void) {
+    fputs("Usage: 2310sweep [--deals=n] [--seed=n] [--players=n] "
+            "[--cards=n] [--threshold=n] [--threads=n] [--top=n] "
+            "[--vary=rule,...] base opponent\n", stderr);
+    exit(1);
+}
+
+/**
+ * parses the list of rules to vary
+ *
+ * @param list      comma separated rule names
+ * @param options   options to put the rules into, as danger * 3 + type
+ */
+void parse_vary(const char* list, SweepOptions* options) {
+    const char* names[] = {"lead", "follow", "void", "danger-lead",
+            "danger-follow", "danger-void"};
+    char* text = strdup(list);
+    char* save;
+
+    options->varied = 0;
+    for (char* name = strtok_r(text, ",", &save); name != NULL;
+            name = strtok_r(NULL, ",", &save)) {
+        int rule = -1;
+        for (int i = 0; i < 2 * NUM_RULE_TYPES; i++) {
+            if (strcmp(name, names[i]) == 0) {
+                rule = i;
+            }
+        }
+        for (int i = 0; i < options->varied; i++) {
+            if (options->vary[i] == rule) {
+                rule = -1;
+            }
+        }
+        if (rule == -1) {
+            usage();
+        }
+        options->vary[options->varied++] = rule;
+    }
+    free(text);
+
+    if (options->varied == 0) {
+        usage();
+    }
+}
+
+/**
+ * reads the command line, exiting on anything illegal
+ *
+ * @param argc      number of args
+ * @param argv      values of args
+ * @param options   options to init
+ * @param names     base and opponent strategy names to put values into
+ */
+void init_sweep(int argc, char** argv, SweepOptions* options,
+        const char** names) {
+    int named = 0;
+
+    options->deals = 10000;
+    options->seed = 1;
+    options->playerCount = 4;
+    options->cards = NUM_SUITS * NUM_RANKS;
+    options->threshold = 4;
+    options->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    options->top = 20;
+    parse_vary("lead,follow,void", options);
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--deals=", 8) == 0) {
+            options->deals = strtol(argv[i] + 8, NULL, 10);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            options->seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--players=", 10) == 0) {
+            options->playerCount = strtol(argv[i] + 10, NULL, 10);
+        } else if (strncmp(argv[i], "--cards=", 8) == 0) {
+            options->cards = strtol(argv[i] + 8, NULL, 10);
+        } else if (strncmp(argv[i], "--threshold=", 12) == 0) {
+            if (!valid_threshold(argv[i] + 12)) {
+                usage();
+            }
+            options->threshold = strtol(argv[i] + 12, NULL, 10);
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            options->threads = strtol(argv[i] + 10, NULL, 10);
+        } else if (strncmp(argv[i], "--top=", 6) == 0) {
+            options->top = strtol(argv[i] + 6, NULL, 10);
+        } else if (strncmp(argv[i], "--vary=", 7) == 0) {
+            parse_vary(argv[i] + 7, options);
+        } else if (named < 2) {
+            names[named++] = argv[i];
+        } else {
+            usage();
+        }
+    }
+
+    if (named != 2 || options->deals < 1 || options->threads < 1 ||
+            options->top < 1 || options->playerCount < 2 ||
+            options->playerCount > MAX_PLAYERS ||
+            options->cards < options->playerCount ||
+            options->cards > NUM_SUITS * NUM_RANKS) {
+        usage();
+    }
+}
+
+/**
+ * fills in every order of the suits
+ *
+ * @param orders    NUM_ORDERS orders to fill
+ */
+void make_orders(int orders[NUM_ORDERS][NUM_SUITS]) {
+    int count = 0;
+
+    for (int a = 0; a < NUM_SUITS; a++) {
+        for (int b = 0; b < NUM_SUITS; b++) {
+            for (int c = 0; c < NUM_SUITS; c++) {
+                int d = 6 - a - b - c;
+                if (a != b && a != c && b != c && d != a && d != b &&
+                        d != c) {
+                    orders[count][0] = a;
+                    orders[count][1] = b;
+                    orders[count][2] = c;
+                    orders[count][3] = d;
+                    count++;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * gets how many ways a rule can vary
+ *
+ * @param rule  rule as danger * 3 + type
+ * @return      number of variants of the rule
+ */
+int rule_choices(int rule) {
+    return rule % NUM_RULE_TYPES == RULE_FOLLOW ? 2 : 2 * NUM_ORDERS;
+}
+
+/**
+ * works out the rules of a variant
+ *
+ * @param sweep     sweep being run
+ * @param variant   number of the variant
+ * @param rules     rules to fill, [danger][RuleType]
+ */
+void variant_rules(const Sweep* sweep, long variant,
+        Rule rules[2][NUM_RULE_TYPES]) {
+    const SweepOptions* options = sweep->options;
+
+    memcpy(rules, sweep->base, sizeof(sweep->base));
+    for (int i = 0; i < options->varied; i++) {
+        int choices = rule_choices(options->vary[i]);
+        int choice = variant % choices;
+        Rule* rule = &rules[options->vary[i] / NUM_RULE_TYPES]
+                [options->vary[i] % NUM_RULE_TYPES];
+        variant /= choices;
+
+        rule->present = true;
+        rule->highest = choice % 2;
+        if (choices != 2) {
+            rule->count = NUM_SUITS;
+            memcpy(rule->order, sweep->orders[choice / 2],
+                    sizeof(rule->order));
+        }
+    }
+
+    // danger rules that weren't given follow the plain ones
+    for (int i = 0; i < NUM_RULE_TYPES; i++) {
+        if (!rules[1][i].present) {
+            rules[1][i] = rules[0][i];
+            rules[1][i].present = false;
+        }
+    }
+}
+
+/**
+ * finds the variant that plays the same as the base strategy. rules that
+ * name fewer than NUM_SUITS suits are checked in the order they would be
+ * played in
+ *
+ * @param sweep     sweep being run
+ * @return          number of the variant
+ */
+long base_variant(const Sweep* sweep) {
+    const SweepOptions* options = sweep->options;
+    long variant = 0;
+
+    for (int i = options->varied - 1; i >= 0; i--) {
+        const Rule* rule = &sweep->base[options->vary[i] / NUM_RULE_TYPES]
+                [options->vary[i] % NUM_RULE_TYPES];
+        int choice = rule->highest;
+
+        if (rule_choices(options->vary[i]) != 2) {
+            int order[NUM_SUITS];
+            int count = rule->count;
+            memcpy(order, rule->order, sizeof(order));
+            for (int suit = 0; suit < NUM_SUITS; suit++) {
+                bool listed = false;
+                for (int j = 0; j < rule->count; j++) {
+                    listed |= rule->order[j] == suit;
+                }
+                if (!listed) {
+                    order[count++] = suit;
+                }
+            }
+            for (int j = 0; j < NUM_ORDERS; j++) {
+                if (memcmp(order, sweep->orders[j], sizeof(order)) == 0) {
+                    choice += 2 * j;
+                }
+            }
+        }
+        variant = variant * rule_choices(options->vary[i]) + choice;
+    }
+
+    return variant;
+}
+
+/**
+ * takes the next task of a worker, stealing from the others if it has none
+ *
+ * @param sweep     sweep being run
+ * @param id        worker taking a task
+ * @param task      task to put value into
+ * @return          true if there was a task, false if all are done
+ */
+bool take_task(Sweep* sweep, int id, long* task) {
+    TaskRange* own = &sweep->ranges[id];
+
+    pthread_mutex_lock(&own->lock);
+    if (own->next < own->end) {
+        *task = own->next++;
+        pthread_mutex_unlock(&own->lock);
+        return true;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (int i = 1; i < sweep->options->threads; i++) {
+        TaskRange* victim = &sweep->ranges[(id + i) %
+                sweep->options->threads];
+        pthread_mutex_lock(&victim->lock);
+        long left = victim->end - victim->next;
+        if (left > 0) {
+            long middle = victim->end - (left + 1) / 2;
+            long end = victim->end;
+            victim->end = middle;
+            pthread_mutex_unlock(&victim->lock);
+
+            pthread_mutex_lock(&own->lock);
+            *task = middle;
+            own->next = middle + 1;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    return false;
+}
+
+/**
+ * plays one variant against the opponent over one chunk of the deals
+ *
+ * @param sweep     sweep being run
+ * @param task      variant * chunks + chunk
+ */
+void run_task(Sweep* sweep, long task) {
+    const SweepOptions* options = sweep->options;
+    long variant = task / sweep->chunks;
+    int first = (task % sweep->chunks) * DEAL_CHUNK;
+    int count = options->deals - first < DEAL_CHUNK
+            ? options->deals - first : DEAL_CHUNK;
+    Strategy seats[MAX_PLAYERS] = {STRATEGY_ALICE};
+    Rule rules[2][NUM_RULE_TYPES];
+    StrategyTable table;
+    int scores[MAX_PLAYERS];
+    int64_t total = 0;
+
+    variant_rules(sweep, variant, rules);
+    strategy_build(rules, &table);
+
+    Batch* batch = batch_create(count, options->playerCount,
+            options->threshold, sweep->deals->numRounds, seats);
+    batch_set_table(batch, 0, &table);
+    for (int seat = 1; seat < options->playerCount; seat++) {
+        batch_set_table(batch, seat, &sweep->opponent);
+    }
+    batch_load(batch, sweep->deals, first);
+    batch_play(batch);
+
+    for (int game = 0; game < count; game++) {
+        batch_scores(batch, game, scores);
+        total += scores[0];
+    }
+    batch_free(batch);
+
+    __atomic_fetch_add(&sweep->totals[variant], total, __ATOMIC_RELAXED);
+}
+
+/**
+ * runs tasks until there are none left
+ *
+ * @param arg   the Worker
+ * @return      NULL
+ */
+void* work(void* arg) {
+    Worker* worker = (Worker*)arg;
+    long task;
+
+    while (take_task(worker->sweep, worker->id, &task)) {
+        run_task(worker->sweep, task);
+    }
+
+    return NULL;
+}
+
+/**
+ * shuffles and encodes every deal of the sweep
+ *
+ * @param options   options of the sweep
+ * @return          the dealt batch
+ */
+Batch* make_deals(const SweepOptions* options) {
+    Strategy seats[MAX_PLAYERS] = {STRATEGY_ALICE};
+    Card deck[NUM_SUITS * NUM_RANKS];
+    uint64_t seed = options->seed;
+
+    Batch* deals = batch_create(options->deals, options->playerCount,
+            options->threshold, options->cards / options->playerCount,
+            seats);
+    for (long game = 0; game < options->deals; game++) {
+        full_deck(deck);
+        shuffle_cards(deck, NUM_SUITS * NUM_RANKS, &seed);
+        batch_deal(deals, game, deck);
+    }
+
+    return deals;
+}
+
+// totals that compare_variants ranks by, as qsort takes no context
+int64_t* rankTotals;
+
+/**
+ * compares variants by their total score, best first
+ *
+ * @param a     pointer to the first variant
+ * @param b     pointer to the second variant
+ * @return      <0 if a ranks first, >0 if b does
+ */
+int compare_variants(const void* a, const void* b) {
+    int64_t first = rankTotals[*(const long*)a];
+    int64_t second = rankTotals[*(const long*)b];
+
+    if (first != second) {
+        return first > second ? -1 : 1;
+    }
+    return *(const long*)a < *(const long*)b ? -1 : 1;
+}
+
+/**
+ * main function of ./2310sweep
+ *
+ * @param argc  number of args
+ * @param argv  values of args
+ * @return      status. 0 if OK
+ */
+int main(int argc, char** argv) {
+    SweepOptions options;
+    const char* names[2];
+    Sweep sweep;
+    init_sweep(argc, argv, &options, names);
+
+    char* baseSpec = strategy_load(names[0]);
+    char* opponentSpec = strategy_load(names[1]);
+    if (baseSpec == NULL || opponentSpec == NULL ||
+            !strategy_parse(baseSpec, sweep.base) ||
+            !strategy_compile(opponentSpec, &sweep.opponent)) {
+        fputs("Invalid strategy\n", stderr);
+        return 2;
+    }
+
+    long variants = 1;
+    for (int i = 0; i < options.varied; i++) {
+        variants *= rule_choices(options.vary[i]);
+    }
+    if (variants > MAX_VARIANTS) {
+        usage();
+    }
+
+    double start = now_seconds();
+    sweep.options = &options;
+    sweep.deals = make_deals(&options);
+    make_orders(sweep.orders);
+    sweep.chunks = (options.deals + DEAL_CHUNK - 1) / DEAL_CHUNK;
+    sweep.totals = calloc(variants, sizeof(int64_t));
+    sweep.ranges = calloc(options.threads, sizeof(TaskRange));
+
+    long tasks = variants * sweep.chunks;
+    pthread_t* threads = calloc(options.threads, sizeof(pthread_t));
+    Worker* workers = calloc(options.threads, sizeof(Worker));
+    for (int i = 0; i < options.threads; i++) {
+        pthread_mutex_init(&sweep.ranges[i].lock, NULL);
+        sweep.ranges[i].next = tasks * i / options.threads;
+        sweep.ranges[i].end = tasks * (i + 1) / options.threads;
+        workers[i].sweep = &sweep;
+        workers[i].id = i;
+    }
+    for (int i = 0; i < options.threads; i++) {
+        pthread_create(&threads[i], NULL, work, &workers[i]);
+    }
+    for (int i = 0; i < options.threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double seconds = now_seconds() - start;
+
+    long* ranking = calloc(variants, sizeof(long));
+    for (long i = 0; i < variants; i++) {
+        ranking[i] = i;
+    }
+    rankTotals = sweep.totals;
+    qsort(ranking, variants, sizeof(long), compare_variants);
+
+    long base = base_variant(&sweep);
+    char line[STRATEGY_LINE_SIZE];
+    Rule rules[2][NUM_RULE_TYPES];
+    for (long i = 0; i < variants; i++) {
+        if (i >= options.top && ranking[i] != base) {
+            continue;
+        }
+        variant_rules(&sweep, ranking[i], rules);
+        strategy_format(rules, line);
+        printf("%sRank=%ld score=%.4f spec=%s\n",
+                ranking[i] == base ? "Base " : "", i + 1,
+                (double)sweep.totals[ranking[i]] / options.deals, line);
+    }
+    printf("Variants=%ld deals=%ld threads=%d seconds=%.3f "
+            "games/sec=%.0f\n", variants, options.deals, options.threads,
+            seconds, variants * options.deals / seconds);
+
+    return 0;
+}
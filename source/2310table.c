@@ -0,0 +1,29 @@
+//
+// Created by caleb on 2019-10-11.
+//
+/*
+ * A player that plays any table driven strategy. Players only get the
+ * protocol args, so the strategy comes from the environment:
+ *
+ *      PLAYER_STRATEGY=bob ./2310table players myid threshold handsize
+ *
+ * PLAYER_STRATEGY is the name of a built in strategy or the path of a spec
+ * file, see 2310strategy.c. exits with Invalid strategy if it isn't set or
+ * the spec isn't legal.
+ */
+
+#include "2310baseplayer.h"
+
+/**
+ * gets the strategy named by PLAYER_STRATEGY
+ *
+ * @return  the spec of the strategy, NULL if it can't be found
+ */
+const char* player_strategy(void) {
+    const char* name = getenv("PLAYER_STRATEGY");
+    if (name == NULL) {
+        return NULL;
+    }
+
+    return strategy_load(name);
+}
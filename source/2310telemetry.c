@@ -0,0 +1,249 @@
+//
+// Created by caleb on 2019-10-16.
+//
+/*
+ * Live counters of a running hub, for 2310stats.
+ *
+ * The hub keeps a Telemetry in POSIX shared memory and bumps its counters
+ * as it goes. Every update is a single relaxed atomic add, so the game is
+ * never held up by a reader, and a hub without --telemetry only pays for
+ * a NULL check.
+ */
+
+#include "2310telemetry.h"
+
+static Telemetry* telemetry;
+static const char* telemetryName;
+static pid_t owner;
+
+/**
+ * checks whether counters left under a name belong to a hub that is still
+ * running, or one still setting them up
+ *
+ * @param fd    the counters' shared memory
+ * @return      true if they mustn't be taken over
+ */
+static bool in_use(int fd) {
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size < (off_t)sizeof(Telemetry)) {
+        return true;
+    }
+
+    Telemetry* counters = mmap(NULL, sizeof(Telemetry), PROT_READ,
+            MAP_SHARED, fd, 0);
+    if (counters == MAP_FAILED) {
+        return true;
+    }
+    pid_t writer = counters->writerPid;
+    munmap(counters, sizeof(Telemetry));
+
+    return writer == 0 || kill(writer, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * creates the shared memory counters of the hub, taking over ones left by
+ * a hub that died without removing them
+ *
+ * @param name          shm_open name of the counters, eg. /2310stats,
+ *                      which must last until telemetry_exit
+ * @param playerCount   number of seats
+ * @return              true if the counters could be created, false if
+ *                      another hub is using the name
+ */
+bool telemetry_create(const char* name, int playerCount) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1 && errno == EEXIST) {
+        fd = shm_open(name, O_RDWR, 0);
+        if (fd != -1 && in_use(fd)) {
+            close(fd);
+            return false;
+        }
+    }
+    if (fd == -1) {
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(Telemetry)) == -1) {
+        close(fd);
+        return false;
+    }
+
+    Telemetry* counters = mmap(NULL, sizeof(Telemetry),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (counters == MAP_FAILED) {
+        return false;
+    }
+
+    // clear everything first so readers of an old hub start again
+    counters->magic = 0;
+    atomic_thread_fence(memory_order_release);
+    memset((char*)counters + sizeof(counters->magic), 0,
+            sizeof(Telemetry) - sizeof(counters->magic));
+    atomic_store(&counters->status, -1);
+    counters->writerPid = getpid();
+    counters->playerCount = playerCount;
+    atomic_thread_fence(memory_order_release);
+    counters->magic = TELEMETRY_MAGIC;
+    telemetry = counters;
+    telemetryName = name;
+    owner = getpid();
+
+    return true;
+}
+
+/**
+ * adds to the counters of a coordinating hub, for a --worker hub. the
+ * coordinator alone clears them and records the exit status
+ *
+ * @param name  shm_open name of the counters
+ * @return      true if the counters could be mapped
+ */
+bool telemetry_join(const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) {
+        return false;
+    }
+
+    Telemetry* counters = mmap(NULL, sizeof(Telemetry),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (counters == MAP_FAILED) {
+        return false;
+    }
+    if (counters->magic != TELEMETRY_MAGIC) {
+        munmap(counters, sizeof(Telemetry));
+        return false;
+    }
+    telemetry = counters;
+
+    return true;
+}
+
+/**
+ * maps existing counters read only
+ *
+ * @param name  shm_open name of the counters
+ * @return      the mapped counters, NULL on failure
+ */
+Telemetry* telemetry_attach(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    Telemetry* counters = mmap(NULL, sizeof(Telemetry), PROT_READ,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (counters == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (counters->magic != TELEMETRY_MAGIC) {
+        munmap(counters, sizeof(Telemetry));
+        return NULL;
+    }
+
+    return counters;
+}
+
+/**
+ * adds to a counter, if the hub has counters
+ *
+ * @param counter   counter to add to
+ * @param amount    amount to add
+ */
+static void bump(atomic_uint_fast64_t* counter, uint64_t amount) {
+    atomic_fetch_add_explicit(counter, amount, memory_order_relaxed);
+}
+
+/**
+ * counts a game being dealt
+ */
+void telemetry_game_started(void) {
+    if (telemetry != NULL) {
+        bump(&telemetry->gamesStarted, 1);
+    }
+}
+
+/**
+ * counts a game ending normally
+ */
+void telemetry_game_finished(void) {
+    if (telemetry != NULL) {
+        bump(&telemetry->gamesFinished, 1);
+    }
+}
+
+/**
+ * counts a trick being completed
+ */
+void telemetry_trick(void) {
+    if (telemetry != NULL) {
+        bump(&telemetry->tricks, 1);
+    }
+}
+
+/**
+ * counts messages sent to the players
+ *
+ * @param messages  number of messages
+ * @param bytes     number of bytes
+ */
+void telemetry_sent(int messages, int bytes) {
+    if (telemetry != NULL) {
+        bump(&telemetry->messagesOut, messages);
+        bump(&telemetry->bytesOut, bytes);
+    }
+}
+
+/**
+ * counts a message received from a player
+ *
+ * @param bytes     length of the message
+ */
+void telemetry_received(int bytes) {
+    if (telemetry != NULL) {
+        bump(&telemetry->messagesIn, 1);
+        bump(&telemetry->bytesIn, bytes);
+    }
+}
+
+/**
+ * changes the bytes waiting to be written to a seat
+ *
+ * @param seat      the seat
+ * @param change    bytes added (or taken away, if negative)
+ */
+void telemetry_queued(int seat, int64_t change) {
+    if (telemetry != NULL) {
+        bump(&telemetry->queued[seat], (uint64_t)change);
+    }
+}
+
+/**
+ * counts an error caused by a seat
+ *
+ * @param seat      the seat
+ * @param status    status the hub exits with because of it
+ */
+void telemetry_error(int seat, int status) {
+    if (telemetry != NULL && status < TELEMETRY_STATUSES) {
+        bump(&telemetry->errors[seat][status], 1);
+    }
+}
+
+/**
+ * records the status the hub is exiting with and removes the counters'
+ * name. readers already attached keep their mapping to see the status.
+ * does nothing in a child process of the hub
+ *
+ * @param status    the exit status
+ */
+void telemetry_exit(int status) {
+    if (telemetry != NULL && telemetryName != NULL && getpid() == owner) {
+        atomic_store_explicit(&telemetry->status, status,
+                memory_order_release);
+        shm_unlink(telemetryName);
+    }
+}
@@ -0,0 +1,55 @@
+//
+// Created by caleb on 2019-10-16.
+//
+
+#ifndef ASS3_TELEMETRY_H
+#define ASS3_TELEMETRY_H
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "2310shared.h"
+
+#define TELEMETRY_MAGIC 0x32333131
+#define TELEMETRY_STATUSES 16
+
+/*
+ * counters of a running hub. only the hub writes them, each on its own
+ * with relaxed atomics, so a reader sees every counter whole but not
+ * always all of them from the same moment. out is hub to players, in is
+ * players to hub. queued is the bytes waiting to be written to each seat.
+ * status is -1 until the hub exits, then its exit status
+ */
+typedef struct {
+    uint32_t magic;
+    int32_t writerPid;
+    int32_t playerCount;
+    atomic_int status;
+    atomic_uint_fast64_t gamesStarted;
+    atomic_uint_fast64_t gamesFinished;
+    atomic_uint_fast64_t tricks;
+    atomic_uint_fast64_t messagesOut;
+    atomic_uint_fast64_t bytesOut;
+    atomic_uint_fast64_t messagesIn;
+    atomic_uint_fast64_t bytesIn;
+    atomic_uint_fast64_t queued[MAX_PLAYERS];
+    atomic_uint_fast64_t errors[MAX_PLAYERS][TELEMETRY_STATUSES];
+} Telemetry;
+
+bool telemetry_create(const char* name, int playerCount);
+bool telemetry_join(const char* name);
+Telemetry* telemetry_attach(const char* name);
+void telemetry_game_started(void);
+void telemetry_game_finished(void);
+void telemetry_trick(void);
+void telemetry_sent(int messages, int bytes);
+void telemetry_received(int bytes);
+void telemetry_queued(int seat, int64_t change);
+void telemetry_error(int seat, int status);
+void telemetry_exit(int status);
+
+#endif //ASS3_TELEMETRY_H
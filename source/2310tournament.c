@@ -0,0 +1,774 @@
+//
+// Created by caleb on 2019-10-14.
+//
+/*
+ * Tournament mode of the hub.
+ *
+ * Plays --tournament=n games with the same players, each a fresh shuffle
+ * of the deck (game g is shuffled from seed + g, so runs can be repeated).
+ * Each seat is a single player process started with --multi, which plays
+ * that seat of every game; see 2310multi.c for the messages. Up to
+ * --window games are in progress at once.
+ *
+ * With --cache, games whose result is already known are not played again;
+ * see 2310cache.c.
+ *
+ * With --checkpoint the finished games are saved as the tournament goes,
+ * so a run that is stopped can be carried on with --resume and end with the
+ * same results; see 2310checkpoint.c.
+ *
+ * The hub never blocks on a player: messages for each player are buffered
+ * and written as its pipe has room, and plays are handled as they arrive
+ * from any player. A play is checked the same way as in a single game.
+ */
+
+#include "2310tournament.h"
+
+/**
+ * queues a message for a player
+ *
+ * @param seat      seat of the player
+ * @param format    printf format of the message
+ */
+void seat_printf(Seat* seat, const char* format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    if (seat->outLength + length + 1 > seat->outSize) {
+        seat->outSize = 2 * (seat->outLength + length + 1);
+        seat->out = realloc(seat->out, seat->outSize);
+    }
+
+    va_start(args, format);
+    vsprintf(seat->out + seat->outLength, format, args);
+    va_end(args);
+
+    // the link to a coordinator (index -1) is not a player
+    if (seat->index >= 0) {
+        int messages = 0;
+        for (int i = seat->outLength; i < seat->outLength + length; i++) {
+            messages += seat->out[i] == '\n';
+        }
+        telemetry_sent(messages, length);
+        telemetry_queued(seat->index, length);
+    }
+    seat->outLength += length;
+}
+
+/**
+ * shuffles the deck the way it is for a game
+ *
+ * @param game  game settings
+ * @param id    number of the game
+ * @param deck  where to put the shuffled deck
+ */
+static void shuffle_game(Game* game, long id, Card* deck) {
+    uint64_t seed = game->options.seed + id;
+
+    memcpy(deck, game->deck.cards, game->deck.count * sizeof(Card));
+    shuffle_cards(deck, game->deck.count, &seed);
+}
+
+/**
+ * gets the --cache key of a game: the players and threshold, then the
+ * cards dealt
+ *
+ * @param tournament    tournament being played
+ * @param deck          shuffled deck of the game
+ * @return              the key, never 0
+ */
+static uint64_t game_key(Tournament* tournament, const Card* deck) {
+    Game* game = tournament->game;
+    uint64_t key = hash_bytes(deck,
+            game->playerCount * game->numRounds * sizeof(Card),
+            tournament->matchup);
+
+    return key == 0 ? 1 : key;
+}
+
+/**
+ * gets the --cache key of a game from its number
+ *
+ * @param tournament    tournament being played
+ * @param id            number of the game
+ * @return              the key, never 0
+ */
+uint64_t tournament_game_key(Tournament* tournament, long id) {
+    Card* deck = malloc(tournament->game->deck.count * sizeof(Card));
+
+    shuffle_game(tournament->game, id, deck);
+    uint64_t key = game_key(tournament, deck);
+    free(deck);
+
+    return key;
+}
+
+/**
+ * deals a game and sends its start to every player
+ *
+ * @param tournament    tournament being played
+ * @param id            number of the game
+ */
+void start_tournament_game(Tournament* tournament, long id) {
+    Game* game = tournament->game;
+    Card* deck = malloc(game->deck.count * sizeof(Card));
+    int slot = 0;
+
+    while (tournament->slots[slot].id != -1) {
+        slot++;
+    }
+    TourGame* tourGame = &tournament->slots[slot];
+    memset(tourGame, 0, sizeof(TourGame));
+    tourGame->id = id;
+    telemetry_game_started();
+    tournament->slotOf[id] = slot;
+    tournament->active++;
+
+    shuffle_game(game, id, deck);
+    if (tournament->cache != NULL) {
+        tourGame->key = game_key(tournament, deck);
+    }
+
+    for (int i = 0; i < game->playerCount; i++) {
+        Seat* seat = &tournament->seats[i];
+        seat_printf(seat, "G%ld:GAME%d,%d,%d,%d\nG%ld:HAND%d", id,
+                game->playerCount, i, game->threshold, game->numRounds, id,
+                game->numRounds);
+        for (int j = i * game->numRounds; j < (i + 1) * game->numRounds;
+                j++) {
+            tourGame->hands[i].cards |= card_bit(deck[j]);
+            seat_printf(seat, ",%c%c", deck[j].suit, deck[j].rank);
+        }
+        seat_printf(seat, "\nG%ld:NEWROUND0\n", id);
+    }
+    free(deck);
+}
+
+/**
+ * deals the next game that hasn't already finished, if there is one
+ *
+ * @param tournament    tournament being played
+ * @return              true if a game was dealt
+ */
+bool deal_next_game(Tournament* tournament) {
+    long games = tournament->game->options.tournament;
+
+    if (tournament->game->options.worker) {
+        for (int i = 0; i < tournament->batchCount; i++) {
+            WorkBatch* batch = &tournament->batches[i];
+            if (batch->dealt < batch->count) {
+                start_tournament_game(tournament,
+                        batch->first + batch->dealt++);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    while (tournament->started < games &&
+            tournament->done[tournament->started]) {
+        tournament->started++;
+    }
+    if (tournament->started == games) {
+        return false;
+    }
+
+    start_tournament_game(tournament, tournament->started++);
+    return true;
+}
+
+/**
+ * counts the result of a game, whether it was played, found in the --cache
+ * or sent by a worker, and prints it
+ *
+ * @param tournament    tournament being played
+ * @param id            number of the game
+ * @param scores        score of each seat
+ */
+void record_tournament_game(Tournament* tournament, long id,
+        const int32_t* scores) {
+    Game* game = tournament->game;
+    char* buffer = calloc(game->playerCount + 2, 16);
+    int length = sprintf(buffer, "Game=%ld", id);
+
+    for (int i = 0; i < game->playerCount; i++) {
+        tournament->totals[i] += scores[i];
+        length += sprintf(buffer + length, " %d:%d", i, scores[i]);
+    }
+    buffer[length++] = '\n';
+    tournament->done[id] = true;
+    if (game->options.output == OUTPUT_TEXT) {
+        log_write(STDOUT_FILENO, buffer, length);
+    }
+    free(buffer);
+
+    // a resumed run doesn't print a journaled game again, so its line must
+    // be out before it is journaled
+    if (tournament->checkpoint != NULL) {
+        log_drain();
+        if (!checkpoint_game(tournament->checkpoint, id, scores)) {
+            quit_on_error(CHECKPOINTERROR);
+        }
+    }
+    tournament->finished++;
+}
+
+/**
+ * writes everything queued for the coordinator, waiting if it has to. a
+ * worker whose coordinator has gone just stops
+ *
+ * @param tournament    tournament of a --worker
+ */
+static void flush_link(Tournament* tournament) {
+    Seat* link = &tournament->link;
+    size_t written = 0;
+
+    while (written < link->outLength) {
+        ssize_t result = write(link->toPlayer, link->out + written,
+                link->outLength - written);
+        if (result == -1) {
+            check_sighup();
+            supervise_kill();
+            exit(OK);
+        }
+        written += result;
+    }
+    link->outLength = 0;
+}
+
+/**
+ * sends the result of a game to the coordinator, and says when its batch
+ * is done
+ *
+ * @param tournament    tournament of a --worker
+ * @param id            number of the game
+ * @param scores        score of each seat
+ */
+static void send_result(Tournament* tournament, long id,
+        const int32_t* scores) {
+    Seat* link = &tournament->link;
+    int batch = 0;
+
+    seat_printf(link, "R%ld", id);
+    for (int i = 0; i < tournament->game->playerCount; i++) {
+        seat_printf(link, "%c%d", i == 0 ? ':' : ',', scores[i]);
+    }
+    seat_printf(link, "\n");
+    tournament->finished++;
+
+    while (id < tournament->batches[batch].first ||
+            id >= tournament->batches[batch].first +
+            tournament->batches[batch].count) {
+        batch++;
+    }
+    if (--tournament->batches[batch].left > 0) {
+        return;
+    }
+    seat_printf(link, "D%ld\n", tournament->batches[batch].index);
+    flush_link(tournament);
+    tournament->batchCount--;
+    memmove(tournament->batches + batch, tournament->batches + batch + 1,
+            (tournament->batchCount - batch) * sizeof(WorkBatch));
+}
+
+/**
+ * deals games until the window is full or there are none left to deal
+ *
+ * @param tournament    tournament being played
+ */
+static void fill_window(Tournament* tournament) {
+    while (tournament->active < tournament->game->options.window) {
+        if (!deal_next_game(tournament)) {
+            return;
+        }
+    }
+}
+
+/**
+ * ends a game, reporting its scores and starting the next game if there is
+ * one
+ *
+ * @param tournament    tournament being played
+ * @param tourGame      game that has played its last trick
+ */
+void finish_tournament_game(Tournament* tournament, TourGame* tourGame) {
+    Game* game = tournament->game;
+    int32_t scores[MAX_PLAYERS];
+
+    for (int i = 0; i < game->playerCount; i++) {
+        seat_printf(&tournament->seats[i], "G%ld:GAMEOVER\n", tourGame->id);
+        scores[i] = rules_final_score(game->threshold, tourGame->tricks[i],
+                tourGame->dCards[i]);
+    }
+    if (game->options.worker) {
+        send_result(tournament, tourGame->id, scores);
+    } else {
+        record_tournament_game(tournament, tourGame->id, scores);
+    }
+    if (tournament->cache != NULL) {
+        cache_add(tournament->cache, tourGame->key, scores);
+    }
+
+    tourGame->id = -1;
+    telemetry_game_finished();
+    tournament->active--;
+    deal_next_game(tournament);
+}
+
+/**
+ * handles a play from a player, checking it is their turn and the card is
+ * legal, and moves the game on
+ *
+ * @param tournament    tournament being played
+ * @param seat          seat the play came from
+ * @param line          G<id>:PLAY<card> without its newline
+ */
+void handle_tournament_play(Tournament* tournament, int seat, char* line) {
+    Game* game = tournament->game;
+    char* end;
+
+    if (line[0] != 'G' || !isdigit((int)line[1])) {
+        quit_on_player_error(seat, BADMSG);
+    }
+    long id = strtol(line + 1, &end, 10);
+    if (id >= game->options.tournament || strncmp(end, ":PLAY", 5) != 0 ||
+            strlen(end) != 7 || !valid_card(end[5], end[6])) {
+        quit_on_player_error(seat, BADMSG);
+    }
+
+    TourGame* tourGame = &tournament->slots[tournament->slotOf[id]];
+    if (tourGame->id != id || seat !=
+            (tourGame->lead + tourGame->played) % game->playerCount) {
+        quit_on_player_error(seat, BADMSG);
+    }
+
+    Card card = {end[5], end[6]};
+    if (!take_card(&tourGame->hands[seat], card, tourGame->played == 0
+            ? -1 : RULES_SUIT(tourGame->trick[0]))) {
+        quit_on_player_error(seat, BADCARD);
+    }
+    tourGame->trick[tourGame->played++] = card_index(card);
+    for (int i = 0; i < game->playerCount; i++) {
+        if (i != seat) {
+            seat_printf(&tournament->seats[i], "G%ld:PLAYED%d,%c%c\n", id,
+                    seat, card.suit, card.rank);
+        }
+    }
+
+    if (tourGame->played < game->playerCount) {
+        return;
+    }
+
+    int winner = (rules_winner(game->playerCount, tourGame->trick) +
+            tourGame->lead) % game->playerCount;
+    tourGame->tricks[winner]++;
+    tourGame->dCards[winner] += rules_d_count(game->playerCount,
+            tourGame->trick);
+    tourGame->lead = winner;
+    tourGame->played = 0;
+    telemetry_trick();
+
+    if (++tourGame->round == game->numRounds) {
+        finish_tournament_game(tournament, tourGame);
+    } else {
+        for (int i = 0; i < game->playerCount; i++) {
+            seat_printf(&tournament->seats[i], "G%ld:NEWROUND%d\n", id,
+                    winner);
+        }
+    }
+}
+
+/**
+ * starts the player process of each seat and waits for it to say it is
+ * ready
+ *
+ * @param tournament    tournament to start players for
+ * @param programs      program of each seat
+ */
+static void start_seats(Tournament* tournament, char** programs) {
+    for (int i = 0; i < tournament->game->playerCount; i++) {
+        Seat* seat = &tournament->seats[i];
+        int toPlayer[2], fromPlayer[2];
+        seat->index = i;
+        char* args[] = {programs[i], "--multi", NULL};
+        char ready = 0;
+
+        pipe(toPlayer);
+        pipe(fromPlayer);
+        seat->pid = create_player_process(args, toPlayer, fromPlayer,
+                tournament->game->placement == NULL ? -1
+                : placement_cpu(tournament->game->placement, i + 1));
+        close(toPlayer[0]);
+        close(fromPlayer[1]);
+        seat->toPlayer = toPlayer[1];
+        seat->fromPlayer = fromPlayer[0];
+        // so later players don't hold this player's pipes open
+        fcntl(seat->toPlayer, F_SETFD, FD_CLOEXEC);
+        fcntl(seat->fromPlayer, F_SETFD, FD_CLOEXEC);
+
+        int64_t traced = trace_begin();
+        if (read(seat->fromPlayer, &ready, 1) != 1 || ready != '@') {
+            check_sighup();
+            quit_on_player_error(i, PLAYERERROR);
+        }
+        trace_end("handshake", traced, "player", i);
+        fcntl(seat->toPlayer, F_SETFL, O_NONBLOCK);
+        fcntl(seat->fromPlayer, F_SETFL, O_NONBLOCK);
+    }
+}
+
+/**
+ * writes as much of a player's queued messages as its pipe takes
+ *
+ * @param seat  seat of the player
+ */
+static void flush_seat(Seat* seat) {
+    ssize_t written = write(seat->toPlayer, seat->out, seat->outLength);
+    if (written == -1) {
+        if (errno == EAGAIN) {
+            return;
+        }
+        quit_on_player_error(seat->index, PLAYEREOF);
+    }
+
+    memmove(seat->out, seat->out + written, seat->outLength - written);
+    seat->outLength -= written;
+    telemetry_queued(seat->index, -written);
+}
+
+/**
+ * reads what a player has sent and handles each complete line
+ *
+ * @param tournament    tournament being played
+ * @param index         seat of the player
+ */
+static void read_seat(Tournament* tournament, int index) {
+    Seat* seat = &tournament->seats[index];
+    ssize_t got = read(seat->fromPlayer, seat->in + seat->inLength,
+            SEAT_BUFFER_SIZE - seat->inLength);
+    if (got == -1 && errno == EAGAIN) {
+        return;
+    }
+    if (got <= 0) {
+        quit_on_player_error(index, PLAYEREOF);
+    }
+    seat->inLength += got;
+
+    char* start = seat->in;
+    char* newline;
+    while ((newline = memchr(start, '\n',
+            seat->in + seat->inLength - start)) != NULL) {
+        *newline = 0;
+        telemetry_received(newline + 1 - start);
+        handle_tournament_play(tournament, index, start);
+        start = newline + 1;
+    }
+
+    seat->inLength -= start - seat->in;
+    if (seat->inLength == SEAT_BUFFER_SIZE) {
+        quit_on_player_error(index, BADMSG);
+    }
+    memmove(seat->in, start, seat->inLength);
+}
+
+/**
+ * opens the --checkpoint of a tournament, taking the games it has already
+ * finished from it if resuming
+ *
+ * @param tournament    tournament to be played
+ */
+static void open_checkpoint(Tournament* tournament) {
+    Game* game = tournament->game;
+    CheckpointHeader settings;
+
+    memset(&settings, 0, sizeof(settings));
+    settings.playerCount = game->playerCount;
+    settings.threshold = game->threshold;
+    settings.games = game->options.tournament;
+    settings.seed = game->options.seed;
+    settings.deckHash = hash_bytes(game->deck.cards,
+            game->deck.count * sizeof(Card), HASH_START);
+
+    tournament->checkpoint = malloc(sizeof(Checkpoint));
+    if (!checkpoint_open(tournament->checkpoint,
+            game->options.checkpointPath, &settings, tournament->done,
+            tournament->totals, game->options.resume)) {
+        quit_on_error(CHECKPOINTERROR);
+    }
+    tournament->finished = tournament->checkpoint->header.finished;
+}
+
+/**
+ * finds the games of the tournament that are in the --cache, counting them
+ * as finished, so only the others are played
+ *
+ * @param tournament    tournament to be played
+ * @param programs      program of each seat
+ */
+static void look_up_games(Tournament* tournament, char** programs) {
+    Game* game = tournament->game;
+    Card* deck = malloc(game->deck.count * sizeof(Card));
+    uint64_t matchup = HASH_START;
+
+    matchup = hash_bytes(&game->playerCount, sizeof(game->playerCount),
+            matchup);
+    matchup = hash_bytes(&game->threshold, sizeof(game->threshold), matchup);
+    uint64_t environment = cache_environment_hash();
+    matchup = hash_bytes(&environment, sizeof(environment), matchup);
+    for (int i = 0; i < game->playerCount; i++) {
+        uint64_t program;
+        if (!cache_program_hash(programs[i], &program)) {
+            quit_on_player_error(i, PLAYERERROR);
+        }
+        matchup = hash_bytes(&program, sizeof(program), matchup);
+    }
+    tournament->matchup = matchup;
+
+    tournament->cache = malloc(sizeof(ResultCache));
+    if (!cache_open(tournament->cache, game->options.cachePath,
+            game->playerCount)) {
+        quit_on_error(CACHEERROR);
+    }
+    for (long id = 0; id < game->options.tournament; id++) {
+        if (tournament->done[id]) {
+            continue;
+        }
+        shuffle_game(game, id, deck);
+        const int32_t* scores = cache_find(tournament->cache,
+                game_key(tournament, deck));
+        if (scores != NULL) {
+            record_tournament_game(tournament, id, scores);
+            tournament->cached++;
+        }
+    }
+    cache_release(tournament->cache);
+    free(deck);
+}
+
+/**
+ * reads batches from the coordinator, dealing their games as there is
+ * room in the window. a worker whose coordinator has gone just stops
+ *
+ * @param tournament    tournament of a --worker
+ */
+static void read_link(Tournament* tournament) {
+    Seat* link = &tournament->link;
+    ssize_t got = read(link->fromPlayer, link->in + link->inLength,
+            SEAT_BUFFER_SIZE - link->inLength);
+    if (got == -1 && errno == EAGAIN) {
+        return;
+    }
+    if (got <= 0) {
+        supervise_kill();
+        exit(OK);
+    }
+    link->inLength += got;
+
+    char* start = link->in;
+    char* newline;
+    while ((newline = memchr(start, '\n',
+            link->in + link->inLength - start)) != NULL) {
+        WorkBatch* batch = &tournament->batches[tournament->batchCount];
+        *newline = 0;
+        if (strcmp(start, "E") == 0) {
+            tournament->ending = true;
+        } else if (tournament->batchCount < WORKER_BATCHES && sscanf(start,
+                "B%ld,%ld,%ld", &batch->index, &batch->first,
+                &batch->count) == 3 && batch->first >= 0 &&
+                batch->count > 0 && batch->first + batch->count <=
+                tournament->game->options.tournament) {
+            batch->dealt = 0;
+            batch->left = batch->count;
+            tournament->batchCount++;
+        } else {
+            quit_on_error(BADMSG);
+        }
+        start = newline + 1;
+    }
+    link->inLength -= start - link->in;
+    memmove(link->in, start, link->inLength);
+
+    fill_window(tournament);
+}
+
+/**
+ * sets up a tournament, taking the games that are already finished from
+ * the --checkpoint and --cache
+ *
+ * @param tournament    tournament to set up
+ * @param game          game settings, with options.tournament games to play
+ * @param programs      program of each seat
+ * @return              number of games already finished
+ */
+long prepare_tournament(Tournament* tournament, Game* game,
+        char** programs) {
+    int window = game->options.window;
+
+    // a dead player shows up as an error writing to it
+    signal(SIGPIPE, SIG_IGN);
+
+    memset(tournament, 0, sizeof(Tournament));
+    tournament->game = game;
+    tournament->slots = calloc(window, sizeof(TourGame));
+    tournament->slotOf = calloc(game->options.tournament, sizeof(int));
+    tournament->seats = calloc(game->playerCount, sizeof(Seat));
+    tournament->totals = calloc(game->playerCount, sizeof(int64_t));
+    tournament->done = calloc(game->options.tournament, sizeof(bool));
+    for (int i = 0; i < window; i++) {
+        tournament->slots[i].id = -1;
+    }
+    if (game->options.checkpointPath != NULL) {
+        open_checkpoint(tournament);
+    }
+    if (game->options.cachePath != NULL) {
+        look_up_games(tournament, programs);
+    }
+
+    return tournament->finished;
+}
+
+/**
+ * checks whether a tournament has games still to play. a worker has until
+ * the coordinator says there are no more batches and its own are done
+ *
+ * @param tournament    tournament being played
+ * @return              true if there are
+ */
+static bool games_left(Tournament* tournament) {
+    if (tournament->game->options.worker) {
+        return !tournament->ending || tournament->batchCount > 0;
+    }
+
+    return tournament->finished < tournament->game->options.tournament;
+}
+
+/**
+ * starts the players and plays games until there are none left, then
+ * lets the players go
+ *
+ * @param tournament    tournament being played
+ * @param programs      program of each seat
+ */
+static void play_tournament(Tournament* tournament, char** programs) {
+    int playerCount = tournament->game->playerCount;
+    int links = tournament->game->options.worker ? 1 : 0;
+    struct pollfd* polls = calloc(2 * playerCount + links,
+            sizeof(struct pollfd));
+
+    start_seats(tournament, programs);
+    fill_window(tournament);
+
+    while (games_left(tournament)) {
+        check_sighup();
+        for (int i = 0; i < playerCount; i++) {
+            polls[2 * i].fd = tournament->seats[i].fromPlayer;
+            polls[2 * i].events = POLLIN;
+            polls[2 * i + 1].fd = tournament->seats[i].toPlayer;
+            polls[2 * i + 1].events =
+                    tournament->seats[i].outLength > 0 ? POLLOUT : 0;
+        }
+        if (links > 0) {
+            polls[2 * playerCount].fd = tournament->link.fromPlayer;
+            polls[2 * playerCount].events = POLLIN;
+        }
+        if (poll(polls, 2 * playerCount + links, -1) == -1) {
+            continue;
+        }
+        for (int i = 0; i < playerCount; i++) {
+            if (polls[2 * i + 1].revents & (POLLOUT | POLLERR)) {
+                flush_seat(&tournament->seats[i]);
+            }
+            if (polls[2 * i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read_seat(tournament, i);
+            }
+        }
+        if (links > 0 && polls[2 * playerCount].revents) {
+            read_link(tournament);
+        }
+    }
+
+    for (int i = 0; i < playerCount; i++) {
+        Seat* seat = &tournament->seats[i];
+        fcntl(seat->toPlayer, F_SETFL, 0);
+        while (seat->outLength > 0) {
+            flush_seat(seat);
+        }
+        close(seat->toPlayer);
+    }
+    free(polls);
+}
+
+/**
+ * prints each seat's average score and how long the games took, and saves
+ * the --checkpoint and --cache
+ *
+ * @param tournament    tournament that has finished
+ * @param resumed       number of games that were finished before it started
+ * @param start         time it started
+ */
+void report_tournament(Tournament* tournament, long resumed, double start) {
+    Game* game = tournament->game;
+
+    for (int i = 0; i < game->playerCount; i++) {
+        log_printf(STDOUT_FILENO, "Seat=%d games=%ld average=%.4f\n", i,
+                game->options.tournament,
+                (double)tournament->totals[i] / game->options.tournament);
+    }
+    if (tournament->checkpoint != NULL &&
+            !checkpoint_close(tournament->checkpoint)) {
+        quit_on_error(CHECKPOINTERROR);
+    }
+    if (tournament->cache != NULL && !cache_merge(tournament->cache)) {
+        quit_on_error(CACHEERROR);
+    }
+    double seconds = now_seconds() - start;
+    log_printf(STDOUT_FILENO, "Games=%ld pinned=%s seconds=%.3f "
+            "games/sec=%.0f\n", game->options.tournament,
+            game->placement == NULL ? "no" : "yes", seconds,
+            (game->options.tournament - resumed) / seconds);
+    if (tournament->cache != NULL) {
+        log_printf(STDOUT_FILENO, "Cached=%ld played=%ld\n",
+                tournament->cached, game->options.tournament - resumed);
+    }
+}
+
+/**
+ * plays a tournament to the end and prints each seat's average score
+ *
+ * @param game      game settings, with options.tournament games to play
+ * @param programs  program of each seat
+ */
+void run_tournament(Game* game, char** programs) {
+    Tournament tournament;
+    long resumed = prepare_tournament(&tournament, game, programs);
+    double start = now_seconds();
+
+    // no players are needed if every game is already done
+    if (resumed < game->options.tournament) {
+        play_tournament(&tournament, programs);
+    }
+    report_tournament(&tournament, resumed, start);
+}
+
+/**
+ * plays the batches of games a coordinator sends over --worker, sending
+ * back each game's scores, until it says there are no more
+ *
+ * @param game      game settings, with options.tournament games in all
+ * @param programs  program of each seat
+ */
+void run_worker(Game* game, char** programs) {
+    Tournament tournament;
+
+    prepare_tournament(&tournament, game, programs);
+    tournament.link.index = -1;
+    tournament.link.toPlayer = game->options.workerLink;
+    tournament.link.fromPlayer = game->options.workerLink;
+    fcntl(game->options.workerLink, F_SETFD, FD_CLOEXEC);
+
+    play_tournament(&tournament, programs);
+    close(game->options.workerLink);
+}
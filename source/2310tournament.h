@@ -0,0 +1,111 @@
+//
+// Created by caleb on 2019-10-14.
+//
+
+#ifndef ASS3_TOURNAMENT_H
+#define ASS3_TOURNAMENT_H
+
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "2310hub.h"
+#include "2310checkpoint.h"
+#include "2310cache.h"
+
+#define TOURNAMENT_WINDOW 1024
+#define SEAT_BUFFER_SIZE 65536
+#define WORKER_BATCHES 64
+
+/*
+ * a player process playing seat index of every game. out holds messages
+ * waiting for the player to read them, in holds what has been read from it
+ * but not yet handled
+ */
+typedef struct {
+    int index;
+    int pid;
+    int toPlayer;
+    int fromPlayer;
+    char* out;
+    size_t outLength;
+    size_t outSize;
+    char in[SEAT_BUFFER_SIZE];
+    size_t inLength;
+} Seat;
+
+/*
+ * a game in progress. trick holds the card_index of the cards played so
+ * far in the current trick, in play order. id is -1 for a free slot. key
+ * is its --cache key
+ */
+typedef struct {
+    long id;
+    uint64_t key;
+    int lead;
+    int played;
+    int round;
+    int trick[MAX_PLAYERS];
+    Hand hands[MAX_PLAYERS];
+    int tricks[MAX_PLAYERS];
+    int dCards[MAX_PLAYERS];
+} TourGame;
+
+/*
+ * a batch of games given to a --worker: count games from first. dealt of
+ * them have been dealt and left have still to finish. index is the
+ * coordinator's number for it
+ */
+typedef struct {
+    long index;
+    long first;
+    long count;
+    long dealt;
+    long left;
+} WorkBatch;
+
+/*
+ * started is the next game to deal. done marks the games that have
+ * finished, including those finished before a --resume and those found in
+ * the --cache. matchup is the hash of the players and threshold that each
+ * game's cache key starts from. a --worker talks to its coordinator over
+ * link, and ending is set once it has been told there are no more batches
+ */
+typedef struct {
+    Game* game;
+    long started;
+    long finished;
+    int active;
+    TourGame* slots;
+    int* slotOf;
+    Seat* seats;
+    int64_t* totals;
+    bool* done;
+    Checkpoint* checkpoint;
+    ResultCache* cache;
+    uint64_t matchup;
+    long cached;
+    Seat link;
+    WorkBatch batches[WORKER_BATCHES];
+    int batchCount;
+    bool ending;
+} Tournament;
+
+void seat_printf(Seat* seat, const char* format, ...);
+uint64_t tournament_game_key(Tournament* tournament, long id);
+void start_tournament_game(Tournament* tournament, long id);
+bool deal_next_game(Tournament* tournament);
+void record_tournament_game(Tournament* tournament, long id,
+        const int32_t* scores);
+void finish_tournament_game(Tournament* tournament, TourGame* tourGame);
+void handle_tournament_play(Tournament* tournament, int seat, char* line);
+long prepare_tournament(Tournament* tournament, Game* game,
+        char** programs);
+void report_tournament(Tournament* tournament, long resumed, double start);
+void run_tournament(Game* game, char** programs);
+void run_worker(Game* game, char** programs);
+
+#endif //ASS3_TOURNAMENT_H
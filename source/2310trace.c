@@ -0,0 +1,287 @@
+//
+// Created by caleb on 2019-10-19.
+//
+/*
+ * A timeline of what the hub and its players spent their time on, for
+ * --trace, written as Chrome trace JSON for chrome://tracing or Perfetto.
+ *
+ * Each thread keeps its own list of events, so recording one is a clock
+ * read and a store, with no locks and nothing shared between threads. A
+ * thread adds itself to the list of threads with a compare and swap the
+ * first time it traces something.
+ *
+ * Nothing is written until the process exits. Then each process appends its
+ * events to the trace file, a line each and many lines to a write, so the
+ * processes' lines never mix. The hub started the trace and its players
+ * found the file in PLAYER_TRACE; once it has reaped them it turns the
+ * lines into a whole trace. Every process times events with
+ * CLOCK_MONOTONIC, which is the same clock across processes, so all of
+ * them share one timeline.
+ */
+
+#include "2310trace.h"
+
+static bool tracing;
+static bool owner;
+static pid_t tracer;
+static char tracePath[TRACE_PATH_SIZE];
+static char traceName[TRACE_LINE_SIZE / 2];
+static TraceThread* threads;
+static __thread TraceThread* self;
+
+/**
+ * gets the time in nanoseconds from an arbitrary start shared by every
+ * process
+ *
+ * @return  time in nanoseconds
+ */
+static int64_t trace_clock(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**
+ * adds a line to the lines to be appended to the trace, writing them first
+ * if it doesn't fit
+ *
+ * @param fd        the trace file
+ * @param buffer    lines waiting to be written, TRACE_WRITE_SIZE bytes
+ * @param length    length of buffer, updated
+ * @param line      line to add, ending in a newline
+ * @param size      length of line
+ */
+static void add_line(int fd, char* buffer, size_t* length, const char* line,
+        int size) {
+    if (*length + size > TRACE_WRITE_SIZE) {
+        write(fd, buffer, *length);
+        *length = 0;
+    }
+    memcpy(buffer + *length, line, size);
+    *length += size;
+}
+
+/**
+ * formats an event as a complete event of the trace, microseconds with
+ * nanosecond decimals
+ *
+ * @param line      line to format into, TRACE_LINE_SIZE bytes
+ * @param event     event to format
+ * @param tid       thread the event was on
+ * @return          length of the line
+ */
+static int format_event(char* line, const TraceEvent* event, pid_t tid) {
+    int64_t duration = event->end - event->start;
+    int length = snprintf(line, TRACE_LINE_SIZE, "{\"name\":\"%s\","
+            "\"ph\":\"X\",\"ts\":%lld.%03d,\"dur\":%lld.%03d,\"pid\":%d,"
+            "\"tid\":%d", event->name, (long long)(event->start / 1000),
+            (int)(event->start % 1000), (long long)(duration / 1000),
+            (int)(duration % 1000), (int)tracer, (int)tid);
+
+    if (event->argName != NULL) {
+        length += snprintf(line + length, TRACE_LINE_SIZE - length,
+                ",\"args\":{\"%s\":%ld}", event->argName, event->arg);
+    }
+    length += snprintf(line + length, TRACE_LINE_SIZE - length, "},\n");
+
+    return length;
+}
+
+/**
+ * appends the name of the process and every event so far to the trace
+ */
+static void append_events(void) {
+    char* buffer = malloc(TRACE_WRITE_SIZE);
+    char line[TRACE_LINE_SIZE];
+    size_t length = 0;
+    int fd = open(tracePath, O_WRONLY | O_APPEND | O_CLOEXEC);
+
+    if (fd == -1) {
+        free(buffer);
+        return;
+    }
+
+    add_line(fd, buffer, &length, line, snprintf(line, TRACE_LINE_SIZE,
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"args\":{\"name\":\"%s\"}},\n", (int)tracer, traceName));
+    for (TraceThread* thread = __atomic_load_n(&threads, __ATOMIC_ACQUIRE);
+            thread != NULL; thread = thread->next) {
+        TraceChunk* chunk = thread->first;
+        while (chunk != NULL) {
+            int count = atomic_load_explicit(&chunk->count,
+                    memory_order_acquire);
+            for (int i = 0; i < count; i++) {
+                add_line(fd, buffer, &length, line,
+                        format_event(line, &chunk->events[i], thread->tid));
+            }
+            chunk = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE);
+        }
+    }
+    write(fd, buffer, length);
+
+    close(fd);
+    free(buffer);
+}
+
+/**
+ * turns the lines every process appended into a whole trace, leaving out
+ * any cut short by a player being killed
+ */
+static void merge_trace(void) {
+    char tempPath[TRACE_PATH_SIZE + 4];
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    bool first = true;
+
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", tracePath);
+    FILE* in = fopen(tracePath, "r");
+    if (in == NULL) {
+        return;
+    }
+    FILE* out = fopen(tempPath, "w");
+    if (out == NULL) {
+        fclose(in);
+        return;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", out);
+    while ((length = getline(&line, &size, in)) > 0) {
+        if (length < 3 || line[0] != '{' ||
+                strcmp(line + length - 3, "},\n") != 0) {
+            continue;
+        }
+        line[length - 2] = 0;
+        fprintf(out, "%s%s", first ? "" : ",\n", line);
+        first = false;
+    }
+    fputs("\n]}\n", out);
+
+    free(line);
+    fclose(in);
+    if (fclose(out) == 0) {
+        rename(tempPath, tracePath);
+    }
+}
+
+/**
+ * writes the process's events at exit, and the whole trace if this is the
+ * hub that started it
+ */
+static void trace_finish(void) {
+    // a child that exits before exec has a copy of the parent's events
+    if (!tracing || getpid() != tracer) {
+        return;
+    }
+    tracing = false;
+
+    append_events();
+    if (owner) {
+        merge_trace();
+    }
+}
+
+/**
+ * starts tracing this process until it exits
+ *
+ * @param path          file of the trace
+ * @param processName   name of the process in the trace
+ * @param starter       true for the hub, which empties the file, passes
+ *                      it on to its players in PLAYER_TRACE and writes the
+ *                      whole trace at exit
+ * @return              false if the trace file can't be made
+ */
+bool trace_start(const char* path, const char* processName, bool starter) {
+    if (snprintf(tracePath, TRACE_PATH_SIZE, "%s", path) >=
+            TRACE_PATH_SIZE) {
+        return false;
+    }
+    if (starter) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            return false;
+        }
+        close(fd);
+        setenv(TRACE_ENV, path, 1);
+    }
+
+    // the name goes in the JSON as it is
+    snprintf(traceName, sizeof(traceName), "%s", processName);
+    for (char* c = traceName; *c != 0; c++) {
+        if (*c == '"' || *c == '\\' || iscntrl((int)*c)) {
+            *c = '_';
+        }
+    }
+
+    owner = starter;
+    tracer = getpid();
+    tracing = true;
+    atexit(trace_finish);
+    return true;
+}
+
+/**
+ * gets the start time of an event
+ *
+ * @return  the time to give trace_end, 0 if not tracing
+ */
+int64_t trace_begin(void) {
+    return tracing ? trace_clock() : 0;
+}
+
+/**
+ * adds this thread to the list of threads that have traced something
+ *
+ * @return  the thread
+ */
+static TraceThread* join_threads(void) {
+    TraceThread* thread = calloc(1, sizeof(TraceThread));
+    TraceThread* head = __atomic_load_n(&threads, __ATOMIC_RELAXED);
+
+    thread->tid = syscall(SYS_gettid);
+    thread->first = calloc(1, sizeof(TraceChunk));
+    thread->last = thread->first;
+    do {
+        thread->next = head;
+    } while (!__atomic_compare_exchange_n(&threads, &head, thread, true,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return thread;
+}
+
+/**
+ * records an event that has just ended
+ *
+ * @param name      name of the event, a string literal
+ * @param start     what trace_begin gave at its start
+ * @param argName   name of its argument, a string literal, or NULL
+ * @param arg       value of its argument
+ */
+void trace_end(const char* name, int64_t start, const char* argName,
+        long arg) {
+    if (start == 0 || !tracing) {
+        return;
+    }
+    int64_t end = trace_clock();
+
+    if (self == NULL) {
+        self = join_threads();
+    }
+    TraceChunk* chunk = self->last;
+    int count = atomic_load_explicit(&chunk->count, memory_order_relaxed);
+    if (count == TRACE_CHUNK_EVENTS) {
+        TraceChunk* next = calloc(1, sizeof(TraceChunk));
+        __atomic_store_n(&chunk->next, next, __ATOMIC_RELEASE);
+        self->last = next;
+        chunk = next;
+        count = 0;
+    }
+
+    TraceEvent* event = &chunk->events[count];
+    event->name = name;
+    event->argName = argName;
+    event->arg = arg;
+    event->start = start;
+    event->end = end;
+    atomic_store_explicit(&chunk->count, count + 1, memory_order_release);
+}
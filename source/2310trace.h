@@ -0,0 +1,59 @@
+//
+// Created by caleb on 2019-10-19.
+//
+
+#ifndef ASS3_TRACE_H
+#define ASS3_TRACE_H
+
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+#include "2310shared.h"
+
+#define TRACE_ENV "PLAYER_TRACE"
+#define TRACE_CHUNK_EVENTS 4096
+#define TRACE_PATH_SIZE 4096
+#define TRACE_LINE_SIZE 512
+#define TRACE_WRITE_SIZE 65536
+
+/*
+ * something a thread spent time on, from start to end nanoseconds of
+ * CLOCK_MONOTONIC. argName is NULL if it has no argument
+ */
+typedef struct {
+    const char* name;
+    const char* argName;
+    long arg;
+    int64_t start;
+    int64_t end;
+} TraceEvent;
+
+/*
+ * events of one thread. only the thread adds to them: count is published
+ * after each event is filled in, and next once the chunk is full
+ */
+typedef struct TraceChunk {
+    struct TraceChunk* next;
+    atomic_int count;
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+} TraceChunk;
+
+/*
+ * a thread that has traced something, on the list every thread is added
+ * to the first time it traces
+ */
+typedef struct TraceThread {
+    struct TraceThread* next;
+    pid_t tid;
+    TraceChunk* first;
+    TraceChunk* last;
+} TraceThread;
+
+bool trace_start(const char* path, const char* processName, bool starter);
+int64_t trace_begin(void);
+void trace_end(const char* name, int64_t start, const char* argName,
+        long arg);
+
+#endif //ASS3_TRACE_H